@@ -0,0 +1,73 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// 基准测试子命令：argv[0]为子命令名，其余为该子命令的参数
+using BenchEntry = int (*)(int argc, char** argv);
+
+// 重复执行fn共reps次，返回每次的耗时（毫秒）
+std::vector<double> time_runs(int reps, const std::function<void()>& fn);
+
+// 计算中位数
+double median(std::vector<double> samples);
+
+// 计算分位数（p取0~1，取最近的样本）
+double percentile(std::vector<double> samples, double p);
+
+// 打印一行结果：名称、中位数与最小值
+void report(const std::string& name, const std::vector<double>& samples_ms);
+
+// 打印一行检查结果（ok或FAIL与说明），返回ok
+bool check(const std::string& what, bool ok);
+
+// fn抛出std::runtime_error时返回true
+template <typename Fn>
+bool throws(Fn&& fn) {
+    try {
+        fn();
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// 写入IDX文件（bytes为含头部的完整内容）及其.gz压缩包
+void write_idx_pair(const std::string& path, const std::vector<uint8_t>& bytes);
+
+// 在root下写入合成的MNIST数据集（IDX文件及其.gz），无需下载即可运行基准测试
+void write_synthetic_mnist(const std::string& root, int train_count, int test_count, uint32_t seed);
+
+// 各子命令
+int bench_load(int argc, char** argv);
+int bench_storage(int argc, char** argv);
+int bench_batch(int argc, char** argv);
+int bench_prefetch(int argc, char** argv);
+int bench_alloc(int argc, char** argv);
+int bench_gz(int argc, char** argv);
+int bench_snapshot(int argc, char** argv);
+int bench_download(int argc, char** argv);
+int bench_softmax(int argc, char** argv);
+int bench_train(int argc, char** argv);
+int bench_parallel(int argc, char** argv);
+int bench_serve(int argc, char** argv);
+int bench_loadgen(int argc, char** argv);
+int bench_quant(int argc, char** argv);
+int bench_synth(int argc, char** argv);
+int bench_suite(int argc, char** argv);
+int bench_metrics(int argc, char** argv);
+int bench_simd(int argc, char** argv);
+int bench_stream(int argc, char** argv);
+int bench_shard(int argc, char** argv);
+int bench_manifest(int argc, char** argv);
+int bench_eval(int argc, char** argv);
+int bench_augment(int argc, char** argv);
+int bench_checkpoint(int argc, char** argv);
+int bench_fixed(int argc, char** argv);
+int bench_knn(int argc, char** argv);
+
+#endif // BENCH_H
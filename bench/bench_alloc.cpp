@@ -0,0 +1,209 @@
+#include "bench.h"
+#include "mnist_loader.h"
+#include "mnist_prefetch.h"
+#include "math.hpp"
+#include "mlp.h"
+#include "parallel_trainer.h"
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// Counts heap allocations by interposing the glibc malloc family. Eigen allocates through
+// malloc rather than operator new, and libstdc++'s operator new ends up here as well.
+namespace {
+std::atomic<size_t> allocation_count{0};
+}
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t alignment, size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) {
+    *out = memalign(alignment, size);
+    return *out ? 0 : 12; // ENOMEM
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+}
+#endif
+
+namespace {
+
+// Runs one warm-up epoch, then returns the allocations made by a second, steady-state epoch
+template <typename Epoch>
+size_t steady_state_allocations(Epoch epoch) {
+    epoch();
+    size_t before = allocation_count.load();
+    epoch();
+    return allocation_count.load() - before;
+}
+
+bool check(const std::string& name, size_t allocations, int& failures) {
+    std::cout << (allocations == 0 ? "PASS  " : "FAIL  ") << name << ": " << allocations
+              << " allocations in a steady-state epoch\n";
+    failures += allocations != 0;
+    return allocations == 0;
+}
+
+// Every shuffled epoch must be a permutation of the file-order labels
+bool same_label_histogram(const Eigen::VectorXi& a, const Eigen::VectorXi& b) {
+    Eigen::VectorXi ha = Eigen::VectorXi::Zero(10), hb = Eigen::VectorXi::Zero(10);
+    for (int i = 0; i < a.size(); ++i) ha[a[i]]++;
+    for (int i = 0; i < b.size(); ++i) hb[b[i]]++;
+    return ha == hb;
+}
+
+} // anonymous namespace
+
+int bench_alloc(int argc, char** argv) {
+#ifndef __GLIBC__
+    std::cerr << "allocation counting needs glibc" << std::endl;
+    return 1;
+#endif
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 100;
+    uint64_t seed = 42;
+
+    MnistMapped mapped = map_mnist(root);
+    MnistData f32 = load_mnist(mapped, true);
+    MnistLoadOptions u8_options;
+    u8_options.storage = MnistStorage::Uint8;
+    MnistData u8 = load_mnist(mapped, u8_options);
+    int failures = 0;
+
+    MnistBatch batch;
+    for (MnistData* data : {&f32, &u8}) {
+        MnistBatchLoader loader(*data, batch_size);
+        loader.enable_shuffle(seed);
+        check(std::string("shuffled gather, ") + (data == &f32 ? "float" : "uint8") + " storage",
+              steady_state_allocations([&] {
+                  loader.reset();
+                  while (loader.next_train_batch(batch)) {
+                  }
+              }),
+              failures);
+    }
+
+    MnistBatchLoader view_loader(f32, batch_size);
+    MnistBatchView view;
+    check("file-order views", steady_state_allocations([&] {
+              view_loader.reset();
+              while (view_loader.next_train_view(view)) {
+              }
+          }),
+          failures);
+
+    MnistPrefetchLoader prefetch(u8, batch_size, MnistSplit::Train, 4, 2);
+    prefetch.enable_shuffle(seed);
+    check("shuffled prefetch loader", steady_state_allocations([&] {
+              prefetch.reset();
+              while (prefetch.next_batch(batch)) {
+              }
+          }),
+          failures);
+
+    AugmentOptions augment_options;
+    augment_options.elastic_alpha = 34.0f;
+    MnistPrefetchLoader augmented(f32, batch_size, MnistSplit::Train, 4, 2);
+    augmented.enable_shuffle(seed);
+    augmented.set_augment(make_geometric_augment(augment_options), seed);
+    check("augmented prefetch loader", steady_state_allocations([&] {
+              augmented.reset();
+              while (augmented.next_batch(batch)) {
+              }
+          }),
+          failures);
+
+    Math::RowMatrix<float> logits = Math::RowMatrix<float>::Random(batch_size, 10), grad(batch_size, 10);
+    MnistBatchLoader label_loader(u8, batch_size);
+    float loss = 0.0f;
+    check("fused softmax + cross-entropy", steady_state_allocations([&] {
+              label_loader.reset();
+              while (label_loader.next_train_batch(batch)) {
+                  loss += Math::softmax_cross_entropy<float>(logits.topRows(batch.count), batch.y(),
+                                                             grad.topRows(batch.count));
+              }
+          }),
+          failures);
+
+    for (OptimizerKind kind : {OptimizerKind::SGD, OptimizerKind::Momentum, OptimizerKind::Adam}) {
+        Mlp model({f32.rows * f32.cols, 100, 10});
+        OptimizerConfig config;
+        config.kind = kind;
+        MlpTrainer trainer(model, config, batch_size);
+        MnistBatchLoader train_loader(f32, batch_size);
+        train_loader.enable_shuffle(seed);
+        check(std::string("MLP training epoch, ") + optimizer_name(kind),
+              steady_state_allocations([&] { trainer.train_epoch(train_loader); }), failures);
+    }
+
+    {
+        Mlp model({f32.rows * f32.cols, 100, 10});
+        DataParallelTrainer trainer(model, u8, OptimizerConfig(), batch_size, 3);
+        trainer.enable_shuffle(seed);
+        check("data-parallel training epoch, 3 threads",
+              steady_state_allocations([&] { trainer.train_epoch(); }), failures);
+    }
+
+    // Shuffling: deterministic for a seed, a permutation per epoch, different across epochs,
+    // and identical between MnistBatchLoader and MnistPrefetchLoader
+    MnistBatchLoader a(u8, batch_size), b(u8, batch_size);
+    a.enable_shuffle(seed);
+    b.enable_shuffle(seed);
+    prefetch.enable_shuffle(seed);
+    Eigen::VectorXi epoch_labels(u8.train_count), previous_labels;
+    bool shuffle_ok = true;
+    MnistBatch other, prefetched;
+    for (int epoch = 0; epoch < 3; ++epoch) {
+        int filled = 0;
+        while (a.next_train_batch(batch)) {
+            shuffle_ok &= b.next_train_batch(other) && batch.x() == other.x() && batch.y() == other.y();
+            shuffle_ok &= prefetch.next_batch(prefetched) && batch.x() == prefetched.x() &&
+                          batch.y() == prefetched.y();
+            epoch_labels.segment(filled, batch.count) = batch.y();
+            filled += batch.count;
+        }
+        shuffle_ok &= filled == u8.train_count && same_label_histogram(epoch_labels, u8.train_labels);
+        shuffle_ok &= epoch_labels != u8.train_labels;
+        shuffle_ok &= epoch == 0 || epoch_labels != previous_labels;
+        previous_labels = epoch_labels;
+        a.reset();
+        b.reset();
+        prefetch.reset();
+    }
+    std::cout << (shuffle_ok ? "PASS  " : "FAIL  ") << "seeded shuffle is a reproducible per-epoch permutation\n";
+    failures += !shuffle_ok;
+
+    return failures == 0 ? 0 : 1;
+}
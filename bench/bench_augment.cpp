@@ -0,0 +1,156 @@
+#include "augment.h"
+#include "bench.h"
+#include "kernels.h"
+#include "log.h"
+#include "metrics.h"
+#include "mnist_loader.h"
+#include "mnist_prefetch.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const uint64_t seed = 42;
+
+void spin_for(int microseconds) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(microseconds);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+// Every image of `epochs` augmented epochs, in the order served
+std::vector<RowMatrixXf> serve(const MnistData& data, int batch_size, int workers, const AugmentFn& fn, int epochs,
+                               Eigen::VectorXi* labels = nullptr) {
+    MnistPrefetchLoader loader(data, batch_size, MnistSplit::Train, 4, workers);
+    loader.enable_shuffle(seed);
+    loader.set_augment(fn, seed);
+    std::vector<RowMatrixXf> served(epochs, RowMatrixXf(data.train_count, data.rows * data.cols));
+    if (labels) labels->resize(data.train_count);
+    MnistBatch batch;
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        int filled = 0;
+        while (loader.next_batch(batch)) {
+            served[epoch].middleRows(filled, batch.count) = batch.images.topRows(batch.count);
+            if (labels && epoch == 0) labels->segment(filled, batch.count) = batch.labels.head(batch.count);
+            filled += batch.count;
+        }
+        loader.reset();
+    }
+    return served;
+}
+
+} // anonymous namespace
+
+int bench_augment(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 100;
+    int max_workers = argc > 3 ? std::stoi(argv[3]) : std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+    int compute_us = argc > 4 ? std::stoi(argv[4]) : 2000;
+    set_log_level(LogLevel::Warning);
+
+    MnistData full = load_mnist(map_mnist(root));
+    // The checks serve whole epochs several times over; a slice keeps them quick
+    MnistLoadOptions slice_options;
+    slice_options.world_size = std::max(1, full.train_count / 5000);
+    MnistData data = load_mnist(map_mnist(root), slice_options);
+
+    AugmentOptions geometric;
+    AugmentOptions elastic = geometric;
+    elastic.elastic_alpha = 34.0f;
+    AugmentOptions none;
+    none.max_shift = 0.0f;
+    none.max_rotation = 0.0f;
+
+    std::cout << "Augmentation checks on " << data.train_count << " training images\n";
+    bool ok = true;
+    {
+        Eigen::VectorXi plain_labels, labels;
+        std::vector<RowMatrixXf> plain = serve(data, batch_size, 1, AugmentFn(), 1, &plain_labels);
+        ok = check("zero shift and rotation leave every image unchanged",
+                   serve(data, batch_size, 2, make_geometric_augment(none), 1)[0] == plain[0]) && ok;
+
+        std::vector<RowMatrixXf> one = serve(data, batch_size, 1, make_geometric_augment(elastic), 2, &labels);
+        std::vector<RowMatrixXf> many = serve(data, batch_size, max_workers, make_geometric_augment(elastic), 2);
+        ok = check("labels follow the unaugmented shuffle", labels == plain_labels) && ok;
+        ok = check("images change", one[0] != plain[0]) && ok;
+        ok = check("identical with 1 and " + std::to_string(max_workers) + " workers", one == many) && ok;
+        ok = check("each epoch draws new transforms", one[0] != one[1]) && ok;
+
+        bool finite = one[0].allFinite();
+        float low = one[0].minCoeff(), high = one[0].maxCoeff();
+        ok = check("outputs stay within the input range", finite && low >= 0.0f && high <= 1.0f) && ok;
+    }
+    {
+        // One image transformed twice with its seed, then with a neighbouring seed
+        AugmentFn fn = make_geometric_augment(elastic);
+        std::vector<float> scratch;
+        const size_t img_size = static_cast<size_t>(data.rows) * data.cols;
+        std::vector<float> a(data.image_data(MnistSplit::Train), data.image_data(MnistSplit::Train) + img_size);
+        std::vector<float> b = a, c = a;
+        fn(a.data(), data.rows, data.cols, augment_sample_seed(seed, 0, 7), scratch);
+        fn(b.data(), data.rows, data.cols, augment_sample_seed(seed, 0, 7), scratch);
+        fn(c.data(), data.rows, data.cols, augment_sample_seed(seed, 0, 8), scratch);
+        ok = check("a sample's transform depends on its seed alone", a == b && a != c) && ok;
+    }
+    AugmentOptions bad;
+    bad.elastic_sigma = 0.0f;
+    ok = check("invalid options are rejected", throws([&] { make_geometric_augment(bad); })) && ok;
+
+    // One core, no loader: the cost of the transform itself
+    const int n = full.test_count;
+    const size_t img_size = static_cast<size_t>(full.rows) * full.cols;
+    std::vector<float> images(static_cast<size_t>(n) * img_size);
+    std::vector<float> scratch;
+    std::cout << "\nAugmented images/sec on one core (" << n << " test images, SIMD level "
+              << simd_level_name(simd_level()) << ")\n";
+    const std::pair<const char*, AugmentOptions> configs[] = {
+        {"shift + rotation", geometric}, {"shift + rotation + elastic", elastic}};
+    for (const auto& config : configs) {
+        AugmentFn fn = make_geometric_augment(config.second);
+        std::vector<double> runs = time_runs(3, [&] {
+            std::copy(full.image_data(MnistSplit::Test), full.image_data(MnistSplit::Test) + images.size(), images.begin());
+            for (int i = 0; i < n; ++i) {
+                fn(images.data() + i * img_size, full.rows, full.cols, augment_sample_seed(seed, 0, i), scratch);
+            }
+        });
+        std::cout << "  " << std::left << std::setw(30) << config.first << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(10) << n / (median(runs) / 1000.0) << " images/s\n";
+    }
+
+    // Through the loader, against a consumer that needs compute_us per batch
+    std::cout << "\nAugmented training epoch (" << full.train_count << " images, batch " << batch_size << ", elastic, "
+              << compute_us << " us of compute per batch, " << std::thread::hardware_concurrency()
+              << " hardware threads)\n";
+    MnistBatch batch;
+    for (int workers = 1; workers <= max_workers; workers = workers < max_workers ? std::min(workers * 2, max_workers) : workers + 1) {
+        MnistPrefetchLoader loader(full, batch_size, MnistSplit::Train, 4, workers);
+        loader.enable_shuffle(seed);
+        loader.set_augment(make_geometric_augment(elastic), seed);
+        std::vector<double> drain = time_runs(1, [&] {
+            while (loader.next_batch(batch)) {
+            }
+        });
+        loader.reset();
+        metrics_reset();
+        std::vector<double> train = time_runs(1, [&] {
+            while (loader.next_batch(batch)) {
+                spin_for(compute_us);
+            }
+        });
+        const double rate = full.train_count / (drain[0] / 1000.0);
+        const int cores = std::min(workers, std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+        std::cout << std::setw(3) << workers << " workers " << std::fixed << std::setprecision(0) << std::setw(10) << rate
+                  << " images/s (" << std::setw(8) << rate / cores << " per core)   with compute: "
+                  << std::setprecision(1) << train[0] / 1000.0 << " s, trainer waited "
+                  << metrics_snapshot().counter(MetricCounter::DataWaits) << " of " << loader.num_batches()
+                  << " batches\n";
+    }
+
+    std::cout << (ok ? "augmentation checks passed" : "augmentation check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
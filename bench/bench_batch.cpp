@@ -0,0 +1,62 @@
+#include "bench.h"
+#include "mnist_loader.h"
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+void report_throughput(const std::string& name, const std::vector<double>& runs, double bytes_per_run) {
+    report(name, runs);
+    double typical = median(runs);
+    std::cout << std::setw(32) << "" << " " << std::fixed << std::setprecision(2)
+              << bytes_per_run / (typical * 1e-3) / 1e9 << " GB/s\n";
+}
+
+} // anonymous namespace
+
+int bench_batch(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 100;
+    int reps = argc > 3 ? std::stoi(argv[3]) : 5;
+
+    MnistData data = load_mnist(map_mnist(root), true);
+    const int img_size = data.rows * data.cols;
+    const double epoch_bytes = static_cast<double>(data.train_count) * img_size * sizeof(float);
+
+    // Column-major storage as MnistData used before: each batch is a strided gather
+    Eigen::MatrixXf col_major = data.train_images;
+    Eigen::MatrixXf col_batch;
+    auto col_runs = time_runs(reps, [&] {
+        for (int i = 0; i < data.train_count; i += batch_size) {
+            int count = std::min(batch_size, data.train_count - i);
+            col_batch = col_major.block(i, 0, count, img_size);
+        }
+    });
+
+    MnistBatchLoader loader(data, batch_size);
+    Eigen::VectorXi y;
+    RowMatrixXf row_batch;
+    auto row_runs = time_runs(reps, [&] {
+        loader.reset();
+        while (loader.next_train_batch(row_batch, y)) {
+        }
+    });
+
+    Eigen::MatrixXf compat_batch;
+    auto compat_runs = time_runs(reps, [&] {
+        loader.reset();
+        while (loader.next_train_batch(compat_batch, y)) {
+        }
+    });
+
+    bool aligned = reinterpret_cast<uintptr_t>(data.train_images.data()) % 64 == 0 &&
+                   reinterpret_cast<uintptr_t>(row_batch.data()) % 64 == 0;
+    std::cout << "\nBatch extraction, one train epoch, batch_size=" << batch_size
+              << " (storage 64-byte aligned: " << (aligned ? "yes" : "no") << ")\n";
+    report_throughput("column-major gather", col_runs, epoch_bytes);
+    report_throughput("row-major contiguous", row_runs, epoch_bytes);
+    report_throughput("row-major -> MatrixXf batch", compat_runs, epoch_bytes);
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include "bench.h"
+#include "checkpoint.h"
+#include "log.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include "parallel_trainer.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <zlib.h>
+
+namespace {
+
+const uint64_t seed = 42;
+
+std::vector<char> read_bytes(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void write_bytes(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+bool same(const Eigen::VectorXf& a, const Eigen::VectorXf& b) {
+    return a.size() == b.size() && std::equal(a.data(), a.data() + a.size(), b.data());
+}
+
+std::vector<int> predict_all(const Mlp& model, const MnistData& data) {
+    const int batch = 500;
+    MlpWorkspace workspace(model.layout(), batch);
+    RowMatrixXf images(batch, model.input_size());
+    std::vector<int> predicted(data.test_count);
+    for (int start = 0; start < data.test_count; start += batch) {
+        const int count = std::min(batch, data.test_count - start);
+        copy_images(data, MnistSplit::Test, start, count, images.data());
+        model.predict(images.data(), count, predicted.data() + start, workspace);
+    }
+    return predicted;
+}
+
+// Trains for steps batches of loader, saving every `every` steps through save (0 = never)
+template <typename Save>
+void train_steps(MlpTrainer& trainer, MnistBatchLoader& loader, MnistBatch& batch, int steps, int every, Save&& save) {
+    for (int step = 1; step <= steps; ++step) {
+        if (!loader.next_train_batch(batch)) {
+            loader.reset();
+            loader.next_train_batch(batch);
+        }
+        trainer.train_step(batch);
+        if (every > 0 && step % every == 0) {
+            save();
+        }
+    }
+}
+
+} // anonymous namespace
+
+int bench_checkpoint(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int hidden = argc > 2 ? std::stoi(argv[2]) : 100;
+    int reps = argc > 3 ? std::stoi(argv[3]) : 5;
+    set_log_level(LogLevel::Warning);
+
+    MnistData data = load_mnist(root);
+    const std::vector<int> sizes = {data.rows * data.cols, hidden, 10};
+    const std::string path = root + "/bench_checkpoint.bin";
+    const std::string scratch = root + "/bench_checkpoint_damaged.bin";
+    OptimizerConfig config;
+    config.kind = OptimizerKind::Adam;
+    const int batch_size = 100;
+
+    std::cout << "Checkpoint checks (" << sizes[0] << "-" << hidden << "-10, Adam)\n";
+    bool ok = true;
+
+    // Uninterrupted: two epochs in one go
+    Mlp reference(sizes, seed);
+    {
+        MlpTrainer trainer(reference, config, batch_size);
+        MnistBatchLoader loader(data, batch_size);
+        loader.enable_shuffle(seed);
+        trainer.train_epoch(loader);
+        trainer.train_epoch(loader);
+    }
+
+    // Interrupted after the first epoch, resumed into a differently initialized model
+    Mlp first(sizes, seed);
+    {
+        MlpTrainer trainer(first, config, batch_size);
+        MnistBatchLoader loader(data, batch_size);
+        loader.enable_shuffle(seed);
+        trainer.train_epoch(loader);
+        save_checkpoint(path, first, &trainer.optimizer(), loader.epoch());
+
+        Mlp restored(sizes, seed + 1);
+        MlpTrainer resumed_trainer(restored, config, batch_size);
+        CheckpointInfo info = load_checkpoint(path, restored, &resumed_trainer.optimizer());
+        ok = check("round trip restores parameters, optimizer state and steps",
+                   same(restored.parameters(), first.parameters()) &&
+                       same(resumed_trainer.optimizer().state(), trainer.optimizer().state()) &&
+                       resumed_trainer.optimizer().steps() == trainer.optimizer().steps() && info.epoch == 1 &&
+                       info.sizes == sizes && info.has_optimizer && info.optimizer.kind == OptimizerKind::Adam) && ok;
+
+        MnistBatchLoader resumed_loader(data, batch_size);
+        resumed_loader.enable_shuffle(seed);
+        for (uint64_t e = 0; e < info.epoch; ++e) resumed_loader.reset();
+        resumed_trainer.train_epoch(resumed_loader);
+        ok = check("resumed training is bitwise identical to uninterrupted training",
+                   same(restored.parameters(), reference.parameters())) && ok;
+    }
+
+    {
+        Mlp mapped = map_checkpoint(path, true);
+        const uintptr_t address = reinterpret_cast<uintptr_t>(mapped.parameter_data());
+        ok = check("mapped model serves from the file without an arena of its own",
+                   mapped.is_mapped() && mapped.parameters().size() == 0 && address % 64 == 0 &&
+                       mapped.parameter_data() != first.parameter_data() &&
+                       std::equal(first.parameter_data(), first.parameter_data() + first.layout().total,
+                                  mapped.parameter_data())) && ok;
+        ok = check("mapped predictions match the trained model", predict_all(mapped, data) == predict_all(first, data)) && ok;
+        ok = check("trainers reject a mapped model",
+                   throws([&] { MlpTrainer trainer(mapped, config, batch_size); }) &&
+                       throws([&] { DataParallelTrainer trainer(mapped, data, config, batch_size, 1); }) &&
+                       throws([&] { load_checkpoint(path, mapped); })) && ok;
+    }
+
+    {
+        const std::vector<char> good = read_bytes(path);
+        std::vector<char> bytes = good;
+        bytes[bytes.size() - 5] ^= 0x10;
+        write_bytes(scratch, bytes);
+        Mlp target(sizes, seed);
+        ok = check("a flipped payload bit fails the checksum",
+                   throws([&] { load_checkpoint(scratch, target); }) && throws([&] { map_checkpoint(scratch, true); })) && ok;
+
+        bytes = good;
+        bytes.resize(bytes.size() / 2);
+        write_bytes(scratch, bytes);
+        ok = check("a truncated file is rejected",
+                   throws([&] { load_checkpoint(scratch, target); }) && throws([&] { map_checkpoint(scratch); })) && ok;
+
+        // A future version with a valid header checksum, so only the version test can reject it
+        bytes = good;
+        uint32_t version = MLP_CHECKPOINT_VERSION + 1;
+        std::memcpy(bytes.data() + 8, &version, sizeof(version));
+        const size_t crc_offset = 188;
+        uint32_t crc = static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(bytes.data()), crc_offset));
+        std::memcpy(bytes.data() + crc_offset, &crc, sizeof(crc));
+        write_bytes(scratch, bytes);
+        ok = check("an unknown version is rejected", throws([&] { read_checkpoint_info(scratch); })) && ok;
+
+        Mlp other({sizes[0], hidden + 1, 10}, seed);
+        ok = check("mismatched layer sizes are rejected", throws([&] { load_checkpoint(path, other); })) && ok;
+        std::remove(scratch.c_str());
+    }
+
+    {
+        // A reader mapping and verifying the checkpoint while the writer keeps replacing it
+        Mlp model(sizes, seed);
+        MlpTrainer trainer(model, config, batch_size);
+        MnistBatchLoader loader(data, batch_size);
+        MnistBatch batch;
+        std::atomic<bool> done(false);
+        std::atomic<int> reads(0), failures(0);
+        std::thread reader([&] {
+            while (!done.load()) {
+                try {
+                    Mlp mapped = map_checkpoint(path, true);
+                    reads.fetch_add(1);
+                } catch (const std::exception&) {
+                    failures.fetch_add(1);
+                }
+            }
+        });
+        CheckpointWriter writer;
+        train_steps(trainer, loader, batch, 200, 5, [&] { writer.save_async(path, model, &trainer.optimizer()); });
+        writer.wait();
+        done = true;
+        reader.join();
+        ok = check("a concurrent reader always sees a complete checkpoint (" + std::to_string(reads.load()) +
+                       " reads, " + std::to_string(writer.saved()) + " saves)",
+                   failures.load() == 0 && reads.load() > 0 && writer.saved() > 0) && ok;
+
+        Mlp last(sizes, seed + 1);
+        Optimizer state(config, last.layout().total);
+        load_checkpoint(path, last, &state);
+        writer.save_async(path, model, &trainer.optimizer());
+        writer.wait();
+        load_checkpoint(path, last, &state);
+        ok = check("after wait() the file holds the latest snapshot",
+                   same(last.parameters(), model.parameters()) && state.steps() == trainer.optimizer().steps()) && ok;
+    }
+
+    // Cost on the training thread of one save
+    std::cout << "\nSave cost (" << std::fixed << std::setprecision(1)
+              << read_bytes(path).size() / 1048576.0 << " MiB checkpoint, " << reps << " reps)\n";
+    {
+        Mlp model(sizes, seed);
+        Optimizer optimizer(config, model.layout().total);
+        CheckpointWriter writer;
+        std::vector<double> caller, total;
+        for (int i = 0; i < reps; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            writer.save_async(path, model, &optimizer);
+            caller.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            writer.wait();
+            total.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        report("save_checkpoint (synchronous)", time_runs(reps, [&] { save_checkpoint(path, model, &optimizer); }));
+        report("save_async, training thread", caller);
+        report("save_async, until on disk", total);
+    }
+
+    // Training with checkpoints every N steps: synchronous saves stall, background saves barely show
+    const int steps = std::min(600, data.train_count / batch_size * 2);
+    const int every = 50;
+    std::cout << "\nTraining " << steps << " steps, checkpoint every " << every << " steps ("
+              << std::thread::hardware_concurrency() << " hardware threads)\n";
+    {
+        auto run = [&](int mode) {
+            Mlp model(sizes, seed);
+            MlpTrainer trainer(model, config, batch_size);
+            MnistBatchLoader loader(data, batch_size);
+            MnistBatch batch;
+            CheckpointWriter writer;
+            std::vector<double> runs = time_runs(1, [&] {
+                train_steps(trainer, loader, batch, steps, mode == 0 ? 0 : every, [&] {
+                    if (mode == 1) save_checkpoint(path, model, &trainer.optimizer());
+                    else writer.save_async(path, model, &trainer.optimizer());
+                });
+            });
+            writer.wait();
+            return runs;
+        };
+        report("no checkpoints", run(0));
+        report("synchronous checkpoints", run(1));
+        report("background checkpoints", run(2));
+    }
+
+    // Cold start of an inference replica: map in place vs. allocate, initialize and copy
+    std::cout << "\nCold start of an inference model (" << reps << " reps)\n";
+    report("map_checkpoint", time_runs(reps, [&] { Mlp mapped = map_checkpoint(path); }));
+    report("map_checkpoint, verified", time_runs(reps, [&] { Mlp mapped = map_checkpoint(path, true); }));
+    report("construct + load_checkpoint", time_runs(reps, [&] {
+        Mlp model(sizes, seed);
+        load_checkpoint(path, model);
+    }));
+
+    std::remove(path.c_str());
+    std::cout << (ok ? "checkpoint checks passed" : "checkpoint check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "log.h"
+#include "mnist_loader.h"
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char* archives[] = {
+    "train-images-idx3-ubyte.gz",
+    "train-labels-idx1-ubyte.gz",
+    "t10k-images-idx3-ubyte.gz",
+    "t10k-labels-idx1-ubyte.gz"
+};
+
+std::string read_all(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+void clear_scratch(const std::string& scratch) {
+    for (const char* name : archives) {
+        std::string path = scratch + "/" + name;
+        std::remove(path.c_str());
+        std::remove((path + ".part").c_str());
+    }
+}
+
+// Every archive in scratch must match the mirror byte for byte, with no .part left behind
+bool same_as_mirror(const std::string& root, const std::string& scratch) {
+    for (const char* name : archives) {
+        std::string path = scratch + "/" + name;
+        struct stat st;
+        if (::stat((path + ".part").c_str(), &st) == 0 || read_all(path) != read_all(root + "/" + name)) {
+            std::cerr << "downloaded " << path << " differs from the mirror" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+int bench_download(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    std::string scratch = argc > 2 ? argv[2] : root + "/bench_download";
+    int reps = argc > 3 ? std::stoi(argv[3]) : 3;
+
+    char resolved[PATH_MAX];
+    if (!::realpath(root.c_str(), resolved)) {
+        throw std::runtime_error("Cannot resolve " + root);
+    }
+    // A local file:// mirror stands in for the HTTP servers; the first mirror does not exist
+    const std::string mirror = "file://" + std::string(resolved) + "/";
+    const std::string dead_mirror = "file:///nonexistent-mnist-mirror/";
+    ::mkdir(scratch.c_str(), 0755);
+
+    MnistInitOptions options;
+    options.decompress = false;
+    options.base_urls = {mirror};
+    bool ok = true;
+
+    // Transfers abort every 1 MiB and the first mirror is dead, so each large archive
+    // fails over once and then finishes only by resuming its .part file
+    clear_scratch(scratch);
+    MnistInitOptions faulty = options;
+    faulty.base_urls = {dead_mirror, mirror};
+    faulty.abort_after_bytes = 1 << 20;
+    init_mnist(scratch, faulty);
+    ok = same_as_mirror(root, scratch) && ok;
+
+    // Resuming across runs: a .part holding the first half of an archive is completed
+    std::string train = std::string(archives[0]);
+    std::string head = read_all(root + "/" + train);
+    clear_scratch(scratch);
+    std::ofstream(scratch + "/" + train + ".part", std::ios::binary) << head.substr(0, head.size() / 2);
+    init_mnist(scratch, options);
+    ok = same_as_mirror(root, scratch) && ok;
+
+    // A stale .part that is not a prefix of the archive fails the gzip check and is fetched again
+    clear_scratch(scratch);
+    std::ofstream(scratch + "/" + train + ".part", std::ios::binary) << "not a gzip file";
+    init_mnist(scratch, options);
+    ok = same_as_mirror(root, scratch) && ok;
+
+    LogLevel saved = log_level();
+    set_log_level(LogLevel::Warning);
+    auto serial_runs = time_runs(reps, [&] {
+        clear_scratch(scratch);
+        MnistInitOptions serial = options;
+        serial.max_parallel = 1;
+        init_mnist(scratch, serial);
+    });
+    auto parallel_runs = time_runs(reps, [&] {
+        clear_scratch(scratch);
+        init_mnist(scratch, options);
+    });
+    set_log_level(saved);
+    ok = same_as_mirror(root, scratch) && ok;
+
+    std::cout << "\nDownloading the four archives from " << mirror << " (" << reps << " runs)\n";
+    report("one transfer at a time", serial_runs);
+    report("curl multi, 4 concurrent", parallel_runs);
+    std::cout << (ok ? "failover, resume and stale .part checks passed" : "download checks FAILED") << std::endl;
+
+    clear_scratch(scratch);
+    ::rmdir(scratch.c_str());
+    return ok ? 0 : 1;
+}
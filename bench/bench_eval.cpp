@@ -0,0 +1,103 @@
+#include "bench.h"
+#include "evaluator.h"
+#include "log.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include "parallel_trainer.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Confusion matrix built one sample at a time, the plainest possible reference
+std::vector<int64_t> reference_confusion(const Mlp& model, const MnistData& data) {
+    MlpWorkspace workspace(model.layout(), 1);
+    RowMatrixXf image(1, model.input_size());
+    std::vector<int64_t> confusion(100, 0);
+    for (int i = 0; i < data.test_count; ++i) {
+        copy_images(data, MnistSplit::Test, i, 1, image.data());
+        int predicted = 0;
+        model.predict(image.data(), 1, &predicted, workspace);
+        ++confusion[data.test_labels[i] * 10 + predicted];
+    }
+    return confusion;
+}
+
+bool consistent(const EvalReport& report, const MnistData& data) {
+    int64_t diagonal = 0, total = 0;
+    bool rows_match = true;
+    for (int t = 0; t < report.num_classes; ++t) {
+        diagonal += report.cell(t, t);
+        int64_t row = 0, labelled = 0;
+        for (int p = 0; p < report.num_classes; ++p) row += report.cell(t, p);
+        for (int i = 0; i < data.test_count; ++i) labelled += data.test_labels[i] == t;
+        rows_match = rows_match && row == labelled;
+        total += row;
+    }
+    return rows_match && diagonal == report.correct && total == report.count;
+}
+
+} // anonymous namespace
+
+int bench_eval(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 512;
+    int max_threads = argc > 3 ? std::stoi(argv[3]) : std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+    int hidden = argc > 4 ? std::stoi(argv[4]) : 100;
+    set_log_level(LogLevel::Warning);
+
+    MnistData data = load_mnist(root);
+    Mlp model({data.rows * data.cols, hidden, 10}, 42);
+    OptimizerConfig config;
+    config.kind = OptimizerKind::Adam;
+    DataParallelTrainer trainer(model, data, config, 100, 1);
+    trainer.enable_shuffle(42);
+    trainer.train_epoch();
+
+    std::cout << "Evaluation checks, 784-" << hidden << "-10 after one epoch\n";
+    const std::vector<int64_t> reference = reference_confusion(model, data);
+    MnistEvaluator evaluator(model, data, batch_size, max_threads);
+    EvalReport result = evaluator.evaluate(MnistSplit::Test);
+    bool ok = check("confusion matrix matches per-sample prediction", result.confusion == reference);
+    ok = check("rows sum to the label counts, diagonal to the correct count", consistent(result, data)) && ok;
+    ok = check("accuracy matches the trainer's evaluate", result.accuracy() == trainer.evaluate(MnistSplit::Test)) && ok;
+
+    bool independent = true;
+    for (int threads : {1, 3, max_threads + 1}) {
+        for (int batch : {1, 7, batch_size}) {
+            independent = independent && MnistEvaluator(model, data, batch, threads).evaluate(MnistSplit::Test).confusion == reference;
+        }
+    }
+    ok = check("same result for every thread count and batch size", independent) && ok;
+
+    MnistLoadOptions pixels;
+    pixels.storage = MnistStorage::Uint8;
+    MnistData raw = load_mnist(root, pixels);
+    ok = check("uint8 storage gives the same result",
+               MnistEvaluator(model, raw, batch_size, max_threads).evaluate(MnistSplit::Test).confusion == reference) && ok;
+
+    Mlp narrow({data.rows * data.cols + 1, 10}, 42);
+    ok = check("model/image size mismatch is rejected",
+               throws([&] { MnistEvaluator mismatched(narrow, data, batch_size, 1); })) && ok;
+
+    std::cout << "\n";
+    print_eval_report(std::cout, result);
+
+    std::cout << "\nTest split (" << data.test_count << " samples), batch " << batch_size << ", "
+              << std::thread::hardware_concurrency() << " hardware threads\n";
+    {
+        MlpTrainer sequential(model, config, 100);
+        report("MlpTrainer::evaluate (sequential, batch 100)", time_runs(10, [&] { sequential.evaluate(data, MnistSplit::Test); }));
+    }
+    for (int threads = 1; threads <= max_threads; threads = threads < max_threads ? std::min(threads * 2, max_threads) : threads + 1) {
+        MnistEvaluator timed(model, data, batch_size, threads);
+        report("MnistEvaluator, " + std::to_string(threads) + " threads",
+               time_runs(10, [&] { timed.evaluate(MnistSplit::Test); }));
+    }
+
+    std::cout << (ok ? "evaluation checks passed" : "evaluation check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+#include "bench.h"
+#include "kernels.h"
+#include "log.h"
+#include "math.hpp"
+#include "mnist_fixed.h"
+#include "mnist_loader.h"
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Shape = Mnist28Shape;
+
+// Every batch of two epochs from both loaders, compared bit for bit
+bool same_batches(const MnistData& data, bool shuffled) {
+    MnistBatchLoader dynamic_loader(data, Shape::batch_size);
+    FixedMnistData<Shape> fixed_data(data);
+    FixedMnistLoader<Shape> fixed_loader(fixed_data);
+    if (shuffled) {
+        dynamic_loader.enable_shuffle(42);
+        fixed_loader.enable_shuffle(42);
+    }
+    MnistBatch batch;
+    auto fixed = std::make_unique<FixedMnistBatch<Shape>>();
+    bool same = true;
+    for (int epoch = 0; epoch < 2; ++epoch) {
+        while (dynamic_loader.next_train_batch(batch)) {
+            same = same && fixed_loader.next_train_batch(*fixed) && fixed->count == batch.count &&
+                   fixed->images.topRows(batch.count) == batch.x() && fixed->labels.head(batch.count) == batch.y();
+        }
+        same = same && !fixed_loader.next_train_batch(*fixed);
+        while (dynamic_loader.next_test_batch(batch)) {
+            same = same && fixed_loader.next_test_batch(*fixed) && fixed->count == batch.count &&
+                   fixed->images.topRows(batch.count) == batch.x() && fixed->labels.head(batch.count) == batch.y();
+        }
+        dynamic_loader.reset();
+        fixed_loader.reset();
+    }
+    return same && fixed_loader.epoch() == dynamic_loader.epoch();
+}
+
+void report_pair(const std::string& name, const std::vector<double>& dynamic_ms, const std::vector<double>& fixed_ms) {
+    report(name + ", dynamic", dynamic_ms);
+    report(name + ", fixed", fixed_ms);
+    std::cout << "  speedup " << std::fixed << std::setprecision(2) << median(dynamic_ms) / median(fixed_ms) << "x\n";
+}
+
+} // anonymous namespace
+
+int bench_fixed(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int reps = argc > 2 ? std::stoi(argv[2]) : 5;
+    set_log_level(LogLevel::Warning);
+
+    MnistData data = load_mnist(root);
+    MnistLoadOptions u8_options;
+    u8_options.storage = MnistStorage::Uint8;
+    MnistData pixels = load_mnist(root, u8_options);
+
+    std::cout << "Fixed-geometry checks (" << Shape::rows << "x" << Shape::cols << ", " << Shape::classes
+              << " classes, batch " << Shape::batch_size << ")\n";
+    bool ok = true;
+    ok = check("MNIST matches the 28x28 shape", FixedMnistData<Shape>::matches(data)) && ok;
+    ok = check("a different geometry is rejected", !FixedMnistData<MnistShape<32, 32, 10, 100>>::matches(data)) && ok;
+    ok = check("labels beyond the class count are rejected",
+               throws([&] { FixedMnistData<MnistShape<28, 28, 5, 100>> too_few_classes(data); })) && ok;
+    ok = check("file-order batches identical to MnistBatchLoader", same_batches(data, false)) && ok;
+    ok = check("shuffled batches identical to MnistBatchLoader", same_batches(data, true)) && ok;
+    ok = check("uint8 storage batches identical to MnistBatchLoader", same_batches(pixels, true)) && ok;
+
+    // Logits for one full and one partial batch
+    std::mt19937 rng(7);
+    std::normal_distribution<float> normal(0.0f, 3.0f);
+    std::uniform_int_distribution<int> label(0, Shape::classes - 1);
+    const int logit_rows = data.test_count;
+    Math::RowMatrix<float> logits(logit_rows, Shape::classes);
+    Eigen::VectorXi labels(logit_rows);
+    for (int i = 0; i < logit_rows; ++i) {
+        for (int j = 0; j < Shape::classes; ++j) logits(i, j) = normal(rng);
+        labels[i] = label(rng);
+    }
+    bool softmax_same = true;
+    for (int count : {Shape::batch_size, 37}) {
+        Math::RowMatrix<float> dynamic_grad(count, Shape::classes), fixed_grad(count, Shape::classes);
+        float dynamic_loss = Math::softmax_cross_entropy<float>(logits.topRows(count), labels.head(count), dynamic_grad);
+        float fixed_loss = fixed_softmax_cross_entropy<Shape::classes>(logits.data(), labels.data(), count, fixed_grad.data());
+        softmax_same = softmax_same && dynamic_loss == fixed_loss && dynamic_grad == fixed_grad;
+    }
+    ok = check("fixed softmax + cross-entropy identical to Math::softmax_cross_entropy", softmax_same) && ok;
+
+    std::cout << "\nHot paths, dynamic vs. fixed geometry (" << reps << " reps, SIMD level "
+              << simd_level_name(simd_level()) << ")\n";
+    for (const MnistData* source : {&data, &pixels}) {
+        const std::string storage = source->storage == MnistStorage::Float ? "float" : "uint8";
+        MnistBatchLoader dynamic_loader(*source, Shape::batch_size);
+        dynamic_loader.enable_shuffle(42);
+        MnistBatch batch;
+        std::vector<double> dynamic_ms = time_runs(reps, [&] {
+            while (dynamic_loader.next_train_batch(batch)) {
+            }
+            dynamic_loader.reset();
+        });
+        FixedMnistData<Shape> fixed_data(*source);
+        FixedMnistLoader<Shape> fixed_loader(fixed_data);
+        fixed_loader.enable_shuffle(42);
+        auto fixed = std::make_unique<FixedMnistBatch<Shape>>();
+        std::vector<double> fixed_ms = time_runs(reps, [&] {
+            while (fixed_loader.next_train_batch(*fixed)) {
+            }
+            fixed_loader.reset();
+        });
+        report_pair("shuffled epoch, " + storage, dynamic_ms, fixed_ms);
+    }
+
+    {
+        // Every batch of an epoch's worth of logits
+        const int batches = logit_rows / Shape::batch_size;
+        Math::RowMatrix<float> grad(Shape::batch_size, Shape::classes);
+        std::vector<double> dynamic_ms = time_runs(reps, [&] {
+            for (int b = 0; b < batches; ++b) {
+                Math::softmax_cross_entropy<float>(logits.middleRows(b * Shape::batch_size, Shape::batch_size),
+                                                   labels.segment(b * Shape::batch_size, Shape::batch_size), grad);
+            }
+        });
+        std::vector<double> fixed_ms = time_runs(reps, [&] {
+            for (int b = 0; b < batches; ++b) {
+                fixed_softmax_cross_entropy<Shape::classes>(logits.row(b * Shape::batch_size).data(),
+                                                            labels.data() + b * Shape::batch_size,
+                                                            Shape::batch_size, grad.data());
+            }
+        });
+        report_pair("softmax + loss, " + std::to_string(batches) + " batches", dynamic_ms, fixed_ms);
+    }
+
+    {
+        // First affine layer of a 784-100-10 MLP on one batch
+        const int hidden = 100, iters = 200;
+        RowMatrixXf weights = RowMatrixXf::Random(Shape::features, hidden);
+        RowMatrixXf dynamic_x = data.test_images.topRows(Shape::batch_size), dynamic_out(Shape::batch_size, hidden);
+        auto fixed_x = std::make_unique<FixedMnistBatch<Shape>::Images>(dynamic_x);
+        Eigen::Matrix<float, Shape::features, Eigen::Dynamic, Eigen::RowMajor> fixed_weights = weights;
+        Eigen::Matrix<float, Shape::batch_size, Eigen::Dynamic, Eigen::RowMajor> fixed_out(Shape::batch_size, hidden);
+        std::vector<double> dynamic_ms = time_runs(reps, [&] {
+            for (int i = 0; i < iters; ++i) dynamic_out.noalias() = dynamic_x * weights;
+        });
+        std::vector<double> fixed_ms = time_runs(reps, [&] {
+            for (int i = 0; i < iters; ++i) fixed_out.noalias() = *fixed_x * fixed_weights;
+        });
+        report_pair("affine 100x784 * 784x100, " + std::to_string(iters) + " batches", dynamic_ms, fixed_ms);
+        ok = check("fixed affine layer matches the dynamic one",
+                   (fixed_out - dynamic_out).cwiseAbs().maxCoeff() <= 1e-4f * std::max(1.0f, dynamic_out.cwiseAbs().maxCoeff())) && ok;
+    }
+
+    std::cout << (ok ? "fixed-geometry checks passed" : "fixed-geometry check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
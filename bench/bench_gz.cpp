@@ -0,0 +1,81 @@
+#include "bench.h"
+#include "mnist_loader.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+const char* files[] = {
+    "train-images-idx3-ubyte",
+    "train-labels-idx1-ubyte",
+    "t10k-images-idx3-ubyte",
+    "t10k-labels-idx1-ubyte"
+};
+
+// The old init_mnist step: gzread in 4 KB chunks into an unzipped copy on disk
+void ungzip_to_disk(const std::string& src, const std::string& dst) {
+    gzFile in = gzopen(src.c_str(), "rb");
+    if (!in) throw std::runtime_error("Failed to open " + src);
+    std::ofstream out(dst, std::ios::binary | std::ios::trunc);
+    char buffer[4096];
+    int len;
+    while ((len = gzread(in, buffer, sizeof(buffer))) > 0) {
+        out.write(buffer, len);
+    }
+    gzclose(in);
+    if (len < 0) throw std::runtime_error("Failed to decompress " + src);
+}
+
+} // anonymous namespace
+
+int bench_gz(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    std::string scratch = argc > 2 ? argv[2] : root + "/bench_unzipped";
+    int reps = argc > 3 ? std::stoi(argv[3]) : 3;
+
+    MnistLoadOptions options;
+    MnistData via_disk, via_stream;
+
+    ::mkdir(scratch.c_str(), 0755);
+    for (const char* name : files) {
+        std::ofstream(scratch + "/" + name + ".gz", std::ios::binary)
+            << std::ifstream(root + "/" + name + ".gz", std::ios::binary).rdbuf();
+    }
+
+    auto disk_runs = time_runs(reps, [&] {
+        for (const char* name : files) {
+            ungzip_to_disk(scratch + "/" + name + ".gz", scratch + "/" + name);
+        }
+        via_disk = load_mnist(map_mnist(scratch), options);
+    });
+
+    for (MnistStorage storage : {MnistStorage::Float, MnistStorage::Uint8}) {
+        options.storage = storage;
+        auto stream_runs = time_runs(reps, [&] { via_stream = load_mnist_gz(root, options); });
+        if (storage == MnistStorage::Float) {
+            if (via_stream.train_images != via_disk.train_images || via_stream.test_images != via_disk.test_images ||
+                via_stream.train_labels != via_disk.train_labels || via_stream.test_labels != via_disk.test_labels) {
+                std::cerr << "streamed gzip load differs from the unzip-to-disk path" << std::endl;
+                return 1;
+            }
+            std::cout << "\nLoading from .gz (" << reps << " runs)\n";
+            report("ungzip to disk + load", disk_runs);
+            report("streaming gzip, float storage", stream_runs);
+        } else {
+            report("streaming gzip, uint8 storage", stream_runs);
+        }
+    }
+
+    for (const char* name : files) {
+        std::remove((scratch + "/" + name).c_str());
+        std::remove((scratch + "/" + name + ".gz").c_str());
+    }
+    ::rmdir(scratch.c_str());
+    return 0;
+}
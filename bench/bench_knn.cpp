@@ -0,0 +1,173 @@
+#include "bench.h"
+#include "knn.h"
+#include "log.h"
+#include "metrics.h"
+#include "mnist_loader.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Exact squared distances from one query to every training image, in double
+std::vector<double> exact_distances(const MnistData& data, const float* query) {
+    const int features = data.rows * data.cols;
+    const float* train = data.image_data(MnistSplit::Train);
+    std::vector<double> distances(data.train_count);
+    for (int r = 0; r < data.train_count; ++r) {
+        double sum = 0.0;
+        for (int f = 0; f < features; ++f) {
+            const double d = static_cast<double>(query[f]) - train[static_cast<size_t>(r) * features + f];
+            sum += d * d;
+        }
+        distances[r] = sum;
+    }
+    return distances;
+}
+
+// The blocked search may swap neighbours whose distances differ by float rounding, but never
+// returns one that is farther than the true k-th nearest by more than that
+bool neighbours_exact(const MnistData& data, const RowMatrixXf& queries, const std::vector<int>& indices, int k) {
+    for (int q = 0; q < queries.rows(); ++q) {
+        std::vector<double> distances = exact_distances(data, queries.row(q).data());
+        std::vector<double> sorted = distances;
+        std::nth_element(sorted.begin(), sorted.begin() + (k - 1), sorted.end());
+        const double kth = sorted[k - 1];
+        const double tolerance = 1e-4 * std::max(1.0, kth);
+        for (int n = 0; n < k; ++n) {
+            const int index = indices[static_cast<size_t>(q) * k + n];
+            if (index < 0 || distances[index] > kth + tolerance ||
+                (n > 0 && distances[index] + tolerance < distances[indices[static_cast<size_t>(q) * k + n - 1]])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void report_rate(const std::string& name, int queries, double seconds, double accuracy = -1.0) {
+    std::cout << "  " << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(10) << queries / seconds << " queries/s";
+    if (accuracy >= 0.0) {
+        std::cout << "   accuracy " << std::setprecision(4) << accuracy;
+    }
+    std::cout << "\n";
+}
+
+} // anonymous namespace
+
+int bench_knn(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int k = argc > 2 ? std::stoi(argv[2]) : 3;
+    int max_threads = argc > 3 ? std::stoi(argv[3]) : std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+    int subset = argc > 4 ? std::stoi(argv[4]) : 500;
+    set_log_level(LogLevel::Warning);
+
+    MnistData data = load_mnist(root);
+    MnistLoadOptions u8_options;
+    u8_options.storage = MnistStorage::Uint8;
+    MnistData pixels = load_mnist(root, u8_options);
+    subset = std::min(subset, data.test_count);
+    RowMatrixXf queries = data.test_images.topRows(subset);
+
+    KnnOptions options;
+    options.k = k;
+    std::cout << "k-NN checks (k = " << k << ", " << data.train_count << " references, " << subset << " queries)\n";
+    bool ok = true;
+    std::vector<int> indices(static_cast<size_t>(subset) * k);
+    {
+        KnnClassifier knn(data, options);
+        knn.search(queries.data(), subset, indices.data());
+        const int checked = std::min(subset, 50);
+        ok = check("blocked neighbours match an exact double-precision scan (" + std::to_string(checked) + " queries)",
+                   neighbours_exact(data, queries.topRows(checked), indices, k)) && ok;
+
+        std::vector<int> predicted(subset), reference(subset);
+        knn.predict(queries.data(), subset, predicted.data());
+        KnnOptions many = options;
+        many.num_threads = max_threads;
+        KnnClassifier parallel(data, many);
+        std::vector<int> parallel_indices(indices.size());
+        parallel.search(queries.data(), subset, parallel_indices.data());
+        parallel.predict(queries.data(), subset, reference.data());
+        ok = check("identical with 1 and " + std::to_string(max_threads) + " threads",
+                   parallel_indices == indices && reference == predicted) && ok;
+
+        KnnClassifier from_pixels(pixels, options);
+        std::vector<int> pixel_indices(indices.size());
+        from_pixels.search(queries.data(), subset, pixel_indices.data());
+        ok = check("uint8 storage finds the same neighbours as float storage", pixel_indices == indices) && ok;
+
+        // Labels voted from the returned neighbours, nearest first on a tie
+        bool votes_ok = true;
+        for (int q = 0; q < subset; ++q) {
+            std::vector<int> votes(10, 0);
+            int best = -1, best_votes = 0;
+            for (int n = 0; n < k; ++n) ++votes[data.train_labels[indices[static_cast<size_t>(q) * k + n]]];
+            for (int n = 0; n < k; ++n) {
+                const int label = data.train_labels[indices[static_cast<size_t>(q) * k + n]];
+                if (votes[label] > best_votes) {
+                    best_votes = votes[label];
+                    best = label;
+                }
+            }
+            votes_ok = votes_ok && best == predicted[q];
+        }
+        ok = check("predictions are the majority vote of the neighbours", votes_ok) && ok;
+    }
+    KnnOptions bad = options;
+    bad.k = 0;
+    ok = check("invalid options are rejected", throws([&] { KnnClassifier knn(data, bad); })) && ok;
+
+    // The naive form: one scalar distance per (query, reference) pair, then a full sort
+    std::cout << "\nQueries/sec on " << std::thread::hardware_concurrency() << " hardware threads\n";
+    {
+        const int naive_queries = std::min(subset, 20);
+        std::vector<int> order(data.train_count);
+        std::vector<double> runs = time_runs(1, [&] {
+            for (int q = 0; q < naive_queries; ++q) {
+                std::vector<double> distances = exact_distances(data, queries.row(q).data());
+                for (int r = 0; r < data.train_count; ++r) order[r] = r;
+                std::sort(order.begin(), order.end(), [&](int a, int b) { return distances[a] < distances[b]; });
+            }
+        });
+        report_rate("naive scan + sort", naive_queries, runs[0] / 1000.0);
+    }
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        KnnOptions sweep = options;
+        sweep.num_threads = threads;
+        KnnClassifier knn(data, sweep);
+        std::vector<int> predicted(subset);
+        std::vector<double> runs = time_runs(3, [&] { knn.predict(queries.data(), subset, predicted.data()); });
+        report_rate("blocked GEMM, " + std::to_string(threads) + " threads", subset, median(runs) / 1000.0);
+    }
+
+    std::cout << "\nFull test split (" << data.test_count << " queries, " << max_threads << " threads)\n";
+    const std::pair<const char*, const MnistData*> sources[] = {{"float", &data}, {"uint8", &pixels}};
+    for (const auto& source : sources) {
+        KnnOptions full = options;
+        full.num_threads = max_threads;
+        KnnClassifier knn(*source.second, full);
+        EvalReport result = knn.evaluate(MnistSplit::Test);
+        report_rate(std::to_string(k) + "-NN, " + source.first, result.count, result.seconds, result.accuracy());
+    }
+    {
+        KnnOptions centroids = options;
+        centroids.centroids = true;
+        centroids.num_threads = max_threads;
+        KnnClassifier knn(data, centroids);
+        metrics_reset();
+        EvalReport result = knn.evaluate(MnistSplit::Test);
+        report_rate("nearest centroid", result.count, result.seconds, result.accuracy());
+        ok = check("nearest centroid beats chance", result.accuracy() > 1.0f / knn.num_references()) && ok;
+        const MetricsSnapshot metrics = metrics_snapshot();
+        ok = check("evaluation is recorded in the evaluate timer",
+                   !metrics.enabled || metrics.timer(MetricTimer::Evaluate).count == 1) && ok;
+    }
+
+    std::cout << (ok ? "k-NN checks passed" : "k-NN check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
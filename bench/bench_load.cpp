@@ -0,0 +1,85 @@
+#include "bench.h"
+#include "mnist_loader.h"
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+int read_int(std::ifstream& f) {
+    unsigned char buf[4];
+    f.read(reinterpret_cast<char*>(buf), 4);
+    if (f.gcount() != 4) throw std::runtime_error("truncated IDX header");
+    return (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+}
+
+// The per-row ifstream loader that load_mnist used before IdxFile, kept as a baseline
+void legacy_load_images(const std::string& path, RowMatrixXf& matrix, bool normalize) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Cannot open image file: " + path);
+    read_int(file);
+    int count = read_int(file);
+    int img_size = read_int(file) * read_int(file);
+    matrix.resize(count, img_size);
+    std::vector<unsigned char> buffer(img_size);
+    for (int i = 0; i < count; ++i) {
+        file.read(reinterpret_cast<char*>(buffer.data()), img_size);
+        for (int j = 0; j < img_size; ++j) {
+            matrix(i, j) = normalize ? buffer[j] / 255.0f : static_cast<float>(buffer[j]);
+        }
+    }
+}
+
+void legacy_load_labels(const std::string& path, Eigen::VectorXi& vector) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) throw std::runtime_error("Cannot open label file: " + path);
+    read_int(file);
+    int count = read_int(file);
+    vector.resize(count);
+    for (int i = 0; i < count; ++i) {
+        unsigned char label;
+        file.read(reinterpret_cast<char*>(&label), 1);
+        vector(i) = label;
+    }
+}
+
+} // anonymous namespace
+
+int bench_load(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int reps = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    MnistData legacy;
+    auto legacy_runs = time_runs(reps, [&] {
+        legacy = MnistData();
+        legacy_load_images(root + "/train-images-idx3-ubyte", legacy.train_images, true);
+        legacy_load_labels(root + "/train-labels-idx1-ubyte", legacy.train_labels);
+        legacy_load_images(root + "/t10k-images-idx3-ubyte", legacy.test_images, true);
+        legacy_load_labels(root + "/t10k-labels-idx1-ubyte", legacy.test_labels);
+    });
+
+    auto map_runs = time_runs(reps, [&] {
+        MnistMapped mapped = map_mnist(root);
+    });
+
+    MnistData mapped_data;
+    auto mmap_runs = time_runs(reps, [&] {
+        mapped_data = load_mnist(map_mnist(root), true);
+    });
+
+    if (legacy.train_images != mapped_data.train_images || legacy.test_images != mapped_data.test_images ||
+        legacy.train_labels != mapped_data.train_labels ||
+        legacy.test_labels != mapped_data.test_labels) {
+        std::cerr << "mmap loader output differs from the ifstream baseline" << std::endl;
+        return 1;
+    }
+
+    std::cout << "\nStartup load of " << mapped_data.train_count << " + " << mapped_data.test_count
+              << " images (" << reps << " runs)\n";
+    report("ifstream per-row (legacy)", legacy_runs);
+    report("mmap + fill MnistData", mmap_runs);
+    report("mmap views only", map_runs);
+    return 0;
+}
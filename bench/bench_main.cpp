@@ -0,0 +1,109 @@
+#include "bench.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+std::vector<double> time_runs(int reps, const std::function<void()>& fn) {
+    std::vector<double> samples;
+    samples.reserve(reps);
+    for (int i = 0; i < reps; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return samples;
+}
+
+double median(std::vector<double> samples) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t mid = samples.size() / 2;
+    return samples.size() % 2 ? samples[mid] : 0.5 * (samples[mid - 1] + samples[mid]);
+}
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.0;
+    size_t k = std::min(samples.size() - 1, static_cast<size_t>(p * (samples.size() - 1) + 0.5));
+    std::nth_element(samples.begin(), samples.begin() + k, samples.end());
+    return samples[k];
+}
+
+bool check(const std::string& what, bool ok) {
+    std::cout << (ok ? "  ok    " : "  FAIL  ") << what << "\n";
+    return ok;
+}
+
+void report(const std::string& name, const std::vector<double>& samples_ms) {
+    double best = samples_ms.empty() ? 0.0 : *std::min_element(samples_ms.begin(), samples_ms.end());
+    std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(3)
+              << " median " << std::setw(10) << median(samples_ms) << " ms"
+              << "   min " << std::setw(10) << best << " ms\n";
+}
+
+namespace {
+
+struct Command {
+    const char* name;
+    BenchEntry entry;
+    const char* usage;
+};
+
+const Command commands[] = {
+    {"load", bench_load, "load [root=./data] [reps=5]   ifstream vs. mmap IDX startup"},
+    {"storage", bench_storage, "storage [root=./data] [batch=100]   float vs. uint8 image storage"},
+    {"batch", bench_batch, "batch [root=./data] [batch=100] [reps=5]   column- vs. row-major batch extraction"},
+    {"prefetch", bench_prefetch, "prefetch [root=./data] [batch=100] [compute_us=50] [depth=4] [workers=1]   sync vs. prefetching loader"},
+    {"alloc", bench_alloc, "alloc [root=./data] [batch=100]   zero-allocation and shuffle checks (exit 1 on failure)"},
+    {"gz", bench_gz, "gz [root=./data] [scratch=root/bench_unzipped] [reps=3]   unzip-to-disk vs. streaming gzip load"},
+    {"snapshot", bench_snapshot, "snapshot [root=./data] [reps=5]   IDX parse vs. snapshot warm start"},
+    {"download", bench_download, "download [root=./data] [scratch=root/bench_download] [reps=3]   resumable parallel download from a file:// mirror (exit 1 on failure)"},
+    {"softmax", bench_softmax, "softmax [batch=100] [classes=10] [iters=10000] [reps=5]   fused softmax + cross-entropy vs. cross_entropy_error (exit 1 on mismatch)"},
+    {"train", bench_train, "train [root=./data] [batch=100] [hidden=100] [epochs=1]   MLP gradient check and training throughput per optimizer"},
+    {"parallel", bench_parallel, "parallel [root=./data] [max_threads=cores] [batch=256] [hidden=100] [epochs=1]   data-parallel scaling and determinism (exit 1 on failure)"},
+    {"serve", bench_serve, "serve [root=./data] [address=/tmp/mnist_bench.sock] [clients=8] [depth=8] [requests=5000]   in-process inference server under load, per max-batch policy"},
+    {"loadgen", bench_loadgen, "loadgen <address> [root=./data] [clients=8] [depth=8] [requests=5000]   load generator against a running mnist_cpp --serve"},
+    {"quant", bench_quant, "quant [root=./data] [batch=256] [hidden=100] [reps=5]   int8 inference on raw pixels vs. fp32, per kernel (exit 1 on failure)"},
+    {"suite", bench_suite, "suite [root=./data|synthetic] [json=-] [reps=10]   init/load/batch/loss/epoch suite, JSON with min/median/p99 and bytes/sec"},
+    {"synth", bench_synth, "synth [root=./data] [train=60000] [test=10000] [seed=1]   write a synthetic MNIST dataset"},
+    {"metrics", bench_metrics, "metrics [root=./data] [batch=100]   stage counters and timers: consistency, recording cost, JSON and Prometheus export (exit 1 on failure)"},
+    {"simd", bench_simd, "simd [root=./data] [batch=100] [reps=5]   per-ISA correctness and speed of the normalize, gather and argmax kernels (exit 1 on failure)"},
+    {"stream", bench_stream, "stream [root=./data] [chunk=4096] [depth=2] [big=200000]   every IDX dtype and rank, non-28x28 loads, chunked streaming with bounded memory (exit 1 on failure)"},
+    {"shard", bench_shard, "shard [root=./data] [world=4] [epochs=3] [seed=42]   rank/world_size sharded loading across forked processes: disjoint, covering, repeatable (exit 1 on failure)"},
+    {"manifest", bench_manifest, "manifest [root=./data] [reps=20]   manifest fast path for init_mnist, invalidation and background hash verification (exit 1 on failure)"},
+    {"eval", bench_eval, "eval [root=./data] [batch=512] [max_threads=cores] [hidden=100]   parallel evaluation: confusion matrix against per-sample prediction, per-thread-count cost (exit 1 on failure)"},
+    {"augment", bench_augment, "augment [root=./data] [batch=100] [max_workers=cores] [compute_us=2000]   shift/rotation/elastic augmentation in the prefetch loader: reproducibility, images/sec per core (exit 1 on failure)"},
+    {"checkpoint", bench_checkpoint, "checkpoint [root=./data] [hidden=100] [reps=5]   checkpoint round trip, resume, mmap serving, damaged files, background vs. synchronous saves (exit 1 on failure)"},
+    {"fixed", bench_fixed, "fixed [root=./data] [reps=5]   compile-time 28x28 loader, softmax, argmax and affine layer vs. the dynamic-shape path (exit 1 on mismatch)"},
+    {"knn", bench_knn, "knn [root=./data] [k=3] [max_threads=cores] [subset=500]   blocked-GEMM k-NN and nearest centroid: exactness, queries/sec and test accuracy (exit 1 on failure)"},
+};
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog << " <command> [args...]\n";
+    for (const auto& cmd : commands) {
+        std::cerr << "  " << cmd.usage << "\n";
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    for (const auto& cmd : commands) {
+        if (std::strcmp(argv[1], cmd.name) == 0) {
+            try {
+                return cmd.entry(argc - 1, argv + 1);
+            } catch (const std::exception& e) {
+                std::cerr << "错误: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+    }
+    print_usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,129 @@
+#include "bench.h"
+#include "log.h"
+#include "mnist_loader.h"
+#include "mnist_manifest.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char* const idx_names[] = {"train-images-idx3-ubyte", "train-labels-idx1-ubyte", "t10k-images-idx3-ubyte",
+                                 "t10k-labels-idx1-ubyte"};
+
+std::vector<char> read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+bool file_exists(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+// init_mnist took the fast path if it left the manifest exactly as it was
+bool fast_path_taken(const std::string& root) {
+    struct stat before, after;
+    if (::stat(mnist_manifest_path(root).c_str(), &before) != 0) return false;
+    ::usleep(2000);
+    init_mnist(root);
+    return ::stat(mnist_manifest_path(root).c_str(), &after) == 0 && before.st_ino == after.st_ino &&
+           before.st_mtim.tv_nsec == after.st_mtim.tv_nsec && before.st_mtim.tv_sec == after.st_mtim.tv_sec;
+}
+
+// Overwrites one byte in place and puts the old modification time back, so only a content
+// check can notice
+void tamper_keep_mtime(const std::string& path, size_t offset) {
+    struct stat st;
+    ::stat(path.c_str(), &st);
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg(static_cast<std::streamoff>(offset));
+    char c = 0;
+    file.get(c);
+    file.seekp(static_cast<std::streamoff>(offset));
+    file.put(static_cast<char>(c ^ 0x5a));
+    file.close();
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    ::utimensat(AT_FDCWD, path.c_str(), times, 0);
+}
+
+bool check_manifest(const std::string& scratch) {
+    bool ok = true;
+    std::remove(mnist_manifest_path(scratch).c_str());
+    init_mnist(scratch);
+    std::vector<ManifestEntry> entries;
+    ok = check("slow init writes a manifest of the IDX files and archives",
+               read_mnist_manifest(scratch, entries) && entries.size() == 8) && ok;
+    ok = check("next init takes the fast path", fast_path_taken(scratch)) && ok;
+
+    // A newer modification time alone is enough to leave the fast path
+    const std::string labels = scratch + "/" + idx_names[1];
+    ::utimensat(AT_FDCWD, labels.c_str(), nullptr, 0);
+    ok = check("touched file invalidates the manifest", !fast_path_taken(scratch)) && ok;
+    ok = check("slow path rewrites it", fast_path_taken(scratch)) && ok;
+
+    // So does a size change; the slow path rejects the damaged file and restores it from the archive
+    const std::string images = scratch + "/" + idx_names[2];
+    const std::vector<char> original = read_file(images);
+    {
+        std::ofstream out(images, std::ios::binary | std::ios::app);
+        out << "trailing bytes";
+    }
+    ok = check("resized file invalidates the manifest", !fast_path_taken(scratch) && read_file(images) == original) && ok;
+
+    ok = check("background verification passes on clean data", verify_mnist_manifest_async(scratch).get()) && ok;
+
+    // Same size and mtime: the fast path cannot see it, the hash check must
+    tamper_keep_mtime(images, 1000);
+    ok = check("content change with preserved mtime still takes the fast path", fast_path_taken(scratch)) && ok;
+    ok = check("background verification catches it",
+               !verify_mnist_manifest_async(scratch).get() && !file_exists(images) &&
+                   !file_exists(mnist_manifest_path(scratch))) && ok;
+    init_mnist(scratch);
+    ok = check("next init restores the file from its archive",
+               read_file(images) == original && file_exists(mnist_manifest_path(scratch))) && ok;
+
+    MnistInitOptions no_manifest;
+    no_manifest.use_manifest = false;
+    std::remove(mnist_manifest_path(scratch).c_str());
+    init_mnist(scratch, no_manifest);
+    ok = check("use_manifest = false writes no manifest", !file_exists(mnist_manifest_path(scratch))) && ok;
+    return ok;
+}
+
+} // anonymous namespace
+
+int bench_manifest(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int reps = argc > 2 ? std::stoi(argv[2]) : 20;
+    set_log_level(LogLevel::Warning);
+
+    std::string scratch = root + "/bench_manifest";
+    ::mkdir(scratch.c_str(), 0755);
+    write_synthetic_mnist(scratch, 2000, 500, 7);
+    std::cout << "Manifest checks on a synthetic dataset\n";
+    bool ok = check_manifest(scratch);
+    for (const char* name : idx_names) {
+        std::remove((scratch + "/" + name).c_str());
+        std::remove((scratch + "/" + name + ".gz").c_str());
+    }
+    std::remove(mnist_manifest_path(scratch).c_str());
+    ::rmdir(scratch.c_str());
+
+    std::cout << "\ninit_mnist startup on " << root << "\n";
+    init_mnist(root);
+    MnistInitOptions slow;
+    slow.use_manifest = false;
+    report("magic-number checks (use_manifest = false)", time_runs(reps, [&] { init_mnist(root, slow); }));
+    report("manifest fast path", time_runs(reps, [&] { init_mnist(root); }));
+    report("full hash verification (off the startup path)", time_runs(3, [&] { verify_mnist_manifest(root); }));
+
+    std::cout << (ok ? "manifest checks passed" : "manifest check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
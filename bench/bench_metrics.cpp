@@ -0,0 +1,79 @@
+#include "bench.h"
+#include "log.h"
+#include "metrics.h"
+#include "mnist_loader.h"
+#include "mnist_prefetch.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+namespace {
+
+bool expect(const char* what, uint64_t got, uint64_t want) {
+    bool ok = got == want;
+    std::cout << (ok ? "  ok    " : "  FAIL  ") << what << ": " << got;
+    if (!ok) std::cout << " (expected " << want << ")";
+    std::cout << "\n";
+    return ok;
+}
+
+} // anonymous namespace
+
+int bench_metrics(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 100;
+
+    set_log_level(LogLevel::Warning);
+    init_mnist(root);
+    metrics_reset();
+    MnistData data = load_mnist(map_mnist(root));
+    MetricsSnapshot after_load = metrics_snapshot();
+
+    metrics_reset();
+    MnistBatchLoader loader(data, batch_size);
+    MnistBatch batch;
+    while (loader.next_train_batch(batch)) {
+    }
+    MnistPrefetchLoader prefetch(data, batch_size, MnistSplit::Test, 2, 1);
+    while (prefetch.next_batch(batch)) {
+    }
+    MetricsSnapshot after_batches = metrics_snapshot();
+
+    bool ok = true;
+    if (!after_load.enabled) {
+        std::cout << "metrics are compiled out (MNIST_METRICS=0); every snapshot is zero\n";
+        ok = after_load.counter(MetricCounter::ParsedBytes) == 0;
+    } else {
+        const uint64_t img_size = static_cast<uint64_t>(data.rows) * data.cols;
+        const uint64_t batches = (data.train_count + batch_size - 1) / batch_size +
+                                 (data.test_count + batch_size - 1) / batch_size;
+        std::cout << "Metric consistency\n";
+        ok = expect("parsed_bytes", after_load.counter(MetricCounter::ParsedBytes),
+                    (data.train_count + data.test_count) * (img_size + 1)) && ok;
+        ok = expect("parse count", after_load.timer(MetricTimer::Parse).count, 1) && ok;
+        ok = expect("normalize count", after_load.timer(MetricTimer::Normalize).count, 2) && ok;
+        ok = expect("batches_served", after_batches.counter(MetricCounter::BatchesServed), batches) && ok;
+        ok = expect("samples_served", after_batches.counter(MetricCounter::SamplesServed),
+                    data.train_count + data.test_count) && ok;
+        ok = expect("data_wait count = data_waits", after_batches.timer(MetricTimer::DataWait).count,
+                    after_batches.counter(MetricCounter::DataWaits)) && ok;
+    }
+
+    // Cost of the recording calls themselves, against an uncontended cache line
+    const int calls = 10000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i) metrics_add(MetricCounter::BatchesServed);
+    double add_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls / 10; ++i) ScopedTimer timer(MetricTimer::DataWait);
+    double timer_ns =
+        std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (calls / 10);
+    std::cout << std::fixed << std::setprecision(1) << "metrics_add " << add_ns << " ns, ScopedTimer " << timer_ns
+              << " ns\n";
+
+    std::cout << "\nJSON after loading:\n" << metrics_json(after_load) << "\n";
+    std::cout << "\nPrometheus after batching:\n" << metrics_prometheus(after_batches);
+    std::cout << (ok ? "metrics consistent" : "metrics check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
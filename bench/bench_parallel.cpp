@@ -0,0 +1,85 @@
+#include "bench.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include "parallel_trainer.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+const uint64_t seed = 42;
+
+Eigen::VectorXf train_parallel(const MnistData& data, int hidden, int batch_size, int threads, int epochs,
+                               double* seconds = nullptr, float* accuracy = nullptr) {
+    Mlp model({data.rows * data.cols, hidden, 10}, seed);
+    OptimizerConfig config;
+    config.kind = OptimizerKind::Adam;
+    DataParallelTrainer trainer(model, data, config, batch_size, threads);
+    trainer.enable_shuffle(seed);
+    auto runs = time_runs(epochs, [&] { trainer.train_epoch(); });
+    if (seconds) {
+        *seconds = 0.0;
+        for (double ms : runs) *seconds += ms / 1000.0;
+    }
+    if (accuracy) *accuracy = trainer.evaluate(MnistSplit::Test);
+    return model.parameters();
+}
+
+} // anonymous namespace
+
+int bench_parallel(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int max_threads = argc > 2 ? std::stoi(argv[2]) : std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+    int batch_size = argc > 3 ? std::stoi(argv[3]) : 256;
+    int hidden = argc > 4 ? std::stoi(argv[4]) : 100;
+    int epochs = argc > 5 ? std::stoi(argv[5]) : 1;
+
+    MnistData data = load_mnist(root);
+    bool ok = true;
+
+    // One thread must reproduce the single-threaded trainer exactly
+    {
+        Mlp model({data.rows * data.cols, hidden, 10}, seed);
+        OptimizerConfig config;
+        config.kind = OptimizerKind::Adam;
+        MlpTrainer trainer(model, config, batch_size);
+        MnistBatchLoader loader(data, batch_size);
+        loader.enable_shuffle(seed);
+        trainer.train_epoch(loader);
+        bool same = train_parallel(data, hidden, batch_size, 1, 1) == model.parameters();
+        std::cout << (same ? "PASS  " : "FAIL  ") << "1 thread matches MlpTrainer bit for bit\n";
+        ok &= same;
+    }
+    // Two runs with the same thread count must agree bit for bit
+    {
+        bool same = train_parallel(data, hidden, batch_size, max_threads, 1) ==
+                    train_parallel(data, hidden, batch_size, max_threads, 1);
+        std::cout << (same ? "PASS  " : "FAIL  ") << max_threads << " threads are deterministic across runs\n";
+        ok &= same;
+    }
+    // A model whose input does not match the images would overrun the shard buffers
+    {
+        Mlp narrow({data.rows * data.cols / 2, hidden, 10}, seed);
+        bool rejected = throws([&] { DataParallelTrainer trainer(narrow, data, OptimizerConfig(), batch_size, 1); });
+        std::cout << (rejected ? "PASS  " : "FAIL  ") << "a model/image size mismatch is rejected\n";
+        ok &= rejected;
+    }
+
+    std::cout << "\nData-parallel training, 784-" << hidden << "-10, batch " << batch_size << ", " << epochs
+              << " epoch(s), " << std::thread::hardware_concurrency() << " hardware threads\n";
+    double base = 0.0;
+    for (int threads = 1; threads <= max_threads; threads = threads < max_threads ? std::min(threads * 2, max_threads) : threads + 1) {
+        double seconds = 0.0;
+        float accuracy = 0.0f;
+        train_parallel(data, hidden, batch_size, threads, epochs, &seconds, &accuracy);
+        double rate = static_cast<double>(data.train_count) * epochs / seconds;
+        if (threads == 1) base = rate;
+        std::cout << std::setw(3) << threads << " threads " << std::fixed << std::setprecision(0) << std::setw(10)
+                  << rate << " samples/s   speedup " << std::setprecision(2) << rate / base << "x   test accuracy "
+                  << std::setprecision(4) << accuracy << "\n";
+    }
+    return ok ? 0 : 1;
+}
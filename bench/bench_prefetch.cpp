@@ -0,0 +1,76 @@
+#include "bench.h"
+#include "mnist_loader.h"
+#include "mnist_prefetch.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace {
+
+// Stands in for a training step that keeps the consumer thread busy
+void spin_for(int microseconds) {
+    auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(microseconds);
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+} // anonymous namespace
+
+int bench_prefetch(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 100;
+    int compute_us = argc > 3 ? std::stoi(argv[3]) : 50;
+    int depth = argc > 4 ? std::stoi(argv[4]) : 4;
+    int workers = argc > 5 ? std::stoi(argv[5]) : 1;
+
+    MnistLoadOptions options;
+    options.storage = MnistStorage::Uint8;
+    MnistData data = load_mnist(map_mnist(root), options);
+
+    MnistBatchLoader sync_loader(data, batch_size);
+    MnistPrefetchLoader prefetch_loader(data, batch_size, MnistSplit::Train, depth, workers);
+
+    // The prefetched stream must match the synchronous one, including across a mid-epoch reset
+    RowMatrixXf x;
+    Eigen::VectorXi y;
+    MnistBatch batch;
+    for (int i = 0; i < 7; ++i) {
+        prefetch_loader.next_batch(batch);
+    }
+    prefetch_loader.reset();
+    while (sync_loader.next_train_batch(x, y)) {
+        if (!prefetch_loader.next_batch(batch) || batch.x() != x || batch.y() != y) {
+            std::cerr << "prefetched batches differ from MnistBatchLoader" << std::endl;
+            return 1;
+        }
+    }
+    if (prefetch_loader.next_batch(batch)) {
+        std::cerr << "prefetch loader produced more batches than MnistBatchLoader" << std::endl;
+        return 1;
+    }
+
+    auto sync_runs = time_runs(3, [&] {
+        sync_loader.reset();
+        while (sync_loader.next_train_batch(x, y)) {
+            spin_for(compute_us);
+        }
+    });
+    auto prefetch_runs = time_runs(3, [&] {
+        prefetch_loader.reset();
+        while (prefetch_loader.next_batch(batch)) {
+            spin_for(compute_us);
+        }
+    });
+    auto compute_runs = time_runs(3, [&] {
+        for (int i = 0; i < prefetch_loader.num_batches(); ++i) {
+            spin_for(compute_us);
+        }
+    });
+
+    std::cout << "\nTrain epoch with " << compute_us << " us of compute per batch (batch_size=" << batch_size
+              << ", depth=" << depth << ", workers=" << workers << ")\n";
+    report("compute only", compute_runs);
+    report("synchronous MnistBatchLoader", sync_runs);
+    report("MnistPrefetchLoader", prefetch_runs);
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "bench.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include "quantized_mlp.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+double accuracy(const std::vector<int>& predictions, const MnistData& data) {
+    int correct = 0;
+    for (int i = 0; i < data.test_count; ++i) correct += predictions[i] == data.test_labels[i];
+    return static_cast<double>(correct) / data.test_count;
+}
+
+} // anonymous namespace
+
+int bench_quant(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 256;
+    int hidden = argc > 3 ? std::stoi(argv[3]) : 100;
+    int reps = argc > 4 ? std::stoi(argv[4]) : 5;
+
+    MnistLoadOptions options;
+    options.storage = MnistStorage::Uint8;
+    MnistData data = load_mnist(root, options);
+    const int n = data.test_count;
+    const int inputs = data.rows * data.cols;
+
+    Mlp model({inputs, hidden, 10}, 42);
+    {
+        MlpTrainer trainer(model, OptimizerConfig(), 100);
+        MnistBatchLoader loader(data, 100);
+        loader.enable_shuffle(42);
+        trainer.train_epoch(loader);
+    }
+
+    // fp32 baseline: images are converted once up front, so only the forward passes are timed
+    RowMatrixXf images(n, inputs);
+    copy_images(data, MnistSplit::Test, 0, n, images.data());
+    MlpWorkspace workspace(model.layout(), batch_size);
+    std::vector<int> reference(n);
+    auto fp32 = time_runs(reps, [&] {
+        for (int start = 0; start < n; start += batch_size) {
+            model.predict(images.row(start).data(), std::min(batch_size, n - start), reference.data() + start,
+                          workspace);
+        }
+    });
+
+    std::cout << "\nTest set inference, 784-" << hidden << "-10 MLP, batch " << batch_size << ", " << n << " images\n";
+    report("fp32 (pre-converted images)", fp32);
+    double fp32_ms = median(fp32);
+    std::cout << "  accuracy " << std::fixed << std::setprecision(4) << accuracy(reference, data) << "\n";
+
+    QuantizedMlp quantized(model, data, MnistSplit::Test);
+    QuantizedMlp::Workspace qworkspace(quantized, batch_size);
+    std::cout << "activation scales:";
+    for (float s : quantized.activation_scales()) std::cout << " " << s;
+    std::cout << "\n";
+
+    bool ok = true;
+    std::vector<int> first;
+    for (Int8Kernel kernel : {Int8Kernel::Scalar, Int8Kernel::Avx2, Int8Kernel::Avx512Vnni}) {
+        if (!int8_kernel_supported(kernel)) {
+            std::cout << "int8 " << int8_kernel_name(kernel) << ": not supported on this CPU\n";
+            continue;
+        }
+        quantized.set_kernel(kernel);
+        std::vector<int> predictions(n);
+        // Raw IDX bytes go straight in; there is no uint8 -> float pass
+        auto samples = time_runs(reps, [&] {
+            for (int start = 0; start < n; start += batch_size) {
+                quantized.predict(data.test_pixels.row(start).data(), std::min(batch_size, n - start),
+                                  predictions.data() + start, qworkspace);
+            }
+        });
+        report(std::string("int8 ") + int8_kernel_name(kernel), samples);
+        int agree = 0;
+        for (int i = 0; i < n; ++i) agree += predictions[i] == reference[i];
+        double agreement = static_cast<double>(agree) / n;
+        std::cout << "  accuracy " << std::setprecision(4) << accuracy(predictions, data) << ", agrees with fp32 on "
+                  << agreement * 100.0 << "%, speedup x" << std::setprecision(2) << fp32_ms / median(samples) << "\n";
+        ok = ok && agreement >= 0.98;
+        // Every kernel computes the same int32 sums, so the labels must match exactly
+        if (first.empty()) {
+            first = predictions;
+        } else if (predictions != first) {
+            std::cout << "  predictions differ from the scalar kernel\n";
+            ok = false;
+        }
+    }
+    std::cout << (ok ? "int8 inference matches fp32" : "int8 inference check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+#include "bench.h"
+#include "inference_server.h"
+#include "log.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+int connect_to(const std::string& address) {
+    size_t colon = address.rfind(':');
+    int fd;
+    if (colon != std::string::npos && address.find('/') == std::string::npos) {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(std::stoi(address.substr(colon + 1))));
+        ::inet_pton(AF_INET, address.substr(0, colon).c_str(), &addr.sin_addr);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot connect to " + address);
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    } else {
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("Cannot connect to " + address);
+        }
+    }
+    return fd;
+}
+
+bool send_all(int fd, const uint8_t* data, size_t n) {
+    while (n > 0) {
+        ssize_t sent = ::send(fd, data, n, MSG_NOSIGNAL);
+        if (sent <= 0) return false;
+        data += sent;
+        n -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+struct LoadResult {
+    uint64_t requests = 0;
+    uint64_t mismatches = 0;
+    double seconds = 0.0;
+    std::vector<float> latencies_us;
+};
+
+// Each client keeps `depth` requests in flight on its own connection and checks every reply
+LoadResult run_load(const std::string& address, const MatrixXu8& pixels, const std::vector<int>& expected,
+                    int clients, int depth, int requests_per_client) {
+    std::vector<LoadResult> results(clients);
+    std::atomic<bool> failed{false};
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            LoadResult& r = results[c];
+            r.latencies_us.reserve(requests_per_client);
+            int fd = connect_to(address);
+            std::vector<Clock::time_point> sent_at(requests_per_client);
+            const int n = static_cast<int>(pixels.rows());
+            int next_send = 0;
+            auto send_one = [&] {
+                int image = (c * 7919 + next_send) % n;
+                sent_at[next_send] = Clock::now();
+                if (!send_all(fd, pixels.row(image).data(), pixels.cols())) failed = true;
+                ++next_send;
+            };
+            while (next_send < std::min(depth, requests_per_client)) send_one();
+            for (int received = 0; received < requests_per_client && !failed; ++received) {
+                uint8_t label;
+                if (::recv(fd, &label, 1, MSG_WAITALL) != 1) {
+                    failed = true;
+                    break;
+                }
+                r.latencies_us.push_back(
+                    std::chrono::duration<float, std::micro>(Clock::now() - sent_at[received]).count());
+                r.mismatches += label != expected[(c * 7919 + received) % n];
+                ++r.requests;
+                if (next_send < requests_per_client) send_one();
+            }
+            ::close(fd);
+        });
+    }
+    for (auto& t : threads) t.join();
+    if (failed) {
+        throw std::runtime_error("Load generator lost its connection to " + address);
+    }
+    LoadResult total;
+    total.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    for (auto& r : results) {
+        total.requests += r.requests;
+        total.mismatches += r.mismatches;
+        total.latencies_us.insert(total.latencies_us.end(), r.latencies_us.begin(), r.latencies_us.end());
+    }
+    return total;
+}
+
+double percentile(std::vector<float> v, double p) {
+    if (v.empty()) return 0.0;
+    size_t k = std::min(v.size() - 1, static_cast<size_t>(p * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+void print_result(const std::string& name, const LoadResult& r, const InferenceStats* server) {
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(0)
+              << std::setw(9) << r.requests / r.seconds << " req/s   client p50 " << std::setw(6)
+              << percentile(r.latencies_us, 0.50) << " us  p99 " << std::setw(6) << percentile(r.latencies_us, 0.99)
+              << " us";
+    if (server) {
+        std::cout << "   server p50 " << std::setw(6) << server->p50_us << " us  p99 " << std::setw(6)
+                  << server->p99_us << " us  mean batch " << std::setprecision(1) << server->mean_batch;
+    }
+    std::cout << "\n";
+}
+
+// The test images and what the model predicts for them when run directly
+void prepare(const std::string& root, Mlp& model, MatrixXu8& pixels, std::vector<int>& expected, int epochs) {
+    MnistLoadOptions options;
+    options.storage = MnistStorage::Uint8;
+    MnistData data = load_mnist(root, options);
+    if (epochs > 0) {
+        MlpTrainer trainer(model, OptimizerConfig(), 100);
+        MnistBatchLoader loader(data, 100);
+        loader.enable_shuffle(42);
+        for (int e = 0; e < epochs; ++e) trainer.train_epoch(loader);
+    }
+    pixels = data.test_pixels;
+    RowMatrixXf images(data.test_count, pixels.cols());
+    copy_images(data, MnistSplit::Test, 0, data.test_count, images.data());
+    MlpWorkspace workspace(model.layout(), 1);
+    expected.resize(data.test_count);
+    // One image at a time, so no batch composition can influence the reference
+    for (int i = 0; i < data.test_count; ++i) {
+        model.predict(images.row(i).data(), 1, &expected[i], workspace);
+    }
+}
+
+} // anonymous namespace
+
+int bench_serve(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    std::string address = argc > 2 ? argv[2] : "/tmp/mnist_bench.sock";
+    int clients = argc > 3 ? std::stoi(argv[3]) : 8;
+    int depth = argc > 4 ? std::stoi(argv[4]) : 8;
+    int requests = argc > 5 ? std::stoi(argv[5]) : 5000;
+
+    Mlp model({784, 100, 10}, 42);
+    MatrixXu8 pixels;
+    std::vector<int> expected;
+    prepare(root, model, pixels, expected, 1);
+
+    std::cout << "\nDynamic batching over " << address << ", " << clients << " clients x " << depth
+              << " in flight, " << requests << " requests each\n";
+    uint64_t mismatches = 0;
+    for (int max_batch : {1, 8, 32, 64}) {
+        InferenceServerOptions options;
+        options.address = address;
+        options.max_batch = max_batch;
+        options.max_wait_us = max_batch == 1 ? 0 : 500;
+        set_log_level(LogLevel::Warning);
+        InferenceServer server(model, options);
+        set_log_level(LogLevel::Info);
+        LoadResult result = run_load(address, pixels, expected, clients, depth, requests);
+        InferenceStats stats = server.stats();
+        server.stop();
+        print_result("max batch " + std::to_string(max_batch) + ", wait " + std::to_string(options.max_wait_us) + " us",
+                     result, &stats);
+        mismatches += result.mismatches;
+    }
+    std::cout << (mismatches == 0 ? "every reply matched a direct forward pass"
+                                  : std::to_string(mismatches) + " replies differ from a direct forward pass")
+              << std::endl;
+    bool ok = mismatches == 0;
+
+    {
+        // A client that sends without ever reading its replies must not hold up anyone else
+        InferenceServerOptions options;
+        options.address = address;
+        options.max_batch = 32;
+        options.max_wait_us = 500;
+        set_log_level(LogLevel::Warning);
+        InferenceServer server(model, options);
+        int stalled = connect_to(address);
+        std::thread flood([&] {
+            for (int i = 0; i < 200000; ++i) {
+                if (!send_all(stalled, pixels.row(i % pixels.rows()).data(), pixels.cols())) break;
+            }
+        });
+        LoadResult result = run_load(address, pixels, expected, clients, depth, requests / 5);
+        server.stop();
+        flood.join();
+        ::close(stalled);
+        set_log_level(LogLevel::Info);
+        print_result("with one client not reading", result, nullptr);
+        ok = result.mismatches == 0 && result.requests == static_cast<uint64_t>(clients) * (requests / 5) && ok;
+    }
+
+    int rejected = 0;
+    for (const char* bad : {"0.0.0.0:7000", "192.168.1.1:7000", "127.0.0.1:0", "127.0.0.1:65536", "127.0.0.1:80x",
+                            "127.0.0.1:"}) {
+        try {
+            InferenceServerOptions options;
+            options.address = bad;
+            InferenceServer server(model, options);
+            server.stop();
+        } catch (const std::runtime_error&) {
+            ++rejected;
+        }
+    }
+    std::cout << "rejected " << rejected << " of 6 non-loopback or malformed TCP addresses" << std::endl;
+    ok = rejected == 6 && ok;
+    return ok ? 0 : 1;
+}
+
+int bench_loadgen(int argc, char** argv) {
+    if (argc < 2) {
+        throw std::runtime_error("loadgen needs the server address");
+    }
+    std::string address = argv[1];
+    std::string root = argc > 2 ? argv[2] : "./data";
+    int clients = argc > 3 ? std::stoi(argv[3]) : 8;
+    int depth = argc > 4 ? std::stoi(argv[4]) : 8;
+    int requests = argc > 5 ? std::stoi(argv[5]) : 5000;
+
+    // The server's weights are unknown here, so replies are scored against the true labels
+    MnistLoadOptions options;
+    options.storage = MnistStorage::Uint8;
+    MnistData data = load_mnist(root, options);
+    std::vector<int> labels(data.test_labels.data(), data.test_labels.data() + data.test_count);
+    LoadResult result = run_load(address, data.test_pixels, labels, clients, depth, requests);
+    std::cout << "\n";
+    print_result(address, result, nullptr);
+    std::cout << "accuracy " << std::setprecision(4)
+              << 1.0 - static_cast<double>(result.mismatches) / std::max<uint64_t>(result.requests, 1) << std::endl;
+    return 0;
+}
@@ -0,0 +1,248 @@
+#include "bench.h"
+#include "kernels.h"
+#include "log.h"
+#include "mnist_loader.h"
+#include "mnist_snapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct ShardReport {
+    int offset = 0;
+    int count = 0;
+    std::vector<std::vector<int>> epochs; // global sample ids in the order they were served
+};
+
+// Same rows and labels as the records [offset, offset + count) of the IDX files
+bool shard_matches_files(const MnistData& shard, const std::string& root) {
+    IdxFile images(root + "/train-images-idx3-ubyte");
+    IdxFile labels(root + "/train-labels-idx1-ubyte");
+    const size_t img_size = images.item_size();
+    std::vector<float> want(static_cast<size_t>(shard.train_count) * img_size);
+    u8_to_f32(images.payload().data + static_cast<size_t>(shard.train_offset) * img_size, want.data(), want.size(),
+              255.0f);
+    if (std::memcmp(want.data(), shard.image_data(MnistSplit::Train), want.size() * sizeof(float)) != 0) {
+        return false;
+    }
+    for (int i = 0; i < shard.train_count; ++i) {
+        if (shard.train_labels[i] != labels.payload().data[shard.train_offset + i]) return false;
+    }
+    return true;
+}
+
+// Runs in a forked child: loads one shard, walks the shuffled epochs through MnistBatchLoader
+// and writes what it served to fd. Every check failure becomes a non-zero exit status
+int run_rank(const std::string& root, int rank, int world, int epochs, uint64_t seed, int fd) {
+    MnistLoadOptions options;
+    options.rank = rank;
+    options.world_size = world;
+    MnistData data = load_mnist(map_mnist(root), options);
+    if (!shard_matches_files(data, root)) return 2;
+
+    const int batch_size = 100;
+    const size_t img_size = static_cast<size_t>(data.rows) * data.cols;
+    MnistBatchLoader loader(data, batch_size);
+    loader.enable_shuffle(seed);
+    MnistBatch batch;
+    std::vector<int> order(data.train_count), served;
+    int header[2] = {data.train_offset, data.train_count};
+    if (::write(fd, header, sizeof(header)) != sizeof(header)) return 3;
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        // The loader's batches must be the rows of the permutation it is documented to use
+        shuffle_order(order.data(), data.train_count, shard_shuffle_seed(data, seed), epoch);
+        served.clear();
+        int done = 0;
+        while (loader.next_train_batch(batch)) {
+            for (int i = 0; i < batch.count; ++i) {
+                int local = order[done + i];
+                if (std::memcmp(batch.images.row(i).data(), data.image_data(MnistSplit::Train) + local * img_size,
+                                img_size * sizeof(float)) != 0 ||
+                    batch.labels[i] != data.train_labels[local]) {
+                    return 4;
+                }
+                served.push_back(data.train_offset + local);
+            }
+            done += batch.count;
+        }
+        loader.reset();
+        const char* bytes = reinterpret_cast<const char*>(served.data());
+        for (size_t left = served.size() * sizeof(int); left > 0;) {
+            ssize_t n = ::write(fd, bytes, left);
+            if (n <= 0) return 3;
+            bytes += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+    return 0;
+}
+
+bool read_all(int fd, void* dst, size_t n) {
+    char* p = static_cast<char*>(dst);
+    while (n > 0) {
+        ssize_t got = ::read(fd, p, n);
+        if (got <= 0) return false;
+        p += got;
+        n -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+// Forks one process per rank and collects what each one served
+bool run_world(const std::string& root, int world, int epochs, uint64_t seed, std::vector<ShardReport>& reports) {
+    std::cout.flush();
+    std::vector<pid_t> pids(world);
+    std::vector<int> fds(world);
+    for (int rank = 0; rank < world; ++rank) {
+        int pipe_fds[2];
+        if (::pipe(pipe_fds) != 0) throw std::runtime_error("pipe failed");
+        pid_t pid = ::fork();
+        if (pid < 0) throw std::runtime_error("fork failed");
+        if (pid == 0) {
+            ::close(pipe_fds[0]);
+            int status = 1;
+            try {
+                status = run_rank(root, rank, world, epochs, seed, pipe_fds[1]);
+            } catch (const std::exception& e) {
+                std::cerr << "rank " << rank << ": " << e.what() << std::endl;
+            }
+            ::_exit(status);
+        }
+        ::close(pipe_fds[1]);
+        pids[rank] = pid;
+        fds[rank] = pipe_fds[0];
+    }
+
+    bool ok = true;
+    reports.assign(world, ShardReport());
+    for (int rank = 0; rank < world; ++rank) {
+        ShardReport& report = reports[rank];
+        int header[2];
+        bool got = read_all(fds[rank], header, sizeof(header));
+        if (got) {
+            report.offset = header[0];
+            report.count = header[1];
+            report.epochs.assign(epochs, std::vector<int>(report.count));
+            for (auto& served : report.epochs) {
+                got = got && read_all(fds[rank], served.data(), served.size() * sizeof(int));
+            }
+        }
+        ::close(fds[rank]);
+        int status = 0;
+        ::waitpid(pids[rank], &status, 0);
+        bool clean = got && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!clean) {
+            std::cout << "  rank " << rank << " failed (exit status "
+                      << (WIFEXITED(status) ? WEXITSTATUS(status) : -1) << ")\n";
+        }
+        ok = ok && clean;
+    }
+    return ok;
+}
+
+bool same_shard(const MnistData& a, const MnistData& b) {
+    const size_t n = static_cast<size_t>(a.train_count) * a.rows * a.cols;
+    return a.train_count == b.train_count && a.train_offset == b.train_offset && a.test_count == b.test_count &&
+           std::memcmp(a.image_data(MnistSplit::Train), b.image_data(MnistSplit::Train), n * sizeof(float)) == 0 &&
+           a.train_labels == b.train_labels && a.test_labels == b.test_labels;
+}
+
+} // anonymous namespace
+
+int bench_shard(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int world = argc > 2 ? std::stoi(argv[2]) : 4;
+    int epochs = argc > 3 ? std::stoi(argv[3]) : 3;
+    uint64_t seed = argc > 4 ? std::stoull(argv[4]) : 42;
+    set_log_level(LogLevel::Warning);
+    init_mnist(root);
+    const int total = map_mnist(root).train_images.count();
+
+    std::cout << "Sharded loading, " << world << " processes, " << epochs << " epochs\n";
+    std::vector<ShardReport> first, second;
+    bool ok = check("every rank loaded its records and served its permutation", run_world(root, world, epochs, seed, first));
+    ok = check("second run", run_world(root, world, epochs, seed, second)) && ok;
+
+    if (ok) {
+        bool balanced = true, covered = true, reshuffled = true, repeatable = true;
+        int smallest = total, largest = 0;
+        for (const ShardReport& report : first) {
+            smallest = std::min(smallest, report.count);
+            largest = std::max(largest, report.count);
+        }
+        balanced = largest - smallest <= 1;
+        for (int epoch = 0; epoch < epochs; ++epoch) {
+            std::vector<int> all;
+            for (const ShardReport& report : first) {
+                all.insert(all.end(), report.epochs[epoch].begin(), report.epochs[epoch].end());
+                if (epoch > 0) reshuffled = reshuffled && report.epochs[epoch] != report.epochs[epoch - 1];
+            }
+            std::sort(all.begin(), all.end());
+            std::vector<int> expected(total);
+            std::iota(expected.begin(), expected.end(), 0);
+            covered = covered && all == expected;
+        }
+        for (int rank = 0; rank < world; ++rank) {
+            repeatable = repeatable && first[rank].offset == second[rank].offset &&
+                         first[rank].epochs == second[rank].epochs;
+        }
+        ok = check("shard sizes " + std::to_string(smallest) + ".." + std::to_string(largest) + " differ by at most 1",
+                   balanced) && ok;
+        ok = check("each epoch, shards are disjoint and cover all " + std::to_string(total) + " samples", covered) && ok;
+        ok = check("each rank reshuffles every epoch", reshuffled) && ok;
+        ok = check("identical across runs", repeatable) && ok;
+    }
+
+    // The other load paths produce the same shard
+    std::cout << "\nLoad paths, rank 1 of 3\n";
+    MnistLoadOptions options;
+    options.rank = 1;
+    options.world_size = 3;
+    MnistData mapped = load_mnist(map_mnist(root), options);
+    ok = check("mapped shard holds " + std::to_string(mapped.train_count) + " of " + std::to_string(total) +
+                   " training images, full test set",
+               mapped.train_count == shard_range(total, 1, 3).count() && mapped.test_offset == 0 &&
+                   mapped.test_count == map_mnist(root).test_images.count()) && ok;
+    ok = check("gzip stream shard matches", same_shard(mapped, load_mnist_gz(root, options))) && ok;
+
+    std::string scratch = root + "/bench_shard";
+    ::mkdir(scratch.c_str(), 0755);
+    const std::string snapshot_path = scratch + "/full.snapshot";
+    save_mnist_snapshot(load_mnist(map_mnist(root)), snapshot_path, mnist_source_stamp(root, MnistSource::Idx));
+    MnistLoadOptions snapshot_options = options;
+    snapshot_options.use_snapshot = true;
+    snapshot_options.snapshot_path = snapshot_path;
+    MnistData sliced = load_mnist(root, snapshot_options);
+    ok = check("full snapshot sliced without copying images", sliced.snapshot != nullptr && same_shard(mapped, sliced)) && ok;
+
+    options.shard_test = true;
+    MnistData both = load_mnist(map_mnist(root), options);
+    ok = check("shard_test shards the test split too",
+               both.test_offset == shard_range(mapped.test_count, 1, 3).begin &&
+                   both.test_count == shard_range(mapped.test_count, 1, 3).count()) && ok;
+
+    ok = check("a shard cannot be written as a snapshot",
+               throws([&] { save_mnist_snapshot(mapped, scratch + "/shard.snapshot"); })) && ok;
+    options.rank = 3;
+    ok = check("rank >= world_size is rejected", throws([&] { load_mnist(map_mnist(root), options); })) && ok;
+    std::remove(snapshot_path.c_str());
+    ::rmdir(scratch.c_str());
+
+    std::cout << "\n";
+    MnistLoadOptions shard_options;
+    shard_options.world_size = world;
+    report("load_mnist, full training split", time_runs(5, [&] { load_mnist(map_mnist(root)); }));
+    report("load_mnist, shard 0 of " + std::to_string(world), time_runs(5, [&] { load_mnist(map_mnist(root), shard_options); }));
+
+    std::cout << (ok ? "sharded loading checks passed" : "sharded loading check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
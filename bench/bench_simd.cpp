@@ -0,0 +1,197 @@
+#include "bench.h"
+#include "kernels.h"
+#include "mnist_loader.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+const SimdLevel all_levels[] = {SimdLevel::Scalar, SimdLevel::Sse4, SimdLevel::Avx2, SimdLevel::Avx512};
+
+bool same_bits(const std::vector<float>& a, const std::vector<float>& b) {
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+// Every kernel of the active level against a plain loop, over odd sizes, misaligned
+// pointers, both divisors and rows full of ties
+bool check_level(std::mt19937& rng) {
+    std::uniform_int_distribution<int> byte(0, 255);
+    bool ok = true;
+
+    for (size_t n : {0, 1, 7, 15, 16, 17, 31, 33, 63, 64, 65, 100, 784, 1000}) {
+        for (size_t offset : {0, 1, 3}) {
+            std::vector<uint8_t> src(n + offset);
+            for (auto& b : src) b = static_cast<uint8_t>(byte(rng));
+            for (float divisor : {255.0f, 1.0f}) {
+                std::vector<float> want(n + 1, -1.0f), got(n + 1, -1.0f);
+                for (size_t i = 0; i < n; ++i) want[i] = src[offset + i] / divisor;
+                u8_to_f32(src.data() + offset, got.data(), n, divisor);
+                // The sentinel past the end must survive the masked / vector tails
+                if (!same_bits(want, got)) {
+                    std::cout << "    u8_to_f32 differs: n=" << n << " offset=" << offset << " divisor=" << divisor << "\n";
+                    ok = false;
+                }
+            }
+        }
+    }
+
+    for (size_t row_size : {1, 10, 17, 784}) {
+        const int rows = 50, count = 37;
+        std::vector<uint8_t> pixels(rows * row_size);
+        for (auto& b : pixels) b = static_cast<uint8_t>(byte(rng));
+        std::vector<float> images(pixels.size());
+        for (size_t i = 0; i < pixels.size(); ++i) images[i] = pixels[i] / 255.0f;
+        std::vector<int> indices(count);
+        std::uniform_int_distribution<int> row(0, rows - 1);
+        for (int& i : indices) i = row(rng);
+
+        std::vector<float> want(count * row_size + 1, -1.0f), got_f32(want.size(), -1.0f), got_u8(want.size(), -1.0f);
+        for (int i = 0; i < count; ++i) {
+            std::copy_n(images.data() + indices[i] * row_size, row_size, want.data() + i * row_size);
+        }
+        gather_rows_f32(images.data(), row_size, indices.data(), count, got_f32.data());
+        gather_rows_u8_to_f32(pixels.data(), row_size, indices.data(), count, got_u8.data(), 255.0f);
+        if (!same_bits(want, got_f32) || !same_bits(want, got_u8)) {
+            std::cout << "    gather differs: row_size=" << row_size << "\n";
+            ok = false;
+        }
+    }
+
+    // Few distinct values, so most rows hold their maximum more than once
+    std::uniform_int_distribution<int> small(-3, 3);
+    for (int cols : {1, 2, 3, 4, 5, 8, 9, 10, 15, 16, 17, 33, 100}) {
+        const int rows = 200;
+        std::vector<float> x(rows * cols);
+        for (auto& v : x) v = static_cast<float>(small(rng)) * 0.5f;
+        std::vector<int> got(rows);
+        argmax_rows(x.data(), rows, cols, got.data());
+        for (int r = 0; r < rows; ++r) {
+            const float* row = x.data() + r * cols;
+            int want = static_cast<int>(std::max_element(row, row + cols) - row);
+            if (got[r] != want) {
+                std::cout << "    argmax differs: cols=" << cols << " row=" << r << "\n";
+                ok = false;
+                break;
+            }
+        }
+    }
+
+    // Coordinates inside, on and beyond the border, some exactly on the pixel grid
+    for (int shape : {0, 1}) {
+        const int rows = shape ? 5 : 28, cols = shape ? 3 : 28;
+        std::vector<float> src(rows * cols);
+        for (auto& v : src) v = byte(rng) / 255.0f;
+        std::uniform_real_distribution<float> coord(-4.0f, 32.0f);
+        std::uniform_int_distribution<int> grid(-3, 30);
+        for (int n : {1, 7, 8, 9, 787}) {
+            std::vector<float> xs(n), ys(n);
+            for (int i = 0; i < n; ++i) {
+                xs[i] = i % 3 == 0 ? static_cast<float>(grid(rng)) : coord(rng);
+                ys[i] = i % 5 == 0 ? static_cast<float>(grid(rng)) : coord(rng);
+            }
+            std::vector<float> want(n + 1, -1.0f), got(n + 1, -1.0f);
+            auto at = [&](int y, int x) { return y >= 0 && y < rows && x >= 0 && x < cols ? src[y * cols + x] : 0.0f; };
+            for (int i = 0; i < n; ++i) {
+                float x = std::min(std::max(xs[i], -2.0f), cols + 2.0f), y = std::min(std::max(ys[i], -2.0f), rows + 2.0f);
+                float x0 = std::floor(x), y0 = std::floor(y), fx = x - x0, fy = y - y0;
+                int ix = static_cast<int>(x0), iy = static_cast<int>(y0);
+                float top = at(iy, ix) + fx * (at(iy, ix + 1) - at(iy, ix));
+                float bottom = at(iy + 1, ix) + fx * (at(iy + 1, ix + 1) - at(iy + 1, ix));
+                want[i] = top + fy * (bottom - top);
+            }
+            bilinear_sample(src.data(), rows, cols, xs.data(), ys.data(), got.data(), n);
+            if (!same_bits(want, got)) {
+                std::cout << "    bilinear differs: " << rows << "x" << cols << " n=" << n << "\n";
+                ok = false;
+            }
+        }
+    }
+    return ok;
+}
+
+} // anonymous namespace
+
+int bench_simd(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 100;
+    int reps = argc > 3 ? std::stoi(argv[3]) : 5;
+
+    const SimdLevel detected = detected_simd_level();
+    std::cout << "CPU supports up to " << simd_level_name(detected) << "\n\nCorrectness against plain loops\n";
+    bool ok = true;
+    for (SimdLevel level : all_levels) {
+        if (static_cast<int>(level) > static_cast<int>(detected)) {
+            std::cout << "  SKIP  " << simd_level_name(level) << " (not supported on this CPU)\n";
+            continue;
+        }
+        set_simd_level(level);
+        std::mt19937 rng(5);
+        bool level_ok = check_level(rng);
+        std::cout << (level_ok ? "  PASS  " : "  FAIL  ") << simd_level_name(level) << "\n";
+        ok = ok && level_ok;
+    }
+
+    MnistLoadOptions options;
+    options.storage = MnistStorage::Uint8;
+    MnistData raw = load_mnist(map_mnist(root), options);
+    MnistData data = load_mnist(map_mnist(root));
+    const int n = raw.train_count;
+    const size_t img_size = static_cast<size_t>(raw.rows) * raw.cols;
+    std::vector<float> images(static_cast<size_t>(n) * img_size);
+    std::vector<int> order(n);
+    shuffle_order(order.data(), n, 42, 0);
+    std::vector<float> batch(static_cast<size_t>(batch_size) * img_size);
+    std::vector<float> logits(static_cast<size_t>(n) * 10);
+    std::mt19937 rng(9);
+    std::normal_distribution<float> normal;
+    for (auto& v : logits) v = normal(rng);
+    std::vector<int> labels(n);
+    // A 10 degree rotation about the centre: typical augmentation coordinates
+    std::vector<float> sample_xs(img_size), sample_ys(img_size);
+    for (int y = 0; y < data.rows; ++y) {
+        for (int x = 0; x < data.cols; ++x) {
+            float u = x - (data.cols - 1) * 0.5f, v = y - (data.rows - 1) * 0.5f;
+            sample_xs[y * data.cols + x] = (data.cols - 1) * 0.5f + 0.985f * u + 0.174f * v;
+            sample_ys[y * data.cols + x] = (data.rows - 1) * 0.5f + 0.985f * v - 0.174f * u;
+        }
+    }
+
+    for (SimdLevel level : all_levels) {
+        if (static_cast<int>(level) > static_cast<int>(detected)) continue;
+        set_simd_level(level);
+        std::string name = simd_level_name(level);
+        std::cout << "\n" << name << "\n";
+        report("  normalize train split", time_runs(reps, [&] {
+                   u8_to_f32(raw.pixel_data(MnistSplit::Train), images.data(), images.size(), 255.0f);
+               }));
+        report("  shuffled gather, float", time_runs(reps, [&] {
+                   for (int start = 0; start + batch_size <= n; start += batch_size) {
+                       gather_rows_f32(data.image_data(MnistSplit::Train), img_size, order.data() + start, batch_size,
+                                       batch.data());
+                   }
+               }));
+        report("  shuffled gather, uint8", time_runs(reps, [&] {
+                   for (int start = 0; start + batch_size <= n; start += batch_size) {
+                       gather_rows_u8_to_f32(raw.pixel_data(MnistSplit::Train), img_size, order.data() + start,
+                                             batch_size, batch.data(), 255.0f);
+                   }
+               }));
+        report("  argmax 60000 x 10", time_runs(reps, [&] { argmax_rows(logits.data(), n, 10, labels.data()); }));
+        report("  bilinear resample 10000 images", time_runs(reps, [&] {
+                   for (int i = 0; i < 10000; ++i) {
+                       bilinear_sample(data.image_data(MnistSplit::Train) + i * img_size, data.rows, data.cols,
+                                       sample_xs.data(), sample_ys.data(), batch.data(), static_cast<int>(img_size));
+                   }
+               }));
+    }
+    set_simd_level(detected);
+
+    std::cout << (ok ? "all SIMD levels match the scalar kernels" : "SIMD correctness check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
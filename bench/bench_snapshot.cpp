@@ -0,0 +1,65 @@
+#include "bench.h"
+#include "mnist_loader.h"
+#include "mnist_snapshot.h"
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+int bench_snapshot(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int reps = argc > 2 ? std::stoi(argv[2]) : 5;
+
+    std::cout << "\nWarm start from a dataset snapshot (" << reps << " runs)\n";
+    for (MnistStorage storage : {MnistStorage::Float, MnistStorage::Uint8}) {
+        MnistLoadOptions options;
+        options.storage = storage;
+        std::string path = default_snapshot_path(root, options) + ".bench";
+        const char* label = storage == MnistStorage::Float ? "float" : "uint8";
+
+        MnistData parsed;
+        auto idx_runs = time_runs(reps, [&] { parsed = load_mnist(map_mnist(root), options); });
+        auto save_runs = time_runs(1, [&] { save_mnist_snapshot(parsed, path); });
+
+        MnistData restored;
+        auto snapshot_runs = time_runs(reps, [&] { restored = load_mnist_snapshot(path); });
+        auto verified_runs = time_runs(reps, [&] { restored = load_mnist_snapshot(path, true); });
+
+        // Compare what the batch loader would serve, over both splits
+        bool same = restored.train_labels == parsed.train_labels && restored.test_labels == parsed.test_labels;
+        RowMatrixXf a, b;
+        Eigen::VectorXi ya, yb;
+        MnistBatchLoader from_snapshot(restored, 1000), from_idx(parsed, 1000);
+        while (same && from_idx.next_train_batch(a, ya)) {
+            same = from_snapshot.next_train_batch(b, yb) && a == b && ya == yb;
+        }
+        while (same && from_idx.next_test_batch(a, ya)) {
+            same = from_snapshot.next_test_batch(b, yb) && a == b && ya == yb;
+        }
+        std::remove(path.c_str());
+        if (!same) {
+            std::cerr << "snapshot round trip changed the " << label << " dataset" << std::endl;
+            return 1;
+        }
+        report(std::string("IDX parse, ") + label, idx_runs);
+        report(std::string("snapshot write, ") + label, save_runs);
+        report(std::string("snapshot load, ") + label, snapshot_runs);
+        report(std::string("snapshot load + CRC, ") + label, verified_runs);
+
+        // A snapshot recorded against other source files is reloaded from them and rewritten
+        MnistSourceStamp stale = mnist_source_stamp(root, MnistSource::Idx);
+        stale.mtimes_ns[0] -= 1;
+        save_mnist_snapshot(parsed, path, stale);
+        MnistLoadOptions warm = options;
+        warm.use_snapshot = true;
+        warm.snapshot_path = path;
+        const bool reloaded = load_mnist(root, warm).snapshot == nullptr;
+        const bool rewritten = load_mnist(root, warm).snapshot != nullptr;
+        std::remove(path.c_str());
+        if (!reloaded || !rewritten) {
+            std::cerr << "stale " << label << " snapshot was " << (reloaded ? "not rewritten" : "still used") << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "stale snapshots are reloaded from the source files" << std::endl;
+    return 0;
+}
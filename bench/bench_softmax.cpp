@@ -0,0 +1,94 @@
+#include "bench.h"
+#include "math.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+// What a caller had to do before: softmax in double, one-hot targets, then cross_entropy_error
+double reference_loss(const Math::RowMatrix<float>& logits, const Eigen::VectorXi& labels,
+                      Eigen::MatrixXd& probs, Eigen::MatrixXd& one_hot) {
+    probs = logits.cast<double>();
+    for (Eigen::Index i = 0; i < probs.rows(); ++i) {
+        probs.row(i) = (probs.row(i).array() - probs.row(i).maxCoeff()).exp();
+        probs.row(i) /= probs.row(i).sum();
+    }
+    one_hot.setZero(probs.rows(), probs.cols());
+    for (Eigen::Index i = 0; i < labels.size(); ++i) {
+        one_hot(i, labels[i]) = 1.0;
+    }
+    return Math::cross_entropy_error(probs, one_hot);
+}
+
+} // anonymous namespace
+
+int bench_softmax(int argc, char** argv) {
+    int batch_size = argc > 1 ? std::stoi(argv[1]) : 100;
+    int num_classes = argc > 2 ? std::stoi(argv[2]) : 10;
+    int iters = argc > 3 ? std::stoi(argv[3]) : 10000;
+    int reps = argc > 4 ? std::stoi(argv[4]) : 5;
+
+    std::mt19937 rng(7);
+    std::normal_distribution<float> normal(0.0f, 2.0f);
+    std::uniform_int_distribution<int> label(0, num_classes - 1);
+    Math::RowMatrix<float> logits(batch_size, num_classes);
+    Eigen::VectorXi labels(batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+        for (int j = 0; j < num_classes; ++j) logits(i, j) = normal(rng);
+        labels[i] = label(rng);
+    }
+    Math::RowMatrix<float> grad_f(batch_size, num_classes);
+    Math::RowMatrix<double> logits_d = logits.cast<double>(), grad_d(batch_size, num_classes);
+    Eigen::MatrixXd probs, one_hot;
+
+    bool ok = true;
+    double loss_ref = reference_loss(logits, labels, probs, one_hot);
+    double loss_d = Math::softmax_cross_entropy<double>(logits_d, labels, grad_d);
+    float loss_f = Math::softmax_cross_entropy<float>(logits, labels, grad_f);
+    // The reference adds 1e-7 inside the log, so it only agrees to ~1e-5 when probabilities are tiny
+    Eigen::MatrixXd expected_grad = (probs - one_hot) / batch_size;
+    double grad_err_d = (grad_d - expected_grad).cwiseAbs().maxCoeff();
+    double grad_err_f = (grad_f.cast<double>() - expected_grad).cwiseAbs().maxCoeff();
+    ok &= std::isfinite(loss_d) && std::abs(loss_d - loss_ref) <= 1e-4 * std::max(1.0, std::abs(loss_ref));
+    ok &= std::abs(loss_f - loss_d) <= 1e-4 * std::max(1.0, std::abs(loss_d));
+    ok &= grad_err_d <= 1e-12 && grad_err_f <= 1e-6;
+
+    // Huge logits would overflow a naive exp(); the loss of a confidently wrong row is the logit gap
+    Math::RowMatrix<float> extreme = logits, extreme_grad(batch_size, num_classes);
+    extreme(0, (labels[0] + 1) % num_classes) = 1000.0f;
+    float loss_extreme = Math::softmax_cross_entropy<float>(extreme, labels, extreme_grad);
+    ok &= std::isfinite(loss_extreme) && extreme_grad.allFinite() && loss_extreme > 1000.0f / batch_size;
+
+    // In place: the gradient overwrites the logits
+    Math::RowMatrix<float> in_place = logits;
+    float loss_in_place = Math::softmax_cross_entropy<float>(in_place, labels, in_place);
+    ok &= loss_in_place == loss_f && in_place == grad_f;
+
+    float sink = 0.0f;
+    auto reference_runs = time_runs(reps, [&] {
+        for (int i = 0; i < iters; ++i) sink += static_cast<float>(reference_loss(logits, labels, probs, one_hot));
+    });
+    auto legacy_runs = time_runs(reps, [&] {
+        for (int i = 0; i < iters; ++i) sink += static_cast<float>(Math::cross_entropy_error(probs, one_hot));
+    });
+    auto fused_d_runs = time_runs(reps, [&] {
+        for (int i = 0; i < iters; ++i) sink += static_cast<float>(Math::softmax_cross_entropy<double>(logits_d, labels, grad_d));
+    });
+    auto fused_f_runs = time_runs(reps, [&] {
+        for (int i = 0; i < iters; ++i) sink += Math::softmax_cross_entropy<float>(logits, labels, grad_f);
+    });
+
+    std::cout << "\nSoftmax + cross-entropy, " << batch_size << " x " << num_classes << " (" << iters
+              << " calls per run, " << reps << " runs, checksum " << sink << ")\n";
+    report("softmax + one-hot + cross_entropy", reference_runs);
+    report("cross_entropy_error only", legacy_runs);
+    report("fused<double> with gradient", fused_d_runs);
+    report("fused<float> with gradient", fused_f_runs);
+    std::cout << "loss " << loss_f << " (reference " << loss_ref << "), max gradient error float " << grad_err_f
+              << ", double " << grad_err_d << "\n"
+              << (ok ? "fused kernel matches the reference" : "fused kernel does NOT match the reference") << std::endl;
+    return ok ? 0 : 1;
+}
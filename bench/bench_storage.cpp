@@ -0,0 +1,51 @@
+#include "bench.h"
+#include "mnist_loader.h"
+#include <iostream>
+#include <string>
+
+int bench_storage(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 100;
+
+    MnistMapped mapped = map_mnist(root);
+    MnistLoadOptions float_options;
+    MnistLoadOptions u8_options;
+    u8_options.storage = MnistStorage::Uint8;
+    MnistData f32 = load_mnist(mapped, float_options);
+    MnistData u8 = load_mnist(mapped, u8_options);
+
+    size_t f32_bytes = (f32.train_images.size() + f32.test_images.size()) * sizeof(float);
+    size_t u8_bytes = (u8.train_pixels.size() + u8.test_pixels.size()) * sizeof(uint8_t);
+
+    // Every batch of the uint8 mode must match the float mode exactly
+    MnistBatchLoader f32_loader(f32, batch_size);
+    MnistBatchLoader u8_loader(u8, batch_size);
+    RowMatrixXf x_ref, x;
+    Eigen::VectorXi y_ref, y;
+    while (f32_loader.next_train_batch(x_ref, y_ref)) {
+        if (!u8_loader.next_train_batch(x, y) || x != x_ref || y != y_ref) {
+            std::cerr << "uint8 storage produced a different train batch" << std::endl;
+            return 1;
+        }
+    }
+    while (f32_loader.next_test_batch(x_ref, y_ref)) {
+        if (!u8_loader.next_test_batch(x, y) || x != x_ref || y != y_ref) {
+            std::cerr << "uint8 storage produced a different test batch" << std::endl;
+            return 1;
+        }
+    }
+
+    auto epoch = [&](MnistBatchLoader& loader) {
+        loader.reset();
+        while (loader.next_train_batch(x, y)) {
+        }
+    };
+    auto f32_runs = time_runs(5, [&] { epoch(f32_loader); });
+    auto u8_runs = time_runs(5, [&] { epoch(u8_loader); });
+
+    std::cout << "\nImage storage: float " << f32_bytes / (1024.0 * 1024.0) << " MiB, uint8 "
+              << u8_bytes / (1024.0 * 1024.0) << " MiB (batches identical)\n";
+    report("train epoch, float storage", f32_runs);
+    report("train epoch, uint8 storage", u8_runs);
+    return 0;
+}
@@ -0,0 +1,323 @@
+#include "bench.h"
+#include "idx_file.h"
+#include "idx_stream.h"
+#include "log.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include "parallel_trainer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Header plus big-endian payload; values must be representable in type
+std::vector<uint8_t> encode_idx(IdxType type, const std::vector<int>& shape, const std::vector<double>& values) {
+    std::vector<uint8_t> out = {0, 0, static_cast<uint8_t>(type), static_cast<uint8_t>(shape.size())};
+    auto put_be = [&out](uint64_t bits, size_t bytes) {
+        for (size_t b = bytes; b-- > 0;) out.push_back(static_cast<uint8_t>(bits >> (8 * b)));
+    };
+    for (int dim : shape) put_be(static_cast<uint32_t>(dim), 4);
+    for (double v : values) {
+        switch (type) {
+        case IdxType::UInt8:
+        case IdxType::Int8: put_be(static_cast<uint8_t>(static_cast<int>(v)), 1); break;
+        case IdxType::Int16: put_be(static_cast<uint16_t>(static_cast<int16_t>(v)), 2); break;
+        case IdxType::Int32: put_be(static_cast<uint32_t>(static_cast<int32_t>(v)), 4); break;
+        case IdxType::Float32: {
+            float f = static_cast<float>(v);
+            uint32_t bits;
+            std::memcpy(&bits, &f, 4);
+            put_be(bits, 4);
+            break;
+        }
+        case IdxType::Float64: {
+            uint64_t bits;
+            std::memcpy(&bits, &v, 8);
+            put_be(bits, 8);
+            break;
+        }
+        }
+    }
+    return out;
+}
+
+// Random values that every type holds exactly; floats get fractional parts and signs
+std::vector<double> random_values(IdxType type, size_t n, std::mt19937& rng) {
+    std::vector<double> values(n);
+    std::uniform_int_distribution<int> u8(0, 255), i8(-128, 127), i16(-32768, 32767), i32(-1 << 24, 1 << 24);
+    std::normal_distribution<double> normal(0.0, 100.0);
+    for (double& v : values) {
+        switch (type) {
+        case IdxType::UInt8: v = u8(rng); break;
+        case IdxType::Int8: v = i8(rng); break;
+        case IdxType::Int16: v = i16(rng); break;
+        case IdxType::Int32: v = i32(rng); break;
+        case IdxType::Float32: v = static_cast<float>(normal(rng)); break;
+        case IdxType::Float64: v = normal(rng); break;
+        }
+    }
+    return values;
+}
+
+// What load_mnist and the stream loader should produce for one element
+float expected_float(IdxType type, double v) {
+    float divisor = type == IdxType::UInt8 ? 255.0f : 1.0f;
+    return static_cast<float>(v) / divisor;
+}
+
+void write_file(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!out) throw std::runtime_error("Cannot write " + path);
+}
+
+bool same_floats(const float* got, const std::vector<float>& want) {
+    return std::memcmp(got, want.data(), want.size() * sizeof(float)) == 0;
+}
+
+struct Dataset {
+    std::vector<float> images;
+    std::vector<int> labels;
+};
+
+// Writes an image/label pair of the given types and shape, and returns the decoded contents
+Dataset write_dataset(const std::string& images_path, const std::string& labels_path, IdxType type,
+                      const std::vector<int>& shape, IdxType label_type, std::mt19937& rng) {
+    size_t elements = 1;
+    for (int dim : shape) elements *= static_cast<size_t>(dim);
+    std::vector<double> values = random_values(type, elements, rng);
+    std::vector<double> label_values(shape[0]);
+    std::uniform_int_distribution<int> label(0, label_type == IdxType::UInt8 || label_type == IdxType::Int8 ? 9 : 999);
+    for (double& v : label_values) v = label(rng);
+    write_idx_pair(images_path, encode_idx(type, shape, values));
+    write_idx_pair(labels_path, encode_idx(label_type, {shape[0]}, label_values));
+
+    Dataset data;
+    for (double v : values) data.images.push_back(expected_float(type, v));
+    for (double v : label_values) data.labels.push_back(static_cast<int>(v));
+    return data;
+}
+
+// Streams a whole file pair and compares every chunk with the expected contents
+bool stream_matches(IdxStreamLoader& loader, const Dataset& want) {
+    const size_t width = static_cast<size_t>(loader.rows()) * loader.cols();
+    MnistBatch chunk;
+    size_t done = 0;
+    bool ok = true;
+    while (loader.next_chunk(chunk)) {
+        std::vector<float> expected(want.images.begin() + done * width,
+                                    want.images.begin() + (done + chunk.count) * width);
+        ok = ok && same_floats(chunk.images.data(), expected);
+        for (int i = 0; i < chunk.count; ++i) ok = ok && chunk.labels[i] == want.labels[done + i];
+        done += chunk.count;
+    }
+    return ok && done == want.labels.size();
+}
+
+// Every dtype code at several ranks, through IdxFile, the stream loader (odd chunk size) and load_mnist
+bool check_formats(const std::string& scratch) {
+    std::mt19937 rng(17);
+    bool ok = true;
+    struct Case {
+        IdxType type;
+        std::vector<int> shape;
+        IdxType label_type;
+    };
+    const Case cases[] = {
+        {IdxType::UInt8, {101, 28, 28}, IdxType::UInt8},
+        {IdxType::Int8, {64, 30}, IdxType::Int8},
+        {IdxType::Int16, {50, 3, 5, 2}, IdxType::Int16},
+        {IdxType::Int32, {33, 7, 11}, IdxType::Int32},
+        {IdxType::Float32, {40, 16, 16}, IdxType::UInt8},
+        {IdxType::Float64, {25, 9}, IdxType::Int32},
+    };
+    const std::string images_path = scratch + "/case-images", labels_path = scratch + "/case-labels";
+    for (const Case& c : cases) {
+        Dataset want = write_dataset(images_path, labels_path, c.type, c.shape, c.label_type, rng);
+        std::string name = std::string(idx_type_name(c.type)) + " rank " + std::to_string(c.shape.size());
+
+        IdxFile file(images_path);
+        size_t elements = want.images.size() / c.shape[0];
+        ok = check(name + ": IdxFile type, shape and item size",
+                   file.type() == c.type && file.shape() == c.shape && file.item_elements() == elements &&
+                       file.item_size() == elements * idx_type_size(c.type)) && ok;
+
+        IdxStreamOptions options;
+        options.chunk_size = 7;
+        IdxStreamLoader loader(images_path, labels_path, options);
+        bool streamed = stream_matches(loader, want);
+        loader.reset();
+        streamed = streamed && stream_matches(loader, want);
+        ok = check(name + ": streamed in chunks of 7, twice", streamed) && ok;
+    }
+
+    // A non-28x28, non-uint8 dataset under the MNIST file names, through both load paths
+    const std::string dir = scratch + "/mnist_like";
+    ::mkdir(dir.c_str(), 0755);
+    Dataset train = write_dataset(dir + "/train-images-idx3-ubyte", dir + "/train-labels-idx1-ubyte", IdxType::Int16,
+                                  {300, 12, 9}, IdxType::Int32, rng);
+    Dataset test = write_dataset(dir + "/t10k-images-idx3-ubyte", dir + "/t10k-labels-idx1-ubyte", IdxType::Int16,
+                                 {70, 12, 9}, IdxType::Int32, rng);
+    MnistLoadOptions load_options;
+    for (MnistSource source : {MnistSource::Idx, MnistSource::Gzip}) {
+        MnistData data = source == MnistSource::Idx ? load_mnist(map_mnist(dir), load_options)
+                                                    : load_mnist_gz(dir, load_options);
+        bool match = data.rows == 12 && data.cols == 9 && data.train_count == 300 && data.test_count == 70 &&
+                     same_floats(data.image_data(MnistSplit::Train), train.images) &&
+                     same_floats(data.image_data(MnistSplit::Test), test.images);
+        for (int i = 0; i < data.train_count && match; ++i) match = data.train_labels[i] == train.labels[i];
+        for (int i = 0; i < data.test_count && match; ++i) match = data.test_labels[i] == test.labels[i];
+        ok = check(std::string("load_mnist") + (source == MnistSource::Gzip ? "_gz" : "") +
+                       ": int16 12x9 images, int32 labels", match) && ok;
+    }
+    {
+        // Labels up to 999: the class count follows them, and a 10-class trainer refuses them
+        MnistData data = load_mnist(map_mnist(dir), load_options);
+        const int max_label = std::max(*std::max_element(train.labels.begin(), train.labels.end()),
+                                       *std::max_element(test.labels.begin(), test.labels.end()));
+        Mlp small({data.rows * data.cols, 8, 10}, 1);
+        MlpTrainer trainer(small, OptimizerConfig(), 50);
+        MnistBatchLoader loader(data, 50);
+        MnistBatch batch;
+        loader.next_train_batch(batch);
+        ok = check("class count follows the labels; trainers reject labels beyond the output layer",
+                   mnist_num_classes(data) == max_label + 1 && throws([&] { trainer.train_step(batch); }) &&
+                       throws([&] { DataParallelTrainer parallel(small, data, OptimizerConfig(), 50, 1); })) && ok;
+    }
+    load_options.storage = MnistStorage::Uint8;
+    ok = check("uint8 storage of int16 images is rejected", throws([&] { load_mnist(map_mnist(dir), load_options); })) && ok;
+
+    // Truncated payloads fail at open, not halfway through an epoch
+    std::vector<uint8_t> truncated = encode_idx(IdxType::Float32, {10, 4}, std::vector<double>(39, 1.0));
+    write_file(images_path, truncated);
+    ok = check("truncated file is rejected", throws([&] { IdxStreamLoader loader(images_path, labels_path); })) && ok;
+    const std::string missing_path = dir + "/missing-idx3-ubyte";
+    std::string open_error;
+    try {
+        IdxFile missing(missing_path);
+    } catch (const std::runtime_error& e) {
+        open_error = e.what();
+    }
+    ok = check("a missing IDX file reports why it could not be opened, naming the path once",
+               open_error.find("No such file") != std::string::npos &&
+                   open_error.find(missing_path) == open_error.rfind(missing_path)) && ok;
+
+    for (const char* name : {"train-images-idx3-ubyte", "train-labels-idx1-ubyte", "t10k-images-idx3-ubyte",
+                             "t10k-labels-idx1-ubyte"}) {
+        std::remove((dir + "/" + name).c_str());
+        std::remove((dir + "/" + name + ".gz").c_str());
+    }
+    ::rmdir(dir.c_str());
+    for (const std::string& path : {images_path, labels_path}) {
+        std::remove(path.c_str());
+        std::remove((path + ".gz").c_str());
+    }
+    return ok;
+}
+
+size_t resident_bytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+} // anonymous namespace
+
+int bench_stream(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int chunk_size = argc > 2 ? std::stoi(argv[2]) : 4096;
+    int depth = argc > 3 ? std::stoi(argv[3]) : 2;
+    int big_count = argc > 4 ? std::stoi(argv[4]) : 200000;
+    std::string scratch = root + "/bench_stream";
+    ::mkdir(scratch.c_str(), 0755);
+    set_log_level(LogLevel::Warning);
+
+    std::cout << "IDX formats\n";
+    bool ok = check_formats(scratch);
+
+    IdxStreamOptions options;
+    options.chunk_size = chunk_size;
+    options.depth = depth;
+
+    // A dataset whose float form would not fit the budget: memory must stay at the ring size.
+    // Runs before anything large is loaded, so freed heap pages cannot hide the ring's own growth
+    const std::string big_images = scratch + "/big-images", big_labels = scratch + "/big-labels";
+    {
+        std::vector<uint8_t> header = encode_idx(IdxType::UInt8, {big_count, 28, 28}, {});
+        std::ofstream out(big_images, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+        std::mt19937 rng(3);
+        std::vector<uint8_t> block(784 * 1024);
+        for (int done = 0; done < big_count; done += 1024) {
+            for (auto& b : block) b = static_cast<uint8_t>(rng());
+            out.write(reinterpret_cast<const char*>(block.data()), 784 * std::min(1024, big_count - done));
+        }
+        std::vector<double> labels(big_count);
+        for (double& v : labels) v = rng() % 10;
+        write_file(big_labels, encode_idx(IdxType::UInt8, {big_count}, labels));
+        if (!out) throw std::runtime_error("Cannot write " + big_images);
+    }
+    {
+        // Measured from before the loader exists, so the ring itself counts against the budget
+        const size_t baseline = resident_bytes();
+        IdxStreamLoader loader(big_images, big_labels, options);
+        MnistBatch chunk;
+        size_t peak = baseline;
+        int64_t samples = 0;
+        auto start = std::chrono::steady_clock::now();
+        while (loader.next_chunk(chunk)) {
+            samples += chunk.count;
+            peak = std::max(peak, resident_bytes());
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double mib = 1024.0 * 1024.0;
+        const double float_size = static_cast<double>(big_count) * 784 * sizeof(float);
+        const size_t budget = 2 * loader.buffer_bytes() + (16 << 20);
+        std::cout << std::fixed << std::setprecision(1) << "\nStreaming "
+                  << big_count << " images (" << float_size / mib << " MiB as float), chunk " << chunk_size
+                  << ", depth " << depth << ": " << std::setprecision(0) << samples / seconds << " images/s, "
+                  << std::setprecision(1) << static_cast<double>(big_count) * 785 / mib / seconds
+                  << " MiB/s read\n  ring " << loader.buffer_bytes() / mib << " MiB, peak RSS growth "
+                  << (peak - baseline) / mib << " MiB\n";
+        ok = check("streamed every sample", samples == big_count) && ok;
+        ok = check("RSS growth stays within the ring buffers", peak - baseline <= budget) && ok;
+    }
+    std::remove(big_images.c_str());
+    std::remove(big_labels.c_str());
+
+    // The real training split, streamed, against the in-memory loader
+    std::cout << "\nMNIST\n";
+    MnistData data = load_mnist(map_mnist(root));
+    {
+        IdxStreamLoader loader(root + "/train-images-idx3-ubyte", root + "/train-labels-idx1-ubyte", options);
+        Dataset want;
+        const float* images = data.image_data(MnistSplit::Train);
+        want.images.assign(images, images + static_cast<size_t>(data.train_count) * data.rows * data.cols);
+        want.labels.assign(data.train_labels.data(), data.train_labels.data() + data.train_count);
+        ok = check("MNIST train split: stream matches load_mnist", stream_matches(loader, want)) && ok;
+    }
+    report("load_mnist (in memory)", time_runs(3, [&] { load_mnist(map_mnist(root)); }));
+    report("stream train split", time_runs(3, [&] {
+               IdxStreamLoader loader(root + "/train-images-idx3-ubyte", root + "/train-labels-idx1-ubyte", options);
+               MnistBatch chunk;
+               while (loader.next_chunk(chunk)) {
+               }
+           }));
+    ::rmdir(scratch.c_str());
+
+    std::cout << (ok ? "IDX reader and streaming loader checks passed" : "IDX streaming check FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,179 @@
+#include "bench.h"
+#include "log.h"
+#include "math.hpp"
+#include "metrics.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct SuiteResult {
+    std::string name;
+    int iterations = 1;     // operations per sample; times are per operation
+    double bytes = 0.0;     // bytes processed per operation, 0 when not meaningful
+    std::vector<double> samples_ms;
+};
+
+// One warm-up run, then reps timed samples of `iterations` calls each, scaled to one call
+SuiteResult measure(const std::string& name, int reps, int iterations, double bytes, const std::function<void()>& fn) {
+    SuiteResult result{name, iterations, bytes, {}};
+    fn();
+    result.samples_ms = time_runs(reps, [&] {
+        for (int i = 0; i < iterations; ++i) fn();
+    });
+    for (double& s : result.samples_ms) s /= iterations;
+
+    double med = median(result.samples_ms);
+    std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(4)
+              << " min " << std::setw(11) << *std::min_element(result.samples_ms.begin(), result.samples_ms.end())
+              << " ms  median " << std::setw(11) << med << " ms  p99 " << std::setw(11)
+              << percentile(result.samples_ms, 0.99) << " ms";
+    if (bytes > 0.0) {
+        std::cout << "  " << std::setprecision(1) << std::setw(8) << bytes / (med * 1e-3) / 1e6 << " MB/s";
+    }
+    std::cout << "\n";
+    return result;
+}
+
+std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Stable key order and no timestamps, so two runs can be diffed line by line
+std::string to_json(const std::string& root, bool synthetic, const MnistData& data, int reps,
+                    const std::vector<SuiteResult>& results) {
+    std::ostringstream out;
+    out << std::setprecision(6);
+    out << "{\n";
+    out << "  \"dataset\": {\"root\": " << json_string(root) << ", \"synthetic\": " << (synthetic ? "true" : "false")
+        << ", \"train_count\": " << data.train_count << ", \"test_count\": " << data.test_count << "},\n";
+    out << "  \"reps\": " << reps << ",\n";
+    out << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SuiteResult& r = results[i];
+        double med = median(r.samples_ms);
+        out << "    {\"name\": " << json_string(r.name) << ", \"iterations\": " << r.iterations
+            << ", \"min_ms\": " << *std::min_element(r.samples_ms.begin(), r.samples_ms.end())
+            << ", \"median_ms\": " << med << ", \"p99_ms\": " << percentile(r.samples_ms, 0.99)
+            << ", \"bytes\": " << static_cast<long long>(r.bytes) << ", \"bytes_per_sec\": ";
+        if (r.bytes > 0.0 && med > 0.0) {
+            out << r.bytes / (med * 1e-3);
+        } else {
+            out << "null";
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+    // Stage counters accumulated over the whole run, from the library's own instrumentation
+    out << "  \"metrics\": " << metrics_json(metrics_snapshot()) << "\n}\n";
+    return out.str();
+}
+
+} // anonymous namespace
+
+int bench_suite(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    std::string json_path = argc > 2 ? argv[2] : "-";
+    int reps = argc > 3 ? std::stoi(argv[3]) : 10;
+
+    // "synthetic" generates a full-size stand-in dataset, so the suite runs without a download
+    bool synthetic = root == "synthetic";
+    if (synthetic) {
+        root = "./bench_synthetic";
+        write_synthetic_mnist(root, 60000, 10000, 1);
+    }
+
+    // Progress logging stays out of the timings and the report; warnings still show
+    set_log_level(LogLevel::Warning);
+    init_mnist(root);
+    MnistData data = load_mnist(root);
+    const double img_size = static_cast<double>(data.rows) * data.cols;
+    const double idx_bytes = (data.train_count + data.test_count) * (img_size + 1.0) + 4 * 16;
+    // JSON on stdout stays machine-readable; the table goes to stderr then
+    std::ostream& table = json_path == "-" ? std::cerr : std::cout;
+    std::streambuf* table_saved = std::cout.rdbuf(table.rdbuf());
+
+    std::cout << "\nBenchmark suite on " << root << " (" << data.train_count << " train, " << data.test_count
+              << " test), " << reps << " samples each\n";
+    std::vector<SuiteResult> results;
+
+    // Startup when everything is already on disk: existence and magic-number checks only
+    results.push_back(measure("init_mnist_verify", reps, 1, 0.0, [&] { init_mnist(root); }));
+
+    // mmap, header checks and uint8 -> float normalization of all four files
+    results.push_back(measure("load_mnist_normalize", reps, 1, idx_bytes, [&] {
+        MnistData loaded = load_mnist(root);
+        if (loaded.train_count != data.train_count) throw std::runtime_error("load_mnist returned a different dataset");
+    }));
+    MnistLoadOptions raw_options;
+    raw_options.storage = MnistStorage::Uint8;
+    results.push_back(measure("load_mnist_uint8", reps, 1, idx_bytes, [&] { load_mnist(root, raw_options); }));
+
+    // One pass over the training split, output bytes (images + labels) per pass
+    const int batch_size = 100;
+    const double batch_bytes = static_cast<double>(data.train_count) * (img_size + 1.0) * sizeof(float);
+    MnistBatchLoader loader(data, batch_size);
+    RowMatrixXf batch_x;
+    Eigen::VectorXi batch_y;
+    results.push_back(measure("next_train_batch", reps, 1, batch_bytes, [&] {
+        loader.reset();
+        while (loader.next_train_batch(batch_x, batch_y)) {
+        }
+    }));
+    MnistBatchLoader shuffled(data, batch_size);
+    shuffled.enable_shuffle(42);
+    MnistBatch batch;
+    results.push_back(measure("next_train_batch_shuffled", reps, 1, batch_bytes, [&] {
+        shuffled.reset();
+        while (shuffled.next_train_batch(batch)) {
+        }
+    }));
+
+    // Loss on a batch of softmax outputs with one-hot targets
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> uniform(0.01, 1.0);
+    Eigen::MatrixXd y(batch_size, 10);
+    Eigen::MatrixXd t = Eigen::MatrixXd::Zero(batch_size, 10);
+    for (int i = 0; i < batch_size; ++i) {
+        for (int j = 0; j < 10; ++j) y(i, j) = uniform(rng);
+        y.row(i) /= y.row(i).sum();
+        t(i, i % 10) = 1.0;
+    }
+    volatile double sink = 0.0;
+    results.push_back(measure("cross_entropy_error", reps, 1000, 2.0 * y.size() * sizeof(double),
+                              [&] { sink = sink + Math::cross_entropy_error(y, t); }));
+
+    // End to end: one shuffled SGD epoch of a 784-100-10 MLP
+    Mlp model({data.rows * data.cols, 100, 10}, 42);
+    MlpTrainer trainer(model, OptimizerConfig(), batch_size);
+    MnistBatchLoader epoch_loader(data, batch_size);
+    epoch_loader.enable_shuffle(42);
+    results.push_back(measure("train_epoch_sgd", std::max(1, reps / 3), 1, batch_bytes,
+                              [&] { trainer.train_epoch(epoch_loader); }));
+
+    std::cout.rdbuf(table_saved);
+    std::string json = to_json(root, synthetic, data, reps, results);
+    if (json_path == "-") {
+        std::cout << json;
+    } else {
+        std::ofstream out(json_path, std::ios::trunc);
+        out << json;
+        if (!out) throw std::runtime_error("Cannot write " + json_path);
+        std::cout << "Results written to " << json_path << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "bench.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace {
+
+void put_int(std::vector<uint8_t>& out, uint32_t value) {
+    out.push_back(static_cast<uint8_t>(value >> 24));
+    out.push_back(static_cast<uint8_t>(value >> 16));
+    out.push_back(static_cast<uint8_t>(value >> 8));
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+} // anonymous namespace
+
+// Writes the raw IDX file and its .gz archive, so init_mnist finds both and only verifies
+void write_idx_pair(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream raw(path, std::ios::binary | std::ios::trunc);
+    raw.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!raw) throw std::runtime_error("Cannot write " + path);
+
+    std::string gz_path = path + ".gz";
+    gzFile gz = gzopen(gz_path.c_str(), "wb1");
+    if (!gz) throw std::runtime_error("Cannot write " + gz_path);
+    size_t offset = 0;
+    while (offset < bytes.size()) {
+        unsigned chunk = static_cast<unsigned>(std::min<size_t>(bytes.size() - offset, 1u << 20));
+        if (gzwrite(gz, bytes.data() + offset, chunk) != static_cast<int>(chunk)) {
+            gzclose(gz);
+            throw std::runtime_error("Cannot write " + gz_path);
+        }
+        offset += chunk;
+    }
+    if (gzclose(gz) != Z_OK) throw std::runtime_error("Cannot write " + gz_path);
+}
+
+namespace {
+
+// Each class is a fixed random stroke pattern; samples jitter its position and add noise,
+// so the set is learnable but not trivially separable by a single pixel
+void write_split(const std::string& root, const std::string& prefix, int count,
+                 const std::vector<std::vector<uint8_t>>& templates, std::mt19937& rng) {
+    const int side = 28;
+    std::vector<uint8_t> images;
+    std::vector<uint8_t> labels;
+    images.reserve(16 + static_cast<size_t>(count) * side * side);
+    labels.reserve(8 + count);
+    put_int(images, 2051);
+    put_int(images, count);
+    put_int(images, side);
+    put_int(images, side);
+    put_int(labels, 2049);
+    put_int(labels, count);
+
+    std::uniform_int_distribution<int> label_dist(0, 9);
+    std::uniform_int_distribution<int> shift(-2, 2);
+    std::uniform_int_distribution<int> noise(0, 40);
+    for (int i = 0; i < count; ++i) {
+        int label = label_dist(rng);
+        int dy = shift(rng), dx = shift(rng);
+        const auto& t = templates[label];
+        for (int y = 0; y < side; ++y) {
+            for (int x = 0; x < side; ++x) {
+                int sy = y - dy, sx = x - dx;
+                int v = (sy >= 0 && sy < side && sx >= 0 && sx < side) ? t[sy * side + sx] : 0;
+                v = v > 0 ? std::max(0, v - noise(rng)) : (noise(rng) > 36 ? noise(rng) : 0);
+                images.push_back(static_cast<uint8_t>(v));
+            }
+        }
+        labels.push_back(static_cast<uint8_t>(label));
+    }
+    write_idx_pair(root + "/" + prefix + "-images-idx3-ubyte", images);
+    write_idx_pair(root + "/" + prefix + "-labels-idx1-ubyte", labels);
+}
+
+} // anonymous namespace
+
+void write_synthetic_mnist(const std::string& root, int train_count, int test_count, uint32_t seed) {
+    if (::mkdir(root.c_str(), 0755) != 0 && errno != EEXIST) {
+        throw std::runtime_error("Cannot create directory " + root);
+    }
+    std::mt19937 rng(seed);
+    std::vector<std::vector<uint8_t>> templates(10, std::vector<uint8_t>(28 * 28, 0));
+    std::uniform_int_distribution<int> coord(6, 21);
+    for (auto& t : templates) {
+        // A handful of thick random line segments in the central 20x20 area
+        for (int stroke = 0; stroke < 3; ++stroke) {
+            int y0 = coord(rng), x0 = coord(rng), y1 = coord(rng), x1 = coord(rng);
+            for (int s = 0; s <= 32; ++s) {
+                int y = y0 + (y1 - y0) * s / 32, x = x0 + (x1 - x0) * s / 32;
+                for (int oy = 0; oy < 2; ++oy) {
+                    for (int ox = 0; ox < 2; ++ox) t[(y + oy) * 28 + x + ox] = 255;
+                }
+            }
+        }
+    }
+    write_split(root, "train", train_count, templates, rng);
+    write_split(root, "t10k", test_count, templates, rng);
+}
+
+int bench_synth(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int train_count = argc > 2 ? std::stoi(argv[2]) : 60000;
+    int test_count = argc > 3 ? std::stoi(argv[3]) : 10000;
+    uint32_t seed = argc > 4 ? static_cast<uint32_t>(std::stoul(argv[4])) : 1;
+    write_synthetic_mnist(root, train_count, test_count, seed);
+    std::cout << "Wrote synthetic MNIST (" << train_count << " train, " << test_count << " test images) to "
+              << root << std::endl;
+    return 0;
+}
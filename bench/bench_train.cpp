@@ -0,0 +1,83 @@
+#include "bench.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+namespace {
+
+// Compares the backward pass against central differences on a small network
+bool gradient_check() {
+    const int count = 5;
+    Mlp model({12, 8, 6, 4}, 3);
+    MlpWorkspace workspace(model.layout(), count);
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    RowMatrixXf x(count, 12);
+    for (Eigen::Index i = 0; i < x.size(); ++i) x.data()[i] = uniform(rng);
+    int labels[count] = {0, 3, 1, 2, 3};
+
+    model.forward_backward(x.data(), labels, count, workspace);
+    Eigen::VectorXf analytic = workspace.gradients;
+    double worst = 0.0;
+    const float h = 1e-2f;
+    for (Eigen::Index i = 0; i < model.parameters().size(); ++i) {
+        float saved = model.parameters()[i];
+        model.parameters()[i] = saved + h;
+        double plus = model.forward_backward(x.data(), labels, count, workspace);
+        model.parameters()[i] = saved - h;
+        double minus = model.forward_backward(x.data(), labels, count, workspace);
+        model.parameters()[i] = saved;
+        double numeric = (plus - minus) / (2.0 * h);
+        worst = std::max(worst, std::abs(numeric - analytic[i]) / std::max(1e-2, std::abs(numeric) + std::abs(analytic[i])));
+    }
+    std::cout << "gradient check: worst relative error " << worst << "\n";
+    return worst < 2e-2;
+}
+
+} // anonymous namespace
+
+int bench_train(int argc, char** argv) {
+    std::string root = argc > 1 ? argv[1] : "./data";
+    int batch_size = argc > 2 ? std::stoi(argv[2]) : 100;
+    int hidden = argc > 3 ? std::stoi(argv[3]) : 100;
+    int epochs = argc > 4 ? std::stoi(argv[4]) : 1;
+
+    bool ok = gradient_check();
+    MnistData data = load_mnist(root);
+
+    std::cout << "\nTraining a 784-" << hidden << "-10 MLP, batch " << batch_size << ", " << epochs << " epoch(s)\n";
+    for (OptimizerKind kind : {OptimizerKind::SGD, OptimizerKind::Momentum, OptimizerKind::Adam}) {
+        Mlp model({data.rows * data.cols, hidden, 10}, 42);
+        OptimizerConfig config;
+        config.kind = kind;
+        MlpTrainer trainer(model, config, batch_size);
+        MnistBatchLoader loader(data, batch_size);
+        loader.enable_shuffle(42);
+        float loss = 0.0f;
+        auto runs = time_runs(epochs, [&] { loss = trainer.train_epoch(loader); });
+        double seconds = 0.0;
+        for (double ms : runs) seconds += ms / 1000.0;
+        float accuracy = trainer.evaluate(data, MnistSplit::Test);
+        std::cout << std::left << std::setw(10) << optimizer_name(kind) << std::right << std::fixed
+                  << std::setprecision(0) << std::setw(10) << trainer.samples_seen() / seconds << " samples/s"
+                  << std::setprecision(4) << "   loss " << loss << "   test accuracy " << accuracy << "\n";
+        ok &= std::isfinite(loss) && accuracy > 0.5f;
+    }
+    {
+        // Images wider than the model's input must be refused, not read at the wrong stride
+        Mlp narrow({data.rows * data.cols / 2, hidden, 10}, 42);
+        MlpTrainer trainer(narrow, OptimizerConfig(), batch_size);
+        MnistBatchLoader loader(data, batch_size);
+        bool rejected = throws([&] { trainer.train_epoch(loader); }) &&
+                        throws([&] { trainer.evaluate(data, MnistSplit::Test); });
+        std::cout << (rejected ? "PASS  " : "FAIL  ") << "a model/image size mismatch is rejected\n";
+        ok &= rejected;
+    }
+    std::cout << (ok ? "training checks passed" : "training checks FAILED") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,28 @@
+#ifndef AUGMENT_H
+#define AUGMENT_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// 数据增强：对单张行优先rows x cols的float图像原地变换。
+// seed由加载器按样本与轮次生成（见augment_sample_seed），同一样本在同一轮的结果与线程数、调度顺序无关；
+// scratch为调用线程私有的缓冲区，增强函数可按需扩容并在之后的调用中复用，稳定后不再分配内存
+using AugmentFn = std::function<void(float* image, int rows, int cols, uint64_t seed, std::vector<float>& scratch)>;
+
+// 第epoch轮中编号为sample的样本使用的种子
+uint64_t augment_sample_seed(uint64_t seed, uint64_t epoch, int64_t sample);
+
+// 几何增强的参数，各项在给定范围内均匀随机取值
+struct AugmentOptions {
+    float max_shift = 2.0f;      // 平移上限（像素），水平与竖直方向各自取[-max_shift, max_shift]
+    float max_rotation = 10.0f;  // 绕图像中心旋转的角度上限（度）
+    float elastic_alpha = 0.0f;  // 弹性形变的幅度（像素），0为关闭；Simard等人在28x28上使用34
+    float elastic_sigma = 4.0f;  // 随机位移场高斯平滑的标准差（像素）
+};
+
+// 平移、旋转与弹性形变合成一个采样坐标场，再经SIMD双线性重采样（bilinear_sample）得到结果；
+// 图像之外按0（背景）填充。参数为负或elastic_sigma不为正时抛出std::runtime_error
+AugmentFn make_geometric_augment(const AugmentOptions& options);
+
+#endif // AUGMENT_H
@@ -0,0 +1,88 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mlp.h"
+
+// 模型检查点：单个文件保存MLP的层大小、参数arena与优化器状态（配置、步数与状态arena）。
+// 参数arena按MlpLayout原样写入（各层W与b已按64字节对齐），文件中的起点同样按64字节对齐，
+// 推理进程mmap检查点后直接以映射内存作为权重（MAP_PRIVATE，只读），不解析也不拷贝。
+//
+// 文件布局（本机字节序，头部记录字节序标记，不匹配时拒绝加载）：
+//   [CheckpointHeader][padding][parameters][padding][optimizer state]
+constexpr unsigned MLP_CHECKPOINT_VERSION = 1;
+
+// 头部记录的元数据
+struct CheckpointInfo {
+    std::vector<int> sizes;   // 输入、各隐藏层与输出的大小
+    OptimizerConfig optimizer;
+    bool has_optimizer = false;
+    int64_t steps = 0;        // 优化器已执行的步数
+    uint64_t epoch = 0;       // 调用者记录的轮次
+};
+
+// 同步写入检查点；先写临时文件、fsync再rename，读者不会看到写了一半的文件。
+// optimizer为空时只保存参数；失败时抛出std::runtime_error
+void save_checkpoint(const std::string& path, const Mlp& model, const Optimizer* optimizer = nullptr,
+                     uint64_t epoch = 0);
+
+// 只读取并校验头部
+CheckpointInfo read_checkpoint_info(const std::string& path);
+
+// 把检查点拷贝进可训练的model（层大小须一致），optimizer非空时一并恢复状态与步数（种类须一致）；
+// 总是校验CRC32。格式、版本、布局不符或校验失败时抛出std::runtime_error
+CheckpointInfo load_checkpoint(const std::string& path, Mlp& model, Optimizer* optimizer = nullptr);
+
+// 映射检查点并返回只读模型，参数直接引用映射内存；verify_checksum为true时额外校验全部数据的CRC32
+Mlp map_checkpoint(const std::string& path, bool verify_checksum = false);
+
+// 后台写入检查点：save_async在调用线程上只把参数与优化器状态拷贝到预先分配的缓冲区（参数的一致快照），
+// 序列化、CRC、fsync与rename都在后台线程上完成，训练循环不等待磁盘。
+// 上一次写入尚未完成时不排队也不等待，返回false并计入skipped。
+// save_async与wait只能由同一个线程调用
+class CheckpointWriter {
+public:
+    CheckpointWriter();
+    // 等待进行中的写入完成后退出后台线程
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    bool save_async(const std::string& path, const Mlp& model, const Optimizer* optimizer = nullptr,
+                    uint64_t epoch = 0);
+    // 等待进行中的写入完成；后台写入失败时在此（或下一次save_async中）抛出其异常
+    void wait();
+
+    uint64_t saved() const;
+    uint64_t skipped() const { return skip_count; }
+
+private:
+    void writer_loop();
+    // 抛出并清除后台写入的异常；调用时须持有mutex
+    void rethrow_error();
+
+    // 待写入的快照，由调用线程填充，后台线程只在busy期间读取
+    std::string path;
+    CheckpointInfo info;
+    Eigen::VectorXf params;
+    Eigen::VectorXf state;
+
+    mutable std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    bool busy = false;
+    bool stopping = false;
+    std::exception_ptr error;
+    uint64_t save_count = 0;
+    uint64_t skip_count = 0;
+    std::thread worker;
+};
+
+#endif // CHECKPOINT_H
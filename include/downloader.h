@@ -0,0 +1,27 @@
+#ifndef DOWNLOADER_H
+#define DOWNLOADER_H
+
+#include <string>
+#include <vector>
+
+// 一个待下载的文件：从urls[0]开始尝试，失败时轮换到下一个地址
+struct DownloadJob {
+    std::vector<std::string> urls;
+    std::string out_path;
+};
+
+// 下载选项
+struct DownloadOptions {
+    int max_parallel = 4;            // 同时进行的传输数
+    int max_rounds = 2;              // 没有任何进展的尝试，每个地址最多允许的次数
+    long connect_timeout = 15;       // 连接超时（秒）
+    long long abort_after_bytes = 0; // 测试用：每次传输收到这么多字节后中止，模拟连接中断（0为关闭）
+};
+
+// 用curl multi接口并行下载全部文件
+// 数据先写入out_path + ".part"，中断后通过HTTP Range（或file://的偏移）续传：有进展时留在同一地址，
+// 毫无进展时轮换到下一个地址。下载完成并通过gzip头部检查后才改名为out_path。
+// 全部成功时返回，否则抛出列出失败文件的std::runtime_error（.part文件保留以便下次续传）
+void download_all(const std::vector<DownloadJob>& jobs, const DownloadOptions& options = DownloadOptions());
+
+#endif // DOWNLOADER_H
@@ -0,0 +1,109 @@
+#ifndef EVALUATOR_H
+#define EVALUATOR_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "metrics.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include "thread_team.h"
+
+// 一次评估的结果：混淆矩阵（行为真实类别，列为预测类别）及由此得到的各项指标
+struct EvalReport {
+    int num_classes = 0;
+    int count = 0;                  // 参与评估的样本数
+    int correct = 0;
+    std::vector<int64_t> confusion; // num_classes x num_classes，行优先
+    double seconds = 0.0;           // 本次评估的耗时（墙钟）
+    int threads = 0;
+
+    int64_t cell(int truth, int predicted) const { return confusion[static_cast<size_t>(truth) * num_classes + predicted]; }
+    float accuracy() const { return count > 0 ? static_cast<float>(correct) / count : 0.0f; }
+    // 预测为c的样本中真实为c的比例；没有样本被预测为c时为0
+    float precision(int c) const;
+    // 真实为c的样本中被预测为c的比例；split中没有c类样本时为0
+    float recall(int c) const;
+    // 每秒评估的样本数
+    double samples_per_second() const { return seconds > 0.0 ? count / seconds : 0.0; }
+};
+
+// 打印各类别的精确率、召回率与样本数，以及混淆矩阵
+void print_eval_report(std::ostream& out, const EvalReport& report);
+
+// 一个评估线程私有的计数与预测缓冲区，构造时一次性分配
+struct EvalShard {
+    std::vector<int> predictions;   // 一批（block个）样本的预测类别
+    std::vector<int64_t> confusion;
+    int correct = 0;
+
+    EvalShard(int num_classes, int block);
+    // 把predictions中前count个预测与labels[start, start + count)计入混淆矩阵；
+    // 标签超出[0, num_classes)时抛出std::runtime_error，classes_of说明类别数的来源（如"the model's"）
+    void count(const int* labels, int start, int count, int num_classes, const char* classes_of);
+};
+
+// 按线程顺序合并各线程的计数
+EvalReport merge_eval_shards(const std::vector<EvalShard>& shards, int num_classes, int count);
+
+// 分类器共用的并行评估：split按样本平均切成team.size()段，每个线程以block个样本为一批调用
+// classify(thread_index, start, count, predictions)写出预测类别，在shards[thread_index]中计数，
+// 最后按线程顺序合并，结果与线程数无关；耗时计入MetricTimer::Evaluate
+template <typename Classify>
+EvalReport evaluate_classifier(ThreadTeam& team, std::vector<EvalShard>& shards, const MnistData& data,
+                               MnistSplit split, int num_classes, int block, const char* classes_of,
+                               Classify classify) {
+    ScopedTimer timer(MetricTimer::Evaluate);
+    const auto start_time = std::chrono::steady_clock::now();
+    const int n = split == MnistSplit::Train ? data.train_count : data.test_count;
+    const int* labels = (split == MnistSplit::Train ? data.train_labels : data.test_labels).data();
+    auto task = [&](int thread_index) {
+        EvalShard& shard = shards[thread_index];
+        std::fill(shard.confusion.begin(), shard.confusion.end(), 0);
+        shard.correct = 0;
+        const int end = thread_range_begin(n, thread_index + 1, team.size());
+        for (int start = thread_range_begin(n, thread_index, team.size()); start < end; start += block) {
+            const int count = std::min(block, end - start);
+            classify(thread_index, start, count, shard.predictions.data());
+            shard.count(labels, start, count, num_classes, classes_of);
+        }
+    };
+    team.run(task);
+
+    EvalReport report = merge_eval_shards(shards, num_classes, n);
+    report.threads = team.size();
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    return report;
+}
+
+// 并行批量评估：split按样本平均切成num_threads段，各线程以batch_size为批做前向计算与argmax，
+// 在线程私有的混淆矩阵中计数，最后按线程顺序合并。结果与线程数无关。
+// Float存储时直接在MnistData上做前向计算，不拷贝图像；Uint8存储时逐批转换为float。
+// 模型与数据须在评估器的生命周期内有效；构造后每次evaluate都不分配内存（结果报告除外）
+class MnistEvaluator {
+public:
+    MnistEvaluator(const Mlp& model, const MnistData& data, int batch_size, int num_threads);
+
+    EvalReport evaluate(MnistSplit split);
+
+    int num_threads() const { return team.size(); }
+
+private:
+    // 线程私有的缓冲区，各自独立分配，互不共享缓存行
+    struct Replica {
+        MlpWorkspace workspace;
+        RowMatrixXf images;
+    };
+
+    const Mlp& model;
+    const MnistData& data;
+    int batch_size;
+    int num_classes;
+    ThreadTeam team;
+    std::vector<Replica> replicas;
+    std::vector<EvalShard> shards;
+};
+
+#endif // EVALUATOR_H
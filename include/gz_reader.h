@@ -0,0 +1,36 @@
+#ifndef GZ_READER_H
+#define GZ_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <zlib.h>
+#include "idx_file.h"
+
+// 流式gzip解码器：压缩文件整体mmap作为输入，直接解压到调用者给出的内存中，
+// 不写临时文件，也不经过固定大小的中间缓冲区
+class GzReader {
+public:
+    // 打开并映射.gz文件，失败时抛出std::runtime_error
+    explicit GzReader(const std::string& path);
+    ~GzReader();
+
+    GzReader(const GzReader&) = delete;
+    GzReader& operator=(const GzReader&) = delete;
+
+    // 读取至多n字节到dst，返回实际读取的字节数；返回0表示数据已全部解压
+    size_t read(void* dst, size_t n);
+    // 恰好读取n字节，数据不足时抛出std::runtime_error
+    void read_exact(void* dst, size_t n);
+    // 读取一个32位大端整数
+    int read_int();
+
+    const std::string& path() const { return input.path(); }
+
+private:
+    MappedFile input;
+    z_stream stream;
+    bool finished = false;
+};
+
+#endif // GZ_READER_H
@@ -0,0 +1,115 @@
+#ifndef IDX_FILE_H
+#define IDX_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 只读字节区间（C++17没有std::span）
+struct ByteSpan {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// 只读内存映射文件（不支持mmap的平台上整体读入内存）
+class MappedFile {
+public:
+    MappedFile() = default;
+    // 映射整个文件，失败时抛出std::runtime_error；sequential提示内核按顺序预读
+    explicit MappedFile(const std::string& path, bool sequential = true);
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool is_open() const { return mapping != nullptr; }
+    const std::string& path() const { return file_path; }
+    const uint8_t* data() const { return mapping; }
+    size_t size() const { return mapping_size; }
+
+private:
+    void release();
+
+    std::string file_path;
+    const uint8_t* mapping = nullptr;
+    size_t mapping_size = 0;
+    std::vector<uint8_t> fallback;
+};
+
+// IDX元素类型（魔数的第三个字节），多字节类型在文件中为大端序
+enum class IdxType : uint8_t {
+    UInt8 = 0x08,
+    Int8 = 0x09,
+    Int16 = 0x0B,
+    Int32 = 0x0C,
+    Float32 = 0x0D,
+    Float64 = 0x0E
+};
+
+// 单个元素的字节数
+size_t idx_type_size(IdxType type);
+const char* idx_type_name(IdxType type);
+
+// IDX头部：魔数、元素类型与各维度
+struct IdxHeader {
+    int magic = 0;
+    IdxType type = IdxType::UInt8;
+    std::vector<int> shape;   // 全部维度，第一维为样本数
+    size_t header_bytes = 0;  // 头部长度，即负载的起始偏移
+    size_t item_elements = 1; // 单个样本的元素数（除第一维外各维度之积）
+
+    int count() const { return shape.empty() ? 0 : shape[0]; }
+    size_t item_bytes() const { return item_elements * idx_type_size(type); }
+};
+
+// 从data开头解析头部，数据不足或格式不合法时抛出std::runtime_error
+// 头部最长为4 + 4 * 255字节；size不足以容纳完整头部时同样抛出
+IdxHeader parse_idx_header(const uint8_t* data, size_t size);
+
+// 把n个type类型的大端元素转换为本机float，并除以divisor（uint8走SIMD内核）
+void idx_decode(IdxType type, const uint8_t* src, size_t n, float* dst, float divisor = 1.0f);
+// 把n个整数类型的元素转换为int（标签用），浮点类型抛出std::runtime_error
+void idx_decode(IdxType type, const uint8_t* src, size_t n, int* dst);
+
+// 基于mmap的IDX文件只读视图，支持全部元素类型与任意维数
+// 头部直接在映射内存上校验，负载以零拷贝的ByteSpan形式暴露，不经过任何中间缓冲区
+class IdxFile {
+public:
+    IdxFile() = default;
+    // 映射并校验文件，失败时抛出std::runtime_error
+    explicit IdxFile(const std::string& path);
+
+    IdxFile(IdxFile&&) noexcept = default;
+    IdxFile& operator=(IdxFile&&) noexcept = default;
+
+    bool is_open() const { return file.is_open(); }
+    const std::string& path() const { return file.path(); }
+
+    // 完整的魔数（如MNIST图像为2051，标签为2049）
+    int magic() const { return header.magic; }
+    IdxType type() const { return header.type; }
+    // 第一维的大小，即样本数
+    int count() const { return header.count(); }
+    // 全部维度（包括第一维）
+    const std::vector<int>& shape() const { return header.shape; }
+    // 单个样本的元素数与字节数
+    size_t item_elements() const { return header.item_elements; }
+    size_t item_size() const { return header.item_bytes(); }
+
+    // 全部样本数据，不含头部与文件末尾的多余字节
+    ByteSpan payload() const;
+    // 第i个样本的数据
+    ByteSpan item(int i) const;
+    // 负载之后多余的字节数（正常的IDX文件应为0）
+    size_t trailing_bytes() const { return trailing; }
+
+private:
+    MappedFile file;
+    IdxHeader header;
+    size_t trailing = 0;
+};
+
+#endif // IDX_FILE_H
@@ -0,0 +1,84 @@
+#ifndef IDX_STREAM_H
+#define IDX_STREAM_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "idx_file.h"
+#include "mnist_loader.h"
+
+// 流式加载选项
+struct IdxStreamOptions {
+    int chunk_size = 4096; // 每块的样本数
+    int depth = 2;         // 环形缓冲区中的块数；常驻内存约为(depth + 1)个块，与数据集大小无关
+    bool normalize = true; // uint8图像是否缩放到[0, 1]，其它类型按原值转换
+};
+
+// 超出内存的IDX数据集的分块流式加载器
+// 后台读取线程按顺序从图像与标签文件读入固定大小的块，解码为float后放入depth个预分配槽位的环形缓冲区；
+// 消费者取块时与槽位交换缓冲区，稳态下不分配内存。图像文件与load_mnist的要求相同（任意元素类型，
+// count x rows x cols或count x features），标签文件为一维整数。next_chunk与reset只能由同一个消费者线程调用。
+class IdxStreamLoader {
+public:
+    // 打开并校验两个文件，失败时抛出std::runtime_error
+    IdxStreamLoader(const std::string& images_path, const std::string& labels_path,
+                    const IdxStreamOptions& options = IdxStreamOptions());
+    ~IdxStreamLoader();
+
+    IdxStreamLoader(const IdxStreamLoader&) = delete;
+    IdxStreamLoader& operator=(const IdxStreamLoader&) = delete;
+
+    // 取出下一块（chunk.count个有效样本）；数据取完时返回false；读取出错时在此抛出
+    bool next_chunk(MnistBatch& chunk);
+
+    // 丢弃已读入的块，从文件开头重新开始
+    void reset();
+
+    int count() const { return image_header.count(); }
+    int rows() const { return image_rows; }
+    int cols() const { return image_cols; }
+    IdxType type() const { return image_header.type; }
+    int chunk_size() const { return chunk_samples; }
+    int num_chunks() const { return chunk_count; }
+    // 环形缓冲区与读取缓冲区占用的字节数，即流式加载的内存上限
+    size_t buffer_bytes() const;
+
+private:
+    struct Slot {
+        MnistBatch batch;
+        int64_t ready_seq = -1; // 槽位中已就绪块的序号，-1表示空
+    };
+
+    void start();
+    void stop();
+    void reader_loop();
+    void read_chunk(int64_t seq, MnistBatch& batch);
+
+    std::ifstream images;
+    std::ifstream labels;
+    IdxHeader image_header;
+    IdxHeader label_header;
+    int image_rows = 0;
+    int image_cols = 0;
+    int chunk_samples;
+    int chunk_count;
+    float divisor;
+    std::vector<uint8_t> raw_images; // 读取线程的原始字节缓冲区
+    std::vector<uint8_t> raw_labels;
+    std::vector<Slot> slots;
+
+    std::mutex mutex;
+    std::condition_variable free_cv;  // 有空槽位，或需要停止
+    std::condition_variable ready_cv; // 有块就绪，或读取出错
+    int64_t consume_seq = 0;          // 消费者下一个要取的块序号
+    bool stopping = false;
+    std::exception_ptr error;         // 读取线程的异常，由next_chunk重新抛出
+    std::thread reader;
+};
+
+#endif // IDX_STREAM_H
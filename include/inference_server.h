@@ -0,0 +1,110 @@
+#ifndef INFERENCE_SERVER_H
+#define INFERENCE_SERVER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mlp.h"
+
+// 协议：客户端连续发送784字节的原始图像（0~255，与IDX文件相同），服务器按到达顺序
+// 为每张图像回复1字节的预测类别。同一连接上可以有任意多个未完成的请求（流水线）。
+
+// 服务器选项
+struct InferenceServerOptions {
+    std::string address;        // Unix套接字路径，或"127.0.0.1:端口"形式的回环地址（只接受127.0.0.0/8，端口1~65535）
+    int max_batch = 64;         // 每次前向最多合并的请求数
+    int max_wait_us = 1000;     // 最早的请求最多等待多久就开始前向，即使批次未满
+    int queue_capacity = 4096;  // 待处理请求的上限，满时读取线程阻塞（背压）
+    bool normalize = true;      // 像素是否除以255，须与训练时一致
+};
+
+// 延迟与吞吐量统计
+struct InferenceStats {
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    double mean_batch = 0.0;
+    double p50_us = 0.0;        // 从收齐一张图像到写出回复的延迟（最近65536个请求）
+    double p99_us = 0.0;
+    double requests_per_sec = 0.0; // 自启动以来的平均吞吐量
+};
+
+// 动态批处理推理服务器
+// 每个连接一个读取线程，把收齐的图像放入队列；一个批处理线程按max_batch/max_wait_us
+// 取出一批，转换为float后只做一次前向，再把结果追加到各自连接的输出缓冲区。
+// 每个连接另有一个写出线程负责发送（处理部分写入），批处理线程从不阻塞在网络上；
+// 不读取回复的客户端只会让自己的读取线程在未发送的回复达到上限后停止接收，不影响其它连接。
+// 发送失败时关闭该连接
+class InferenceServer {
+public:
+    // 绑定并开始监听，失败时抛出std::runtime_error；model在服务器的生命周期内不得修改
+    InferenceServer(const Mlp& model, const InferenceServerOptions& options);
+    ~InferenceServer();
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    // 停止接受连接，关闭全部连接并等待线程退出；可重复调用
+    void stop();
+
+    InferenceStats stats() const;
+    const std::string& address() const { return opts.address; }
+
+    static constexpr int image_bytes = 784;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection;
+    struct Request {
+        std::shared_ptr<Connection> connection;
+        std::array<uint8_t, image_bytes> image;
+        Clock::time_point arrival;
+    };
+    // 一个连接的读取与写出线程
+    struct Reader {
+        std::thread thread;
+        std::thread writer;
+        std::shared_ptr<Connection> connection;
+        std::shared_ptr<std::atomic<int>> done; // 已退出的线程数，为2时可以回收
+    };
+
+    void accept_loop();
+    void read_loop(std::shared_ptr<Connection> connection, std::shared_ptr<std::atomic<int>> done);
+    void write_loop(std::shared_ptr<Connection> connection, std::shared_ptr<std::atomic<int>> done);
+    void batch_loop();
+    void reap_readers(bool all);
+
+    const Mlp& model;
+    InferenceServerOptions opts;
+    int listen_fd = -1;
+    bool unix_socket = false;
+    Clock::time_point started;
+
+    mutable std::mutex mutex;
+    std::condition_variable queue_cv; // 有新请求或需要停止
+    std::condition_variable space_cv; // 队列有空位
+    std::deque<Request> queue;
+    bool stopping = false;
+
+    std::mutex readers_mutex;
+    std::vector<Reader> readers;
+
+    // 只由批处理线程写入，读取时持有mutex
+    uint64_t total_requests = 0;
+    uint64_t total_batches = 0;
+    std::vector<float> latencies_us; // 最近请求的延迟，环形写入
+    size_t latency_next = 0;
+
+    std::thread acceptor;
+    std::thread batcher;
+};
+
+#endif // INFERENCE_SERVER_H
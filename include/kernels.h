@@ -0,0 +1,44 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 数据通路上的SIMD内核，按标量、SSE4.1、AVX2与AVX-512分级实现（某一级没有收益时沿用低一级的实现），
+// 首次调用时按CPUID选出CPU支持的最高级别，同一个可移植的二进制在不同机器上都用上最快的实现。
+// 各级别的结果逐位相同。
+
+// 指令集级别
+enum class SimdLevel {
+    Scalar,
+    Sse4,   // SSE4.1
+    Avx2,
+    Avx512  // AVX-512F + BW + VL
+};
+
+// CPU支持的最高级别（非x86平台为Scalar）
+SimdLevel detected_simd_level();
+// 当前使用的级别
+SimdLevel simd_level();
+// 切换级别（测试与基准用），超出CPU支持时抛出std::runtime_error
+void set_simd_level(SimdLevel level);
+const char* simd_level_name(SimdLevel level);
+
+// uint8 -> float 转换并缩放：dst[i] = src[i] / divisor
+// 用除法而非乘以倒数，结果与load_mnist逐像素的 / 255.0f 逐位一致
+void u8_to_f32(const uint8_t* src, float* dst, size_t n, float divisor);
+
+// 按indices收集count行，每行row_size个元素，依次写入dst（行优先，行间无填充）
+// 随机访问的源行会提前预取
+void gather_rows_f32(const float* src, size_t row_size, const int* indices, int count, float* dst);
+void gather_rows_u8_to_f32(const uint8_t* src, size_t row_size, const int* indices, int count, float* dst,
+                           float divisor);
+
+// 行优先rows x cols矩阵每行最大值的下标，有多个最大值时取最前面的（与Eigen的maxCoeff一致）；不处理NaN
+void argmax_rows(const float* x, int rows, int cols, int* out);
+
+// 双线性重采样：dst[i]为src（行优先rows x cols）在坐标(ys[i], xs[i])处的插值，共n个点；
+// 整数坐标处恰为原像素，图像之外的像素按0计。坐标须为有限值
+void bilinear_sample(const float* src, int rows, int cols, const float* xs, const float* ys, float* dst, int n);
+
+#endif // KERNELS_H
@@ -0,0 +1,73 @@
+#ifndef KNN_H
+#define KNN_H
+
+#include <vector>
+#include "evaluator.h"
+#include "mnist_loader.h"
+#include "thread_team.h"
+
+// k近邻分类器的参数
+struct KnnOptions {
+    int k = 3;
+    bool centroids = false;     // 以训练集各类的均值图像为参考样本（最近类中心分类器，k固定为1）
+    int query_block = 256;      // 每次与一块参考样本相乘的查询数
+    int reference_block = 512;  // 每块参考样本数；一块的距离矩阵为query_block x reference_block
+    int num_threads = 1;
+};
+
+// 非参数的基线分类器：以训练集为参考样本，按欧氏距离取k个最近邻多数投票（票数相同时取其中最近的一个的类别）。
+// 距离按 ||q||² + ||r||² - 2q·r 计算：||r||²在构造时算好，q·r由查询块与参考块的矩阵乘法（Eigen GEMM）得到，
+// ||q||²对同一查询是常数，排序时省略。每个查询只保留当前最近的k个（部分选择），不对全部距离排序；
+// 距离相同时保留编号较小的参考样本。
+// 查询按样本平均分给各线程，每个线程按query_block逐块处理，结果与线程数无关。
+// Float存储直接在MnistData上计算；Uint8存储的参考样本逐块转换为float，不常驻float副本。
+// data须在分类器的生命周期内有效；线程私有的缓冲区在构造时一次性分配
+class KnnClassifier {
+public:
+    // k或块大小不为正、训练集为空时抛出std::runtime_error
+    KnnClassifier(const MnistData& data, const KnnOptions& options);
+
+    // count个查询（行优先count x features的float）各自最近的k个参考样本的编号，按距离从近到远写入out_indices（count x k）；
+    // 参考样本不足k个时其余为-1
+    void search(const float* queries, int count, int* out_indices);
+    // count个查询的预测类别
+    void predict(const float* queries, int count, int* out_labels);
+    // 预测split的全部样本并统计混淆矩阵
+    EvalReport evaluate(MnistSplit split);
+
+    int k() const { return neighbors; }
+    int num_references() const { return reference_count; }
+    int num_threads() const { return team.size(); }
+
+private:
+    // 线程私有的缓冲区，各自独立分配，互不共享缓存行
+    struct Replica {
+        RowMatrixXf queries;          // Uint8存储时转换后的查询块
+        RowMatrixXf references;       // Uint8存储时转换后的参考块
+        RowMatrixXf scores;           // 查询块与参考块的内积
+        std::vector<float> best_distances;
+        std::vector<int> best_indices;
+        std::vector<int> votes;
+    };
+
+    // 对count（不超过query_block）个查询求最近的k个，结果留在replica.best_*中
+    void search_block(Replica& replica, const float* queries, int count);
+    int vote(Replica& replica, int query) const;
+    const float* reference_rows(Replica& replica, int begin, int count) const;
+
+    const MnistData& data;
+    int neighbors;
+    int query_block;
+    int reference_block;
+    int features;
+    int num_classes;
+    int reference_count;
+    RowMatrixXf centroid_images;         // centroids模式的参考样本
+    std::vector<int> reference_labels;
+    Eigen::VectorXf reference_norms;     // ||r||²
+    ThreadTeam team;
+    std::vector<Replica> replicas;
+    std::vector<EvalShard> shards;
+};
+
+#endif // KNN_H
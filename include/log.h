@@ -0,0 +1,37 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <sstream>
+#include <string>
+
+// 日志级别，数值越大输出越多
+enum class LogLevel {
+    Silent,  // 不输出任何内容
+    Warning, // 只输出警告（std::cerr）
+    Info,    // 进度信息（std::cout），默认
+    Debug    // 逐轮等高频信息
+};
+
+// 全局日志级别；初始值取自环境变量MNIST_LOG_LEVEL（silent/warning/info/debug），未设置时为Info
+void set_log_level(LogLevel level);
+LogLevel log_level();
+bool log_enabled(LogLevel level);
+
+// 输出一整行（Warning写入std::cerr，其余写入std::cout），单次写入，多线程输出不会交错；不刷新缓冲区
+void log_write(LogLevel level, const std::string& line);
+
+// 级别未启用时不对参数求值；用法：MNIST_LOG_INFO("Loaded " << count << " images");
+#define MNIST_LOG(level, expr)                                  \
+    do {                                                        \
+        if (log_enabled(level)) {                               \
+            std::ostringstream mnist_log_line;                  \
+            mnist_log_line << expr << '\n';                     \
+            log_write(level, mnist_log_line.str());             \
+        }                                                       \
+    } while (0)
+
+#define MNIST_LOG_WARN(expr) MNIST_LOG(LogLevel::Warning, "Warning: " << expr)
+#define MNIST_LOG_INFO(expr) MNIST_LOG(LogLevel::Info, expr)
+#define MNIST_LOG_DEBUG(expr) MNIST_LOG(LogLevel::Debug, expr)
+
+#endif // LOG_H
@@ -2,9 +2,79 @@
 #define MATH_HPP
 
 #include <Eigen/Dense>
+#include <cmath>
 
 class Math {
 public:
+    /// 行优先矩阵，与批次图像的布局一致
+    template <typename Scalar>
+    using RowMatrix = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+    /**
+    * @brief 融合的softmax + 交叉熵误差（SoftmaxWithLoss的正向与反向）
+    *
+    * 每行先减去最大值再求log-sum-exp，数值稳定；损失与梯度(softmax(x) - onehot(t)) / batch_size
+    * 在同一个内核中算出，中间结果直接放在grad中，不创建任何临时矩阵，不分配内存。
+    * 调用时显式指定Scalar，如softmax_cross_entropy<float>(logits, labels, grad)。
+    *
+    * @param logits 未经softmax的输出，形状为(batch_size, num_classes)，行优先
+    * @param labels 标签索引，长度为batch_size（即MnistBatchLoader给出的标签）
+    * @param grad 调用者提供的梯度缓冲区，形状与logits相同；可以与logits是同一块内存
+    * @return 平均交叉熵误差
+    */
+    template <typename Scalar>
+    static Scalar softmax_cross_entropy(const Eigen::Ref<const RowMatrix<Scalar>>& logits,
+                                        const Eigen::Ref<const Eigen::VectorXi>& labels,
+                                        Eigen::Ref<RowMatrix<Scalar>> grad) {
+        const Eigen::Index batch_size = logits.rows();
+        const Eigen::Index num_classes = logits.cols();
+        eigen_assert(labels.size() == batch_size);
+        eigen_assert(grad.rows() == batch_size && grad.cols() == num_classes);
+
+        // 第一遍：每行减去最大值，同时累加 max - x[t]（先读出目标类的logit，grad与logits可以是同一块内存）
+        // 类别数很少（MNIST为10），逐行用Eigen表达式的开销比计算本身还大，所以行内用普通循环
+        Scalar loss = 0;
+        for (Eigen::Index i = 0; i < batch_size; ++i) {
+            const Scalar* x = logits.row(i).data();
+            Scalar* g = grad.row(i).data();
+            const int label = labels[i];
+            eigen_assert(label >= 0 && label < num_classes);
+            Scalar max_logit = x[0];
+            for (Eigen::Index j = 1; j < num_classes; ++j) {
+                max_logit = x[j] > max_logit ? x[j] : max_logit;
+            }
+            loss += max_logit - x[label];
+            for (Eigen::Index j = 0; j < num_classes; ++j) {
+                g[j] = x[j] - max_logit;
+            }
+        }
+
+        // 第二遍：整块求exp。逐行求exp大多落在向量化的尾部，连续存储时按一维数组处理，整批一起向量化
+        if (grad.outerStride() == num_classes) {
+            Eigen::Map<Eigen::Array<Scalar, Eigen::Dynamic, 1>> flat(grad.data(), grad.size());
+            flat = flat.exp();
+        } else {
+            grad = grad.array().exp().matrix();
+        }
+
+        // 第三遍：-log(softmax(x)[t]) = log(sum(exp(x - max))) + max - x[t]；梯度为(softmax - onehot) / batch_size
+        const Scalar inv_batch = Scalar(1) / static_cast<Scalar>(batch_size);
+        for (Eigen::Index i = 0; i < batch_size; ++i) {
+            Scalar* g = grad.row(i).data();
+            Scalar sum = 0;
+            for (Eigen::Index j = 0; j < num_classes; ++j) {
+                sum += g[j];
+            }
+            loss += std::log(sum);
+            const Scalar scale = inv_batch / sum;
+            for (Eigen::Index j = 0; j < num_classes; ++j) {
+                g[j] *= scale;
+            }
+            g[labels[i]] -= inv_batch;
+        }
+        return loss * inv_batch;
+    }
+
     /**
     * @brief 计算交叉熵误差
     * 
@@ -36,7 +106,6 @@ public:
         }
         
         int batch_size = y.rows();
-        int num_classes = y.cols();
         
         // 存储标签索引
         Eigen::VectorXi t_idx(batch_size);
@@ -0,0 +1,121 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// 各阶段的计数器与计时器，进程内全局累计，可随时查询或导出为JSON / Prometheus文本
+// 构建时定义MNIST_METRICS=1启用（CMake选项MNIST_METRICS，默认开启）；
+// 关闭时记录接口都是空的内联函数，编译后不留任何代码，快照全为0
+
+#ifndef MNIST_METRICS
+#define MNIST_METRICS 0
+#endif
+
+// 计数器
+enum class MetricCounter {
+    DownloadBytes,     // 下载写入.part文件的字节数
+    DecompressedBytes, // gzip解压得到的字节数（解压到磁盘或流式解码）
+    ParsedBytes,       // load_mnist从IDX载荷中读取的字节数
+    BatchesServed,     // 加载器交给调用者的批次数
+    SamplesServed,     // 上述批次中的样本数
+    DataWaits,         // 调用者等待预取批次的次数
+    Count
+};
+
+// 计时器：次数、累计与最长一次耗时
+enum class MetricTimer {
+    Download,   // download_all一次调用（并行下载全部缺失文件）
+    Decompress, // 解压一个.gz文件
+    Parse,      // 从映射的IDX文件填充MnistData（含归一化）
+    Normalize,  // 其中uint8 -> float转换的部分
+    DataWait,   // 调用者因预取批次未就绪而阻塞
+    Evaluate,   // MnistEvaluator或KnnClassifier对一个划分的一次完整评估
+    Count
+};
+
+constexpr int metric_counter_count = static_cast<int>(MetricCounter::Count);
+constexpr int metric_timer_count = static_cast<int>(MetricTimer::Count);
+
+struct TimerStats {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+// 某一时刻全部指标的拷贝
+struct MetricsSnapshot {
+    bool enabled = MNIST_METRICS != 0;
+    std::array<uint64_t, metric_counter_count> counters{};
+    std::array<TimerStats, metric_timer_count> timers{};
+
+    uint64_t counter(MetricCounter c) const { return counters[static_cast<int>(c)]; }
+    const TimerStats& timer(MetricTimer t) const { return timers[static_cast<int>(t)]; }
+};
+
+// 指标名（snake_case），导出时使用
+const char* metric_name(MetricCounter counter);
+const char* metric_name(MetricTimer timer);
+
+MetricsSnapshot metrics_snapshot();
+void metrics_reset();
+
+// JSON对象：{"enabled":..., "counters":{...}, "timers":{名称:{count,total_ms,max_ms}}}
+std::string metrics_json(const MetricsSnapshot& snapshot);
+// Prometheus文本格式：计数器为mnist_<名称>_total，计时器为mnist_<名称>_seconds_total/_count/_max
+std::string metrics_prometheus(const MetricsSnapshot& snapshot);
+// 先写临时文件再重命名，供node_exporter的textfile收集器读取；失败时抛出std::runtime_error
+void write_metrics_file(const std::string& path, const std::string& text);
+
+#if MNIST_METRICS
+
+namespace metrics_detail {
+void add(MetricCounter counter, uint64_t n);
+void record(MetricTimer timer, uint64_t ns);
+} // namespace metrics_detail
+
+inline void metrics_add(MetricCounter counter, uint64_t n = 1) {
+    metrics_detail::add(counter, n);
+}
+
+inline void metrics_record(MetricTimer timer, std::chrono::nanoseconds elapsed) {
+    metrics_detail::record(timer, static_cast<uint64_t>(elapsed.count()));
+}
+
+// 作用域计时器：析构（或提前调用stop）时记录一次
+class ScopedTimer {
+public:
+    explicit ScopedTimer(MetricTimer timer) : timer(timer), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() { stop(); }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    void stop() {
+        if (running) {
+            running = false;
+            metrics_record(timer, std::chrono::steady_clock::now() - start);
+        }
+    }
+
+private:
+    MetricTimer timer;
+    std::chrono::steady_clock::time_point start;
+    bool running = true;
+};
+
+#else
+
+inline void metrics_add(MetricCounter, uint64_t = 1) {}
+inline void metrics_record(MetricTimer, std::chrono::nanoseconds) {}
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(MetricTimer) {}
+    void stop() {}
+};
+
+#endif // MNIST_METRICS
+
+#endif // METRICS_H
@@ -0,0 +1,144 @@
+#ifndef MLP_H
+#define MLP_H
+
+#include <Eigen/Dense>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mnist_loader.h"
+
+// 参数在arena中的布局：各层的W(in x out，行优先)与b(out)依次排列，每段起点按64字节对齐
+// 参数、梯度与优化器状态都使用同一布局，可以整体当作一维数组更新
+struct MlpLayout {
+    std::vector<int> sizes;                   // 输入、各隐藏层与输出的大小，如{784, 100, 10}
+    std::vector<Eigen::Index> weight_offsets; // 第l层W在arena中的起点
+    std::vector<Eigen::Index> bias_offsets;   // 第l层b在arena中的起点
+    Eigen::Index total = 0;                   // arena的长度（float个数，含对齐填充）
+
+    MlpLayout() = default;
+    explicit MlpLayout(const std::vector<int>& sizes);
+
+    // Affine层数
+    int num_layers() const { return static_cast<int>(sizes.size()) - 1; }
+    // 最宽的一层输出
+    int max_width() const;
+
+    // 在任意同布局的arena上取第l层的W与b
+    Eigen::Map<RowMatrixXf, Eigen::Aligned64> weight(float* arena, int l) const;
+    Eigen::Map<const RowMatrixXf, Eigen::Aligned64> weight(const float* arena, int l) const;
+    Eigen::Map<Eigen::RowVectorXf, Eigen::Aligned64> bias(float* arena, int l) const;
+    Eigen::Map<const Eigen::RowVectorXf, Eigen::Aligned64> bias(const float* arena, int l) const;
+};
+
+// 前向与反向需要的全部缓冲区，按max_batch一次性分配，之后每一步都不再分配内存
+// （Eigen矩阵乘法的分块缓冲区放在栈上，上限由EIGEN_STACK_ALLOCATION_LIMIT决定）
+struct MlpWorkspace {
+    int max_batch = 0;
+    Eigen::VectorXf activations;                // 各层输出（隐藏层为ReLU之后），第l层为max_batch x sizes[l+1]
+    std::vector<Eigen::Index> output_offsets;
+    Eigen::VectorXf deltas;                     // 反向传播时交替使用的两块误差缓冲区
+    Eigen::Index delta_stride = 0;
+    Eigen::VectorXf gradients;                  // 与参数同布局
+
+    MlpWorkspace() = default;
+    MlpWorkspace(const MlpLayout& layout, int max_batch);
+};
+
+// 多层感知机：Affine -> ReLU -> ... -> Affine -> SoftmaxWithLoss
+class Mlp {
+public:
+    Mlp() = default;
+    // layer_sizes依次为输入、各隐藏层与输出的大小；权重按He初始化，偏置为0
+    explicit Mlp(const std::vector<int>& layer_sizes, uint64_t seed = 42);
+    // 只读模型：参数直接引用mapping中按MlpLayout排列、64字节对齐的params，不拷贝（见checkpoint.h的map_checkpoint）
+    Mlp(const std::vector<int>& layer_sizes, std::shared_ptr<const MappedFile> mapping, const float* params);
+
+    const MlpLayout& layout() const { return shape; }
+    int input_size() const { return shape.sizes.front(); }
+    int output_size() const { return shape.sizes.back(); }
+
+    // 整个参数arena；映射的模型没有自己的arena，两者都为空，参数经parameter_data访问
+    Eigen::VectorXf& parameters() { return params; }
+    const Eigen::VectorXf& parameters() const { return params; }
+    // 参数arena的起始地址，映射的模型指向映射内存
+    const float* parameter_data() const { return mapped_params ? mapped_params : params.data(); }
+    // 参数是否引用映射的检查点；映射的模型不能训练
+    bool is_mapped() const { return mapped_params != nullptr; }
+
+    // 前向计算x（count x input_size，行优先）的输出（未经softmax），结果保存在workspace中
+    Eigen::Map<const RowMatrixXf> forward(const float* x, int count, MlpWorkspace& workspace) const;
+    // 前向与反向：返回平均交叉熵误差，梯度写入workspace.gradients；标签不在[0, output_size)内时抛出std::runtime_error
+    float forward_backward(const float* x, const int* labels, int count, MlpWorkspace& workspace) const;
+    // 预测count个样本的类别
+    void predict(const float* x, int count, int* out_labels, MlpWorkspace& workspace) const;
+
+private:
+    MlpLayout shape;
+    Eigen::VectorXf params;
+    std::shared_ptr<const MappedFile> mapping; // 映射的模型持有映射
+    const float* mapped_params = nullptr;
+};
+
+// 优化器
+enum class OptimizerKind { SGD, Momentum, Adam };
+
+// 由名称（sgd、momentum、adam）解析优化器，无法识别时抛出std::runtime_error
+OptimizerKind parse_optimizer(const std::string& name);
+const char* optimizer_name(OptimizerKind kind);
+
+struct OptimizerConfig {
+    OptimizerKind kind = OptimizerKind::SGD;
+    float learning_rate = 0.0f; // 不大于0时使用该优化器的默认值（SGD为0.1，Momentum为0.01，Adam为0.001）
+    float momentum = 0.9f;
+    float beta1 = 0.9f;
+    float beta2 = 0.999f;
+    float epsilon = 1e-8f;
+};
+
+// 在一维arena上整体更新参数；状态（Momentum的速度，Adam的一阶与二阶矩）在构造时一次性分配
+class Optimizer {
+public:
+    Optimizer(const OptimizerConfig& config, Eigen::Index size);
+
+    void step(Eigen::VectorXf& params, const Eigen::VectorXf& grads);
+
+    const OptimizerConfig& config() const { return cfg; }
+    int64_t steps() const { return step_count; }
+    // 恢复检查点时设置已执行的步数（Adam的偏差修正依赖步数）
+    void set_steps(int64_t steps) { step_count = steps; }
+    // 优化器状态：SGD为空，Momentum为v，Adam为m与v依次排列
+    Eigen::VectorXf& state() { return state_arena; }
+    const Eigen::VectorXf& state() const { return state_arena; }
+
+private:
+    OptimizerConfig cfg;
+    Eigen::Index size;
+    Eigen::VectorXf state_arena;
+    int64_t step_count = 0;
+};
+
+// 单线程训练器：消费MnistBatchLoader的批次，每一步不分配内存
+class MlpTrainer {
+public:
+    MlpTrainer(Mlp& model, const OptimizerConfig& config, int batch_size);
+
+    // 对一个批次做一次前向、反向与参数更新，返回该批次的平均损失；图像宽度与模型输入维度不符时抛出std::runtime_error
+    float train_step(const MnistBatch& batch);
+    // 取完loader本轮的全部训练批次后调用reset，返回本轮的平均损失
+    float train_epoch(MnistBatchLoader& loader);
+    // split上的分类准确率（单线程的MnistEvaluator）；图像大小与模型输入维度不符或标签超出类别数时抛出std::runtime_error
+    float evaluate(const MnistData& data, MnistSplit split);
+
+    Optimizer& optimizer() { return opt; }
+    int64_t samples_seen() const { return samples; }
+
+private:
+    Mlp& model;
+    Optimizer opt;
+    MlpWorkspace workspace;
+    MnistBatch buffer;
+    int64_t samples = 0;
+};
+
+#endif // MLP_H
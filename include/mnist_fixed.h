@@ -0,0 +1,194 @@
+#ifndef MNIST_FIXED_H
+#define MNIST_FIXED_H
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "metrics.h"
+#include "mnist_loader.h"
+
+// 编译期固定几何的数据集、批次与热点内核。
+// MnistData与MnistBatchLoader的行列数、类别数都在运行时决定，Eigen只能用动态大小的类型；
+// 几何已知时（MNIST恒为28x28、10类）以MnistShape为模板参数，每行784个元素与10个类别都成为编译期常量，
+// Eigen选用固定大小的内层维度，按类别的循环在编译期完全展开。
+// 动态几何的MnistData/MnistBatchLoader保持不变，其它尺寸的数据集继续使用；两条路径的结果逐位相同。
+
+// 图像Rows x Cols、Classes个类别、每批BatchSize个样本
+template <int Rows, int Cols, int Classes, int BatchSize>
+struct MnistShape {
+    static_assert(Rows > 0 && Cols > 0 && Rows * Cols > 1, "an image needs at least two pixels");
+    static_assert(Classes > 1 && BatchSize > 0, "need at least two classes and one sample per batch");
+
+    static constexpr int rows = Rows;
+    static constexpr int cols = Cols;
+    static constexpr int features = Rows * Cols;
+    static constexpr int classes = Classes;
+    static constexpr int batch_size = BatchSize;
+};
+
+// MNIST与Fashion-MNIST：28x28，10类，批大小100
+using Mnist28Shape = MnistShape<28, 28, 10, 100>;
+
+// 固定大小的批次缓冲区，只有前count行有效。
+// 图像矩阵内嵌在对象中（28x28、批大小100时约314 KB），应在堆上创建（std::make_unique）
+template <typename Shape>
+struct FixedMnistBatch {
+    using Images = Eigen::Matrix<float, Shape::batch_size, Shape::features, Eigen::RowMajor>;
+    using Labels = Eigen::Matrix<int, Shape::batch_size, 1>;
+
+    Images images;
+    Labels labels;
+    int count = 0;
+};
+
+// 按Shape解释的MnistData（不拷贝数据）；图像按固定行宽的矩阵访问
+template <typename Shape>
+class FixedMnistData {
+public:
+    using ImageMap = Eigen::Map<const Eigen::Matrix<float, Eigen::Dynamic, Shape::features, Eigen::RowMajor>>;
+    using PixelMap = Eigen::Map<const Eigen::Matrix<uint8_t, Eigen::Dynamic, Shape::features, Eigen::RowMajor>>;
+
+    // 图像尺寸与Shape不符或有标签超出类别数时抛出std::runtime_error；data须在本对象的生命周期内有效
+    explicit FixedMnistData(const MnistData& data) : data(data) {
+        if (data.rows != Shape::rows || data.cols != Shape::cols) {
+            throw std::runtime_error("Dataset images are " + std::to_string(data.rows) + "x" + std::to_string(data.cols) +
+                                     ", expected " + std::to_string(Shape::rows) + "x" + std::to_string(Shape::cols));
+        }
+        if (!labels_fit(data.train_labels) || !labels_fit(data.test_labels)) {
+            throw std::runtime_error("Dataset labels exceed " + std::to_string(Shape::classes) + " classes");
+        }
+    }
+
+    // 是否可以按Shape解释data；不能时使用动态几何的MnistBatchLoader
+    static bool matches(const MnistData& data) {
+        return data.rows == Shape::rows && data.cols == Shape::cols && labels_fit(data.train_labels) &&
+               labels_fit(data.test_labels);
+    }
+
+    const MnistData& dynamic() const { return data; }
+    int count(MnistSplit split) const { return split == MnistSplit::Train ? data.train_count : data.test_count; }
+    const Eigen::VectorXi& labels(MnistSplit split) const {
+        return split == MnistSplit::Train ? data.train_labels : data.test_labels;
+    }
+    // Float存储
+    ImageMap images(MnistSplit split) const { return ImageMap(data.image_data(split), count(split), Shape::features); }
+    // Uint8存储
+    PixelMap pixels(MnistSplit split) const { return PixelMap(data.pixel_data(split), count(split), Shape::features); }
+
+private:
+    static bool labels_fit(const Eigen::VectorXi& labels) {
+        return labels.size() == 0 || (labels.minCoeff() >= 0 && labels.maxCoeff() < Shape::classes);
+    }
+
+    const MnistData& data;
+};
+
+// MnistBatchLoader的固定几何版本：批次顺序、打乱的排列与内容都与同一批大小的MnistBatchLoader逐位相同，
+// 稳态下不分配内存。收集图像仍用按CPU分派的SIMD内核（gather_rows_f32等）：逐行拷贝受内存带宽限制，
+// 固定行宽的Eigen拷贝只能用编译期的基线指令集，反而更慢；固定大小的收益在下游的批次类型上
+template <typename Shape>
+class FixedMnistLoader {
+public:
+    explicit FixedMnistLoader(const FixedMnistData<Shape>& data) : data(data) {}
+
+    // 启用按轮打乱，从第0轮重新开始；排列与MnistBatchLoader::enable_shuffle相同
+    void enable_shuffle(uint64_t seed) {
+        shuffle = true;
+        shuffle_seed = shard_shuffle_seed(data.dynamic(), seed);
+        epoch_index = 0;
+        train_order.resize(data.count(MnistSplit::Train));
+        shuffle_order(train_order.data(), data.count(MnistSplit::Train), shuffle_seed, epoch_index);
+        train_index = 0;
+        test_index = 0;
+    }
+
+    bool next_train_batch(FixedMnistBatch<Shape>& batch) { return next_batch(MnistSplit::Train, batch); }
+    bool next_test_batch(FixedMnistBatch<Shape>& batch) { return next_batch(MnistSplit::Test, batch); }
+
+    // 重置批次索引；启用打乱时进入下一轮并重新打乱
+    void reset() {
+        train_index = 0;
+        test_index = 0;
+        ++epoch_index;
+        if (shuffle) {
+            shuffle_order(train_order.data(), data.count(MnistSplit::Train), shuffle_seed, epoch_index);
+        }
+    }
+
+    uint64_t epoch() const { return epoch_index; }
+
+private:
+    bool next_batch(MnistSplit split, FixedMnistBatch<Shape>& batch) {
+        const bool train = split == MnistSplit::Train;
+        int& index = train ? train_index : test_index;
+        const int total = data.count(split);
+        if (index >= total) {
+            return false;
+        }
+        const int count = std::min(Shape::batch_size, total - index);
+        if (train && shuffle) {
+            gather_batch(data.dynamic(), split, train_order.data() + index, count, batch.images.data(),
+                         batch.labels.data());
+        } else {
+            copy_images(data.dynamic(), split, index, count, batch.images.data());
+            batch.labels.head(count) = data.labels(split).segment(index, count);
+        }
+        batch.count = count;
+        metrics_add(MetricCounter::BatchesServed);
+        metrics_add(MetricCounter::SamplesServed, static_cast<uint64_t>(count));
+        index += count;
+        return true;
+    }
+
+    const FixedMnistData<Shape>& data;
+    int train_index = 0;
+    int test_index = 0;
+    bool shuffle = false;
+    uint64_t shuffle_seed = 0;
+    uint64_t epoch_index = 0;
+    std::vector<int> train_order;
+};
+
+// Math::softmax_cross_entropy的固定类别数版本（logits与grad为count x Classes的连续行优先数组，可为同一块内存）。
+// 运算与求和顺序相同，损失与梯度逐位一致；按类别的三重循环在编译期展开，exp仍整块向量化
+template <int Classes>
+float fixed_softmax_cross_entropy(const float* logits, const int* labels, int count, float* grad) {
+    float loss = 0.0f;
+    for (int i = 0; i < count; ++i) {
+        const float* x = logits + static_cast<Eigen::Index>(i) * Classes;
+        float* g = grad + static_cast<Eigen::Index>(i) * Classes;
+        float max_logit = x[0];
+        for (int j = 1; j < Classes; ++j) {
+            max_logit = x[j] > max_logit ? x[j] : max_logit;
+        }
+        loss += max_logit - x[labels[i]];
+        for (int j = 0; j < Classes; ++j) {
+            g[j] = x[j] - max_logit;
+        }
+    }
+
+    Eigen::Map<Eigen::ArrayXf> flat(grad, static_cast<Eigen::Index>(count) * Classes);
+    flat = flat.exp();
+
+    const float inv_batch = 1.0f / static_cast<float>(count);
+    for (int i = 0; i < count; ++i) {
+        float* g = grad + static_cast<Eigen::Index>(i) * Classes;
+        float sum = 0.0f;
+        for (int j = 0; j < Classes; ++j) {
+            sum += g[j];
+        }
+        loss += std::log(sum);
+        const float scale = inv_batch / sum;
+        for (int j = 0; j < Classes; ++j) {
+            g[j] *= scale;
+        }
+        g[labels[i]] -= inv_batch;
+    }
+    return loss * inv_batch;
+}
+
+#endif // MNIST_FIXED_H
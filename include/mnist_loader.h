@@ -2,46 +2,222 @@
 #define MNIST_LOADER_H
 
 #include <Eigen/Dense>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
+#include "idx_file.h"
 
 // 若本地不存在数据集则下载并解压，force_download参数可强制重新下载
-void init_mnist(const std::string& root = "./data", bool force_download = false);
+// decompress为false时只保证.gz文件存在，不在磁盘上生成解压后的IDX文件
+void init_mnist(const std::string& root = "./data", bool force_download = false, bool decompress = true);
 
-// MNIST数据集结构
+// 初始化选项
+struct MnistInitOptions {
+    bool force_download = false;        // 删除已有文件（包括未完成的.part）后重新下载
+    bool decompress = true;             // 是否在磁盘上生成解压后的IDX文件
+    std::vector<std::string> base_urls; // 镜像地址（以/结尾，可为file://本地镜像），为空时使用内置的Google/AWS镜像
+    int max_parallel = 4;               // 同时下载的文件数
+    int max_rounds = 2;                 // 每个镜像允许的无进展失败次数，中断时续传，无进展时轮换到下一个镜像
+    long long abort_after_bytes = 0;    // 测试用：每次传输收到这么多字节后中止（0为关闭）
+    bool use_manifest = true;           // 清单与磁盘一致时跳过全部检查；检查通过后写入清单（见mnist_manifest.h）
+};
+
+// 缺失的.gz文件通过curl multi并行下载，中断的下载保留为.part文件，下次从断点续传
+void init_mnist(const std::string& root, const MnistInitOptions& options);
+
+// 图像矩阵一律行优先：每张图像占一段连续内存，一个批次即一段连续区间
+// 构建时定义EIGEN_MAX_ALIGN_BYTES=64，使矩阵按64字节（缓存行）对齐；784个float恰为49个缓存行，每行同样对齐
+static_assert(EIGEN_MAX_ALIGN_BYTES >= 64, "mnist_cpp must be built with -DEIGEN_MAX_ALIGN_BYTES=64");
+
+// 行优先的float图像矩阵
+using RowMatrixXf = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+// 行优先的uint8像素矩阵，内存布局与IDX文件一致
+using MatrixXu8 = Eigen::Matrix<uint8_t, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// 图像的存储方式
+enum class MnistStorage {
+    Float, // 加载时转换为float，存放在train_images/test_images中（默认）
+    Uint8  // 保留原始字节，存放在train_pixels/test_pixels中，取批次时才转换为float，内存占用为Float的1/4
+};
+
+// 数据来源
+enum class MnistSource {
+    Idx,  // 读取解压后的IDX文件（默认，mmap）
+    Gzip  // 直接在内存中流式解压.gz文件，四个文件并行解码，磁盘上不生成解压文件
+};
+
+// 加载选项
+struct MnistLoadOptions {
+    bool normalize = true;                      // uint8像素是否缩放到[0, 1]，其它元素类型按原值转换为float
+    MnistStorage storage = MnistStorage::Float; // 图像存储方式（Uint8要求文件为uint8）
+    MnistSource source = MnistSource::Idx;      // 数据来源
+    bool use_snapshot = false;                  // 启用快照：存在且匹配时直接加载，否则正常加载后写入快照
+    std::string snapshot_path;                  // 快照路径，为空时使用default_snapshot_path
+
+    // 分片：world_size大于1时只读取并保存训练集中属于本进程的连续一段（各分片样本数至多相差1），
+    // 多个进程的分片互不相交且合起来恰为完整数据集。分片加载可以使用已有的完整快照（零拷贝切片），但不会写入快照
+    int rank = 0;                               // 本进程的分片序号，0 <= rank < world_size
+    int world_size = 1;                         // 分片数
+    bool shard_test = false;                    // 测试集是否同样分片（默认每个进程保留完整测试集用于评估）
+};
+
+// 数据集划分
+enum class MnistSplit { Train, Test };
+
+// MNIST数据集结构（以MNIST为例；图像尺寸取自文件头，Fashion-MNIST、EMNIST等同格式数据集同样适用）
 struct MnistData {
-    Eigen::MatrixXf train_images; // 60000 x 784 (28*28)
+    RowMatrixXf train_images;     // 60000 x 784 (28*28)，仅Float存储时有效
     Eigen::VectorXi train_labels; // 60000
-    Eigen::MatrixXf test_images;  // 10000 x 784 (28*28)
+    RowMatrixXf test_images;      // 10000 x 784 (28*28)，仅Float存储时有效
     Eigen::VectorXi test_labels;  // 10000
-    
+
+    MatrixXu8 train_pixels;       // 60000 x 784，仅Uint8存储时有效
+    MatrixXu8 test_pixels;        // 10000 x 784，仅Uint8存储时有效
+
     int train_count = 0;
     int test_count = 0;
-    int rows = 28;
-    int cols = 28;
+    int rows = 28;                // 三维文件为第二维；二维文件（count x features）为1
+    int cols = 28;                // 其余各维度之积
+    MnistStorage storage = MnistStorage::Float;
+    bool normalize = true;        // 图像（或批次输出）是否已缩放到[0, 1]
+
+    // 分片信息：本地第i个样本是完整数据集中的第offset + i个
+    int shard_rank = 0;
+    int shard_world_size = 1;
+    int train_offset = 0;
+    int test_offset = 0;
+
+    // 从快照零拷贝加载时，图像直接指向映射的快照，上面的图像矩阵为空（标签仍在train_labels/test_labels中）
+    std::shared_ptr<const MappedFile> snapshot;
+    const void* snapshot_images[2] = {nullptr, nullptr};
+
+    // 图像数据的起始地址，不论保存在矩阵中还是映射的快照中；按storage选用
+    const float* image_data(MnistSplit split) const;   // Float存储
+    const uint8_t* pixel_data(MnistSplit split) const; // Uint8存储
+};
+
+// 内存映射的MNIST原始文件，像素与标签以零拷贝只读区间的形式直接访问
+struct MnistMapped {
+    IdxFile train_images;
+    IdxFile train_labels;
+    IdxFile test_images;
+    IdxFile test_labels;
 };
 
+// 映射root目录下已解压的四个IDX文件并校验头部（不会触发下载）
+// 图像可为任意元素类型，count x rows x cols（更高维时其余维度并入cols）或count x features；
+// 标签为一维整数；两个划分的图像尺寸须一致
+MnistMapped map_mnist(const std::string& root = "./data");
+
 // 加载MNIST数据集
 MnistData load_mnist(const std::string& root = "./data", bool normalize = true);
+MnistData load_mnist(const std::string& root, const MnistLoadOptions& options);
+
+// 从已映射的文件直接填充MnistData
+MnistData load_mnist(const MnistMapped& mapped, bool normalize = true);
+MnistData load_mnist(const MnistMapped& mapped, const MnistLoadOptions& options);
+
+// 直接从root目录下的四个.gz文件流式解码（不会触发下载，忽略options.source）
+MnistData load_mnist_gz(const std::string& root, const MnistLoadOptions& options);
+
+// 把split中从start开始的count张图像以float写入out（行优先，count x rows*cols）
+// Float存储为连续拷贝，Uint8存储按normalize即时转换
+void copy_images(const MnistData& data, MnistSplit split, int start, int count, float* out);
+
+// 按indices逐行收集count张图像与标签，写入out_images（行优先）和out_labels
+void gather_batch(const MnistData& data, MnistSplit split, const int* indices, int count,
+                  float* out_images, int* out_labels);
+
+// SplitMix64：推进state并返回下一个64位随机数，各平台结果一致。
+// 打乱排列与数据增强的逐样本种子都由它派生，两者须使用同一实现
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// 生成第epoch轮的样本排列：order[0..n)为0..n-1的一个排列，只取决于seed与epoch
+// 使用自带的Fisher-Yates与SplitMix64，不依赖std::shuffle，跨平台结果一致；不分配内存
+void shuffle_order(int* order, int n, uint64_t seed, uint64_t epoch);
+
+// 分片[begin, end)：n个样本分成world_size段时第rank段的范围
+struct ShardRange {
+    int begin = 0;
+    int end = 0;
+    int count() const { return end - begin; }
+};
+ShardRange shard_range(int n, int rank, int world_size);
+
+// 类别数：训练集与测试集标签的最大值加一（至少为1）；有负标签时抛出std::runtime_error。
+// 加载器接受任意整数标签（EMNIST等），模型的输出层应按此确定大小
+int mnist_num_classes(const MnistData& data);
+
+// 加载器打乱data时实际使用的种子：未分片时即seed；分片时混入rank，各分片在同一轮使用互不相关的排列
+uint64_t shard_shuffle_seed(const MnistData& data, uint64_t seed);
+
+// 预分配的批次缓冲区：images/labels按batch_size分配，只有前count行有效
+struct MnistBatch {
+    RowMatrixXf images;     // batch_size x 784
+    Eigen::VectorXi labels; // batch_size
+    int count = 0;
+
+    // 有效部分的视图
+    RowMatrixXf::ConstRowsBlockXpr x() const { return images.topRows(count); }
+    Eigen::VectorXi::ConstSegmentReturnType y() const { return labels.head(count); }
+};
+
+// 批次的零拷贝视图，直接指向MnistData中的连续存储
+struct MnistBatchView {
+    Eigen::Map<const RowMatrixXf> x{nullptr, 0, 0};
+    Eigen::Map<const Eigen::VectorXi> y{nullptr, 0};
+};
 
 // 批处理加载器
+// 默认按文件顺序遍历；enable_shuffle后每轮训练数据按种子生成的排列打乱，测试数据始终按顺序
 class MnistBatchLoader {
 public:
     MnistBatchLoader(const MnistData& data, int batch_size);
+
+    // 启用按轮打乱，从第0轮重新开始；排列只取决于seed与轮次（分片数据另取决于rank，见shard_shuffle_seed）
+    void enable_shuffle(uint64_t seed);
     
-    // 获取下一批训练数据
+    // 获取下一批训练数据（行优先输出为整段连续拷贝，推荐使用）
+    bool next_train_batch(RowMatrixXf& batch_x, Eigen::VectorXi& batch_y);
+    // 列优先输出，兼容旧接口，需要额外一次转置拷贝
     bool next_train_batch(Eigen::MatrixXf& batch_x, Eigen::VectorXi& batch_y);
     
     // 获取下一批测试数据
+    bool next_test_batch(RowMatrixXf& batch_x, Eigen::VectorXi& batch_y);
     bool next_test_batch(Eigen::MatrixXf& batch_x, Eigen::VectorXi& batch_y);
+
+    // 收集到调用者预分配的缓冲区中（容量不足时只在第一次扩容），稳态下不分配内存
+    bool next_train_batch(MnistBatch& batch);
+    bool next_test_batch(MnistBatch& batch);
+
+    // 无需收集时（Float存储且未打乱）直接返回存储的视图；否则抛出std::logic_error
+    bool next_train_view(MnistBatchView& view);
+    bool next_test_view(MnistBatchView& view);
     
-    // 重置批次索引
+    // 重置批次索引；启用打乱时进入下一轮并重新打乱
     void reset();
+
+    uint64_t epoch() const { return epoch_index; }
     
 private:
+    bool next_batch(MnistSplit split, MnistBatch& batch);
+    bool next_view(MnistSplit split, MnistBatchView& view);
+
     const MnistData& data;
     int batch_size;
     int train_index;
     int test_index;
+    RowMatrixXf staging_batch; // 列优先输出时的中转缓冲区
+    bool shuffle = false;
+    uint64_t shuffle_seed = 0;
+    uint64_t epoch_index = 0;
+    std::vector<int> train_order; // 打乱时本轮训练数据的排列
 };
 
 #endif // MNIST_LOADER_H
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef MNIST_MANIFEST_H
+#define MNIST_MANIFEST_H
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <vector>
+
+// 数据集清单：init_mnist成功后在root下写入mnist.manifest，记录每个文件的大小、修改时间（纳秒）与CRC32。
+// 之后的启动只读一次清单，并对所需文件各stat一次比对大小与修改时间，一致即跳过magic校验、解压与下载，
+// 不打开任何数据文件。内容的完整校验（重新计算哈希）由调用者选择在后台进行。
+//
+// 文件格式（文本）：
+//   mnist-manifest 1
+//   <文件名> <大小> <修改时间ns> <crc32十六进制>
+constexpr unsigned MNIST_MANIFEST_VERSION = 1;
+
+struct ManifestEntry {
+    std::string name;    // 相对root的文件名
+    uint64_t size = 0;
+    int64_t mtime_ns = 0;
+    uint32_t crc = 0;
+};
+
+std::string mnist_manifest_path(const std::string& root);
+
+// 一次stat取得文件大小与修改时间（纳秒）；文件不存在时返回false
+bool stat_file(const std::string& path, uint64_t& size, int64_t& mtime_ns);
+
+// 读取清单；不存在或格式不符时返回false
+bool read_mnist_manifest(const std::string& root, std::vector<ManifestEntry>& entries);
+
+// 计算names中各文件的大小、修改时间与CRC32并写入清单（先写临时文件再rename），失败时抛出std::runtime_error
+void write_mnist_manifest(const std::string& root, const std::vector<std::string>& names);
+
+// 清单存在、包含names中的每个文件，且各文件的大小与修改时间与清单一致（只stat，不打开数据文件）
+bool mnist_manifest_current(const std::string& root, const std::vector<std::string>& names);
+
+// 重新计算清单中各文件的CRC32并比对；全部一致返回true。
+// 不一致时删除出错的文件与清单并返回false，下次init_mnist会从.gz重新解压或重新下载
+bool verify_mnist_manifest(const std::string& root);
+
+// 在后台线程中执行verify_mnist_manifest；future析构时等待校验结束。
+// 校验可能删除文件，应在数据加载完成后再启动，不能与同一root上的init_mnist或load_mnist并发
+std::future<bool> verify_mnist_manifest_async(const std::string& root);
+
+#endif // MNIST_MANIFEST_H
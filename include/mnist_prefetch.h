@@ -0,0 +1,80 @@
+#ifndef MNIST_PREFETCH_H
+#define MNIST_PREFETCH_H
+
+#include <Eigen/Dense>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "augment.h"
+#include "mnist_loader.h"
+
+// 异步预取的批处理加载器
+// 后台工作线程把批次提前写入一个固定大小的环形缓冲区（depth个预分配的MnistBatch），
+// 消费者取批次时与环中的槽位交换缓冲区，既没有拷贝也没有内存分配。
+// next_batch与reset只能由同一个消费者线程调用。
+// 可选的增强阶段在工作线程上逐样本执行，增加num_workers即可提高增强吞吐量。
+class MnistPrefetchLoader {
+public:
+    MnistPrefetchLoader(const MnistData& data, int batch_size, MnistSplit split = MnistSplit::Train,
+                        int depth = 4, int num_workers = 1);
+    ~MnistPrefetchLoader();
+
+    MnistPrefetchLoader(const MnistPrefetchLoader&) = delete;
+    MnistPrefetchLoader& operator=(const MnistPrefetchLoader&) = delete;
+
+    // 取出下一批数据；本轮数据取完时返回false
+    bool next_batch(MnistBatch& batch);
+
+    // 丢弃已预取的批次，从头开始新的一轮；启用打乱时按新一轮的排列重新打乱
+    void reset();
+
+    // 启用按轮打乱（排列与MnistBatchLoader相同），并从第0轮重新开始
+    void enable_shuffle(uint64_t seed);
+
+    // 启用增强：每个样本取出后由工作线程调用fn，种子为augment_sample_seed(seed, 轮次, 样本在完整数据集中的编号)，
+    // 同一seed下各轮的结果与工作线程数无关；fn为空时关闭。丢弃已预取的批次，从当前轮的开头重新开始
+    void set_augment(AugmentFn fn, uint64_t seed);
+
+    int num_batches() const { return batch_count; }
+
+private:
+    struct Slot {
+        MnistBatch batch;
+        int64_t ready_seq = -1; // 槽位中已就绪批次的序号，-1表示空
+    };
+
+    void worker_loop();
+    void fill(MnistBatch& batch, int64_t seq, std::vector<float>& scratch) const;
+    // 作废在途的填充并等待其结束；调用时须持有mutex
+    void quiesce(std::unique_lock<std::mutex>& lock);
+    // 按当前轮次重新打乱并从头开始；调用时须持有mutex且没有在途的填充
+    void rewind();
+
+    const MnistData& data;
+    MnistSplit split;
+    int batch_size;
+    int sample_count;
+    int batch_count;
+    std::vector<Slot> slots;
+    bool shuffle = false;
+    uint64_t shuffle_seed = 0;
+    uint64_t epoch = 0;
+    std::vector<int> order;           // 打乱时本轮的样本排列
+    AugmentFn augment;
+    uint64_t augment_seed = 0;
+
+    std::mutex mutex;
+    std::condition_variable work_cv;  // 有可领取的批次，或需要停止
+    std::condition_variable ready_cv; // 有批次就绪
+    std::condition_variable idle_cv;  // 没有正在填充的批次
+    int64_t next_claim = 0;           // 下一个待领取的批次序号
+    int64_t consume_seq = 0;          // 消费者下一个要取的批次序号
+    uint64_t generation = 0;          // 每次reset加一，使旧一轮的填充结果作废
+    int active_fills = 0;
+    bool stopping = false;
+    std::vector<std::thread> workers;
+};
+
+#endif // MNIST_PREFETCH_H
@@ -0,0 +1,47 @@
+#ifndef MNIST_SNAPSHOT_H
+#define MNIST_SNAPSHOT_H
+
+#include <cstdint>
+#include <string>
+#include "mnist_loader.h"
+
+// 数据集快照：单个文件保存两个划分在内存中的最终形式（归一化后的float或原始uint8，标签为int32），
+// 各数组按64字节对齐，头部记录版本、维度、存储方式、归一化方式与校验和。
+// 热启动时mmap快照，图像直接引用映射内存（多个进程共享同一份页缓存），
+// 跳过init_mnist、IDX解析与逐像素转换，只拷贝很小的标签数组。
+// 头部还记录写入时四个源文件（IDX文件或.gz归档）的大小与修改时间，源文件改变后快照不再被使用。
+//
+// 文件布局（本机字节序，头部记录字节序标记，不匹配时拒绝加载）：
+//   [MnistSnapshotHeader][padding][train images][train labels][test images][test labels]
+constexpr unsigned MNIST_SNAPSHOT_VERSION = 2;
+
+// 快照所依据的四个源文件（训练图像、训练标签、测试图像、测试标签）的大小与修改时间（纳秒），缺失的文件记为0
+struct MnistSourceStamp {
+    uint64_t sizes[4] = {};
+    int64_t mtimes_ns[4] = {};
+
+    bool operator==(const MnistSourceStamp& other) const;
+};
+
+// root下source对应的源文件（Idx为解压后的IDX文件，Gzip为.gz归档）的大小与修改时间，每个文件stat一次
+MnistSourceStamp mnist_source_stamp(const std::string& root, MnistSource source);
+
+// 写入快照；先写临时文件再rename，其他进程不会读到写了一半的快照；分片数据抛出std::runtime_error。
+// sources记录在头部，供load_current_mnist_snapshot判断快照是否过期
+void save_mnist_snapshot(const MnistData& data, const std::string& path,
+                         const MnistSourceStamp& sources = MnistSourceStamp());
+
+// 读取快照；文件不存在、格式或版本不符、头部校验失败时抛出std::runtime_error
+// 返回的MnistData通过snapshot持有映射，图像经image_data/pixel_data访问，图像矩阵为空
+// verify_checksum为true时额外校验全部数据的CRC32（需要完整读一遍数据）
+MnistData load_mnist_snapshot(const std::string& path, bool verify_checksum = false);
+
+// 快照存在、与给定的存储方式和归一化方式一致、且记录的源文件与sources相同时，加载到out并返回true；
+// 否则（包括格式错误）返回false。快照只映射一次，检查头部与加载共用同一个映射
+bool load_current_mnist_snapshot(const std::string& path, const MnistLoadOptions& options,
+                                 const MnistSourceStamp& sources, MnistData& out);
+
+// load_mnist使用的默认快照路径，按存储方式与归一化方式区分
+std::string default_snapshot_path(const std::string& root, const MnistLoadOptions& options);
+
+#endif // MNIST_SNAPSHOT_H
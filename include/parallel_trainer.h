@@ -0,0 +1,60 @@
+#ifndef PARALLEL_TRAINER_H
+#define PARALLEL_TRAINER_H
+
+#include <cstdint>
+#include <vector>
+#include "evaluator.h"
+#include "mlp.h"
+#include "mnist_loader.h"
+#include "thread_team.h"
+
+// 数据并行训练器
+// 每个批次按行平均切成num_threads段，各线程直接从MnistData收集自己那一段，在线程私有的
+// workspace中算出梯度；随后把参数arena切成num_threads块，每个线程按固定的二叉树顺序
+// 归约自己那一块。归约顺序只取决于线程数，因此同样的线程数每次运行结果逐位相同；
+// num_threads为1时与MlpTrainer配合打乱的MnistBatchLoader的结果逐位相同。
+class DataParallelTrainer {
+public:
+    // 模型输入维度与图像大小不符、或训练标签超出模型的类别数时抛出std::runtime_error
+    DataParallelTrainer(Mlp& model, const MnistData& data, const OptimizerConfig& config,
+                        int batch_size, int num_threads);
+
+    // 启用按轮打乱（排列与MnistBatchLoader相同），并从第0轮重新开始
+    void enable_shuffle(uint64_t seed);
+
+    // 训练一轮，返回本轮的平均损失
+    float train_epoch();
+    // split上的分类准确率，经evaluate_classifier各线程分段预测；标签超出模型的类别数时抛出std::runtime_error
+    float evaluate(MnistSplit split);
+
+    int num_threads() const { return team.size(); }
+    uint64_t epoch() const { return epoch_index; }
+    Optimizer& optimizer() { return opt; }
+    int64_t samples_seen() const { return samples; }
+
+private:
+    // 线程私有的缓冲区：一段批次与完整的前向/反向workspace（各自独立分配，互不共享缓存行）
+    struct Replica {
+        MlpWorkspace workspace;
+        MnistBatch shard;
+        float loss = 0.0f;
+    };
+
+    void compute_shard(int thread_index, int start, int count);
+    void reduce_chunk(int thread_index);
+
+    Mlp& model;
+    const MnistData& data;
+    Optimizer opt;
+    int batch_size;
+    ThreadTeam team;
+    std::vector<Replica> replicas;
+    std::vector<EvalShard> shards;
+    std::vector<int> order; // 本轮训练数据的排列；未打乱时为空
+    bool shuffle = false;
+    uint64_t shuffle_seed = 0;
+    uint64_t epoch_index = 0;
+    int64_t samples = 0;
+};
+
+#endif // PARALLEL_TRAINER_H
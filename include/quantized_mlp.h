@@ -0,0 +1,69 @@
+#ifndef QUANTIZED_MLP_H
+#define QUANTIZED_MLP_H
+
+#include <cstdint>
+#include <vector>
+#include "mlp.h"
+#include "mnist_loader.h"
+
+// int8 GEMM内核
+enum class Int8Kernel {
+    Auto,      // 选择当前CPU支持的最快内核
+    Scalar,    // 可移植的标量循环
+    Avx2,      // 扩展为int16后用_mm256_madd_epi16累加到int32，不会饱和
+    Avx512Vnni // _mm256_dpbusd_epi32：uint8 x int8 四个一组直接累加到int32
+};
+
+// 当前CPU是否支持该内核（Auto与Scalar总是支持）
+bool int8_kernel_supported(Int8Kernel kernel);
+const char* int8_kernel_name(Int8Kernel kernel);
+
+// int8量化推理引擎，直接读取原始的uint8像素（IDX文件中的字节），没有转换为float的步骤
+// 权重按输出通道对称量化为int8；隐藏层激活按张量量化为uint8，范围在校准数据上用浮点前向统计。
+// 每层都是 uint8 x int8 -> int32 的矩阵乘法，再用每个通道的乘数与偏移重新量化。
+class QuantizedMlp {
+public:
+    // 量化model；calibration中split部分的图像用于统计激活范围（默认测试集）
+    // 训练时输入是否除以255由calibration.normalize决定，推理时对原始像素做同样的缩放
+    QuantizedMlp(const Mlp& model, const MnistData& calibration, MnistSplit split = MnistSplit::Test,
+                 Int8Kernel kernel = Int8Kernel::Auto);
+
+    int input_size() const { return layers.front().in; }
+    int output_size() const { return layers.back().out; }
+    Int8Kernel kernel() const { return active; }
+    // 切换内核，不支持时抛出std::runtime_error
+    void set_kernel(Int8Kernel kernel);
+    // 各隐藏层激活的量化步长（uint8的1对应的浮点值）
+    const std::vector<float>& activation_scales() const { return scales; }
+
+    struct Layer {
+        int in = 0;
+        int out = 0;
+        int out_pad = 0;                // 按8个通道（一个256位int32向量）补齐
+        std::vector<int8_t> w4;         // [ceil(in/4)][out_pad][4]，VNNI与标量内核使用
+        std::vector<int16_t> w2;        // [ceil(in/2)][out_pad][2]，AVX2内核使用
+        std::vector<float> multiplier;  // int32累加值到下一层输入（或logits）的比例
+        std::vector<float> offset;      // 偏置，已换算到同一比例
+        bool hidden = false;            // 隐藏层：ReLU后量化为uint8
+    };
+    const std::vector<Layer>& quantized_layers() const { return layers; }
+
+    struct Workspace {
+        int max_batch = 0;
+        std::vector<int32_t> accumulators; // max_batch x 最宽的out_pad
+        std::vector<uint8_t> activations[2];
+
+        Workspace() = default;
+        Workspace(const QuantizedMlp& model, int max_batch);
+    };
+
+    // pixels为count x input_size的原始uint8像素（行优先，行间无填充）
+    void predict(const uint8_t* pixels, int count, int* out_labels, Workspace& workspace) const;
+
+private:
+    std::vector<Layer> layers;
+    std::vector<float> scales;
+    Int8Kernel active = Int8Kernel::Scalar;
+};
+
+#endif // QUANTIZED_MLP_H
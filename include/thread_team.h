@@ -0,0 +1,59 @@
+#ifndef THREAD_TEAM_H
+#define THREAD_TEAM_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 固定数量的常驻线程，反复以fork-join方式执行同一个任务；调用线程作为第0号线程参与
+// 分发任务只传递函数指针与上下文指针，每次run都不分配内存
+class ThreadTeam {
+public:
+    explicit ThreadTeam(int num_threads);
+    ~ThreadTeam();
+
+    ThreadTeam(const ThreadTeam&) = delete;
+    ThreadTeam& operator=(const ThreadTeam&) = delete;
+
+    int size() const { return team_size; }
+
+    // 在每个线程上执行task(thread_index)，全部完成后返回；任一线程抛出的异常在此重新抛出
+    template <typename Task>
+    void run(Task& task) {
+        dispatch(&invoke<Task>, &task);
+    }
+
+private:
+    using Thunk = void (*)(void* context, int thread_index);
+
+    template <typename Task>
+    static void invoke(void* context, int thread_index) {
+        (*static_cast<Task*>(context))(thread_index);
+    }
+
+    void dispatch(Thunk thunk, void* context);
+    void worker_loop(int thread_index);
+    void execute(int thread_index);
+
+    int team_size;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    Thunk current_thunk = nullptr;
+    void* current_context = nullptr;
+    uint64_t generation = 0; // 每次run加一，唤醒工作线程
+    int pending = 0;         // 本次run中尚未完成的工作线程数
+    bool stopping = false;
+    std::vector<std::exception_ptr> errors;
+    std::vector<std::thread> workers;
+};
+
+// count个元素平均分给n个线程时第i个线程的起始位置；第i个线程负责[thread_range_begin(count, i, n), thread_range_begin(count, i + 1, n))
+inline int thread_range_begin(int count, int i, int n) {
+    return static_cast<int>(static_cast<int64_t>(count) * i / n);
+}
+
+#endif // THREAD_TEAM_H
@@ -0,0 +1,118 @@
+#include "augment.h"
+#include "kernels.h"
+#include "mnist_loader.h"
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr float kPi = 3.14159265358979f;
+
+// Uniform in [-1, 1) from the top 24 bits, exact in float
+float uniform_pm1(uint64_t& state) {
+    return static_cast<float>(splitmix64(state) >> 40) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+using RowMatrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+
+// Banded n x n matrix applying the taps along one axis with zero padding; symmetric, since the taps are
+void gaussian_band(float* band, int n, const float* weights, int radius) {
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            band[i * n + j] = std::abs(i - j) <= radius ? weights[std::abs(i - j) + radius] : 0.0f;
+        }
+    }
+}
+
+struct GeometricAugment {
+    AugmentOptions options;
+    std::vector<float> weights; // normalized Gaussian taps, 2 * radius + 1
+    int radius = 0;
+
+    void operator()(float* image, int rows, int cols, uint64_t seed, std::vector<float>& scratch) const {
+        const int n = rows * cols;
+        const bool elastic = options.elastic_alpha > 0.0f;
+        const size_t needed = elastic ? static_cast<size_t>(n) * 7 + rows * rows + cols * cols : static_cast<size_t>(n) * 3;
+        if (scratch.size() < needed) {
+            scratch.resize(needed);
+        }
+        float* source = scratch.data();
+        float* xs = source + n;
+        float* ys = xs + n;
+
+        // Draw order is fixed, so a sample's transform depends on its seed alone
+        uint64_t state = seed;
+        const float angle = uniform_pm1(state) * options.max_rotation * (kPi / 180.0f);
+        const float tx = uniform_pm1(state) * options.max_shift;
+        const float ty = uniform_pm1(state) * options.max_shift;
+        const float c = std::cos(angle), s = std::sin(angle);
+        const float cx = (cols - 1) * 0.5f, cy = (rows - 1) * 0.5f;
+
+        // Inverse map: each output pixel is shifted back, then rotated back about the centre
+        for (int y = 0; y < rows; ++y) {
+            const float v = y - cy - ty;
+            for (int x = 0; x < cols; ++x) {
+                const float u = x - cx - tx;
+                xs[y * cols + x] = cx + (c * u + s * v);
+                ys[y * cols + x] = cy + (c * v - s * u);
+            }
+        }
+
+        if (elastic) {
+            // Simard et al.: uniform noise in [-1, 1] per pixel, smoothed, scaled by alpha
+            // The separable blur is two small matrix products, G_rows * field * G_cols, which Eigen
+            // vectorizes; both fields share the horizontal product as one stacked 2 * rows x cols matrix
+            float* dx = ys + n;
+            float* dy = dx + n;
+            float* tmp = dy + n;
+            float* band_rows = tmp + 2 * n;
+            float* band_cols = band_rows + rows * rows;
+            for (int i = 0; i < 2 * n; ++i) dx[i] = uniform_pm1(state);
+            gaussian_band(band_rows, rows, weights.data(), radius);
+            gaussian_band(band_cols, cols, weights.data(), radius);
+            Eigen::Map<const RowMatrix> g_rows(band_rows, rows, rows), g_cols(band_cols, cols, cols);
+            Eigen::Map<RowMatrix> fields(dx, 2 * rows, cols), blurred(tmp, 2 * rows, cols);
+            blurred.noalias() = fields * g_cols;
+            fields.topRows(rows).noalias() = g_rows * blurred.topRows(rows);
+            fields.bottomRows(rows).noalias() = g_rows * blurred.bottomRows(rows);
+            const float alpha = options.elastic_alpha;
+            for (int i = 0; i < n; ++i) {
+                xs[i] += alpha * dx[i];
+                ys[i] += alpha * dy[i];
+            }
+        }
+
+        std::copy(image, image + n, source);
+        bilinear_sample(source, rows, cols, xs, ys, image, n);
+    }
+};
+
+} // anonymous namespace
+
+uint64_t augment_sample_seed(uint64_t seed, uint64_t epoch, int64_t sample) {
+    uint64_t state = seed;
+    state = splitmix64(state) ^ epoch;
+    state = splitmix64(state) ^ static_cast<uint64_t>(sample);
+    return splitmix64(state);
+}
+
+AugmentFn make_geometric_augment(const AugmentOptions& options) {
+    if (options.max_shift < 0.0f || options.max_rotation < 0.0f || options.elastic_alpha < 0.0f ||
+        !(options.elastic_sigma > 0.0f)) {
+        throw std::runtime_error("Invalid augmentation options: ranges must be non-negative, elastic_sigma positive");
+    }
+    GeometricAugment augment;
+    augment.options = options;
+    if (options.elastic_alpha > 0.0f) {
+        augment.radius = static_cast<int>(std::ceil(3.0f * options.elastic_sigma));
+        float sum = 0.0f;
+        for (int k = -augment.radius; k <= augment.radius; ++k) {
+            augment.weights.push_back(std::exp(-0.5f * k * k / (options.elastic_sigma * options.elastic_sigma)));
+            sum += augment.weights.back();
+        }
+        for (float& w : augment.weights) w /= sum;
+    }
+    return augment;
+}
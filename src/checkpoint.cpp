@@ -0,0 +1,361 @@
+#include "checkpoint.h"
+#include "log.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <zlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char checkpoint_magic[8] = {'M', 'L', 'P', 'C', 'K', 'P', 'T', '\0'};
+const uint32_t byte_order_mark = 0x01020304;
+const uint64_t alignment = 64;
+constexpr int kMaxSizes = 16;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t num_sizes;           // layers + 1
+    uint32_t sizes[kMaxSizes];
+    uint32_t optimizer;           // OptimizerKind + 1, 0 = parameters only
+    float learning_rate;
+    float momentum;
+    float beta1;
+    float beta2;
+    float epsilon;
+    uint64_t steps;
+    uint64_t epoch;
+    uint64_t param_offset;
+    uint64_t param_count;         // floats, the whole arena including its alignment padding
+    uint64_t state_offset;
+    uint64_t state_count;
+    uint32_t reserved[6];
+    uint32_t payload_crc;         // CRC32 over the parameters, then the optimizer state
+    uint32_t header_crc;          // CRC32 over every field above
+};
+static_assert(sizeof(CheckpointHeader) == 192, "checkpoint header layout changed");
+
+uint64_t align_up(uint64_t value) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t header_checksum(const CheckpointHeader& header) {
+    return static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(&header),
+                                       offsetof(CheckpointHeader, header_crc)));
+}
+
+uint32_t payload_checksum(const float* params, uint64_t param_count, const float* state, uint64_t state_count) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    const std::pair<const float*, uint64_t> arrays[] = {{params, param_count}, {state, state_count}};
+    for (const auto& array : arrays) {
+        const Bytef* bytes = reinterpret_cast<const Bytef*>(array.first);
+        const uint64_t size = array.second * sizeof(float);
+        // crc32 takes uInt lengths, so feed large arrays in pieces
+        for (uint64_t done = 0; done < size;) {
+            uInt n = static_cast<uInt>(std::min<uint64_t>(size - done, 1u << 30));
+            crc = crc32(crc, bytes + done, n);
+            done += n;
+        }
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+// Parameters and optimizer state as they will sit in the file
+void write_checkpoint_file(const std::string& path, const CheckpointInfo& info, const float* params,
+                           uint64_t param_count, const float* state, uint64_t state_count) {
+    if (info.sizes.size() < 2 || info.sizes.size() > kMaxSizes) {
+        throw std::runtime_error("Cannot checkpoint an MLP with " + std::to_string(info.sizes.size()) + " sizes: " + path);
+    }
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+    header.version = MLP_CHECKPOINT_VERSION;
+    header.byte_order = byte_order_mark;
+    header.header_size = sizeof(CheckpointHeader);
+    header.num_sizes = static_cast<uint32_t>(info.sizes.size());
+    std::copy(info.sizes.begin(), info.sizes.end(), header.sizes);
+    if (info.has_optimizer) {
+        header.optimizer = static_cast<uint32_t>(info.optimizer.kind) + 1;
+        header.learning_rate = info.optimizer.learning_rate;
+        header.momentum = info.optimizer.momentum;
+        header.beta1 = info.optimizer.beta1;
+        header.beta2 = info.optimizer.beta2;
+        header.epsilon = info.optimizer.epsilon;
+        header.steps = static_cast<uint64_t>(info.steps);
+    }
+    header.epoch = info.epoch;
+    header.param_offset = align_up(sizeof(CheckpointHeader));
+    header.param_count = param_count;
+    header.state_offset = align_up(header.param_offset + param_count * sizeof(float));
+    header.state_count = state_count;
+    header.payload_crc = payload_checksum(params, param_count, state, state_count);
+    header.header_crc = header_checksum(header);
+
+    // Write next to the destination and rename, so readers only ever see a complete file
+    std::string tmp_path = path + ".tmp";
+#ifndef _WIN32
+    tmp_path += "." + std::to_string(::getpid());
+#endif
+    FILE* fp = std::fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        throw std::runtime_error("Failed to create checkpoint file: " + tmp_path);
+    }
+    static const char zeros[alignment] = {};
+    const uint64_t param_bytes = param_count * sizeof(float), state_bytes = state_count * sizeof(float);
+    const uint64_t param_pad = header.param_offset - sizeof(header);
+    const uint64_t state_pad = header.state_offset - header.param_offset - param_bytes;
+    bool ok = std::fwrite(&header, sizeof(header), 1, fp) == 1 &&
+              std::fwrite(zeros, 1, param_pad, fp) == param_pad &&
+              std::fwrite(params, 1, param_bytes, fp) == param_bytes &&
+              std::fwrite(zeros, 1, state_pad, fp) == state_pad &&
+              std::fwrite(state, 1, state_bytes, fp) == state_bytes;
+#ifndef _WIN32
+    ok = ok && std::fflush(fp) == 0 && ::fsync(fileno(fp)) == 0;
+#endif
+    ok = std::fclose(fp) == 0 && ok;
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Failed to write checkpoint: " + path);
+    }
+}
+
+CheckpointInfo info_for(const Mlp& model, const Optimizer* optimizer, uint64_t epoch) {
+    CheckpointInfo info;
+    info.sizes = model.layout().sizes;
+    info.epoch = epoch;
+    if (optimizer) {
+        info.has_optimizer = true;
+        info.optimizer = optimizer->config();
+        info.steps = optimizer->steps();
+    }
+    return info;
+}
+
+// Reads and validates the header at the start of a mapped checkpoint
+const CheckpointHeader& parse_header(const MappedFile& file) {
+    if (file.size() < sizeof(CheckpointHeader)) {
+        throw std::runtime_error("Checkpoint is too small: " + file.path());
+    }
+    const auto& header = *reinterpret_cast<const CheckpointHeader*>(file.data());
+    if (std::memcmp(header.magic, checkpoint_magic, sizeof(checkpoint_magic)) != 0) {
+        throw std::runtime_error("Not an MLP checkpoint: " + file.path());
+    }
+    if (header.byte_order != byte_order_mark) {
+        throw std::runtime_error("Checkpoint was written with a different byte order: " + file.path());
+    }
+    if (header.version != MLP_CHECKPOINT_VERSION || header.header_size != sizeof(CheckpointHeader)) {
+        throw std::runtime_error("Unsupported checkpoint version " + std::to_string(header.version) + " in " +
+                                 file.path());
+    }
+    if (header.header_crc != header_checksum(header)) {
+        throw std::runtime_error("Checkpoint header checksum mismatch: " + file.path());
+    }
+    if (header.num_sizes < 2 || header.num_sizes > kMaxSizes ||
+        header.optimizer > static_cast<uint32_t>(OptimizerKind::Adam) + 1) {
+        throw std::runtime_error("Malformed checkpoint header: " + file.path());
+    }
+    if (header.param_offset % alignment != 0 || header.state_offset % alignment != 0 ||
+        header.param_offset + header.param_count * sizeof(float) > file.size() ||
+        header.state_offset + header.state_count * sizeof(float) > file.size()) {
+        throw std::runtime_error("Checkpoint arrays lie outside the file: " + file.path());
+    }
+    return header;
+}
+
+CheckpointInfo info_from(const CheckpointHeader& header) {
+    CheckpointInfo info;
+    info.sizes.assign(header.sizes, header.sizes + header.num_sizes);
+    info.epoch = header.epoch;
+    if (header.optimizer != 0) {
+        info.has_optimizer = true;
+        info.optimizer.kind = static_cast<OptimizerKind>(header.optimizer - 1);
+        info.optimizer.learning_rate = header.learning_rate;
+        info.optimizer.momentum = header.momentum;
+        info.optimizer.beta1 = header.beta1;
+        info.optimizer.beta2 = header.beta2;
+        info.optimizer.epsilon = header.epsilon;
+        info.steps = static_cast<int64_t>(header.steps);
+    }
+    return info;
+}
+
+const float* param_data(const MappedFile& file, const CheckpointHeader& header) {
+    return reinterpret_cast<const float*>(file.data() + header.param_offset);
+}
+
+const float* state_data(const MappedFile& file, const CheckpointHeader& header) {
+    return reinterpret_cast<const float*>(file.data() + header.state_offset);
+}
+
+void verify_payload(const MappedFile& file, const CheckpointHeader& header) {
+    if (payload_checksum(param_data(file, header), header.param_count, state_data(file, header), header.state_count) !=
+        header.payload_crc) {
+        throw std::runtime_error("Checkpoint payload checksum mismatch: " + file.path());
+    }
+}
+
+// The arena size follows from the layer sizes; a mismatch means a damaged or foreign file
+void check_arena(const MappedFile& file, const CheckpointHeader& header, const MlpLayout& layout) {
+    if (header.param_count != static_cast<uint64_t>(layout.total)) {
+        throw std::runtime_error("Checkpoint parameter count " + std::to_string(header.param_count) +
+                                 " does not match its layer sizes: " + file.path());
+    }
+}
+
+} // anonymous namespace
+
+void save_checkpoint(const std::string& path, const Mlp& model, const Optimizer* optimizer, uint64_t epoch) {
+    const float* state = optimizer ? optimizer->state().data() : nullptr;
+    const uint64_t state_count = optimizer ? static_cast<uint64_t>(optimizer->state().size()) : 0;
+    write_checkpoint_file(path, info_for(model, optimizer, epoch), model.parameter_data(),
+                          static_cast<uint64_t>(model.layout().total), state, state_count);
+}
+
+CheckpointInfo read_checkpoint_info(const std::string& path) {
+    MappedFile file(path, false);
+    return info_from(parse_header(file));
+}
+
+CheckpointInfo load_checkpoint(const std::string& path, Mlp& model, Optimizer* optimizer) {
+    MappedFile file(path);
+    const CheckpointHeader& header = parse_header(file);
+    CheckpointInfo info = info_from(header);
+    if (model.is_mapped()) {
+        throw std::runtime_error("Cannot load a checkpoint into a mapped model: " + path);
+    }
+    if (info.sizes != model.layout().sizes) {
+        throw std::runtime_error("Checkpoint layer sizes do not match the model: " + path);
+    }
+    check_arena(file, header, model.layout());
+    if (optimizer) {
+        if (!info.has_optimizer || info.optimizer.kind != optimizer->config().kind ||
+            header.state_count != static_cast<uint64_t>(optimizer->state().size())) {
+            throw std::runtime_error("Checkpoint optimizer state does not match the optimizer: " + path);
+        }
+    }
+    verify_payload(file, header);
+
+    std::copy_n(param_data(file, header), header.param_count, model.parameters().data());
+    if (optimizer) {
+        std::copy_n(state_data(file, header), header.state_count, optimizer->state().data());
+        optimizer->set_steps(info.steps);
+    }
+    return info;
+}
+
+Mlp map_checkpoint(const std::string& path, bool verify_checksum) {
+    // Inference touches every weight on the first batch, so no access-pattern hint either way
+    auto file = std::make_shared<MappedFile>(path, false);
+    const CheckpointHeader& header = parse_header(*file);
+    CheckpointInfo info = info_from(header);
+    check_arena(*file, header, MlpLayout(info.sizes));
+    if (verify_checksum) {
+        verify_payload(*file, header);
+    }
+    const float* params = param_data(*file, header);
+    return Mlp(info.sizes, std::move(file), params);
+}
+
+// --- CheckpointWriter ---
+
+CheckpointWriter::CheckpointWriter() : worker(&CheckpointWriter::writer_loop, this) {}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this] { return !busy; });
+        stopping = true;
+    }
+    work_cv.notify_all();
+    worker.join();
+    if (error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::exception& e) {
+            MNIST_LOG_WARN("Unreported checkpoint write failure: " << e.what());
+        }
+    }
+}
+
+bool CheckpointWriter::save_async(const std::string& path, const Mlp& model, const Optimizer* optimizer,
+                                  uint64_t epoch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    rethrow_error();
+    if (busy) {
+        ++skip_count;
+        return false;
+    }
+    lock.unlock();
+
+    // The only work on the training thread: copy the parameters and state while they are consistent.
+    // The buffers keep their capacity, so steady-state saves do not allocate
+    this->path = path;
+    info = info_for(model, optimizer, epoch);
+    params.resize(model.layout().total);
+    std::copy_n(model.parameter_data(), params.size(), params.data());
+    if (optimizer) {
+        state.resize(optimizer->state().size());
+        std::copy_n(optimizer->state().data(), state.size(), state.data());
+    } else {
+        state.resize(0);
+    }
+
+    lock.lock();
+    busy = true;
+    lock.unlock();
+    work_cv.notify_one();
+    return true;
+}
+
+void CheckpointWriter::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return !busy; });
+    rethrow_error();
+}
+
+uint64_t CheckpointWriter::saved() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return save_count;
+}
+
+void CheckpointWriter::rethrow_error() {
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void CheckpointWriter::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        work_cv.wait(lock, [this] { return busy || stopping; });
+        if (!busy) {
+            return;
+        }
+        lock.unlock();
+        std::exception_ptr failure;
+        try {
+            write_checkpoint_file(path, info, params.data(), static_cast<uint64_t>(params.size()), state.data(),
+                                  static_cast<uint64_t>(state.size()));
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        lock.lock();
+        if (failure) {
+            error = failure;
+        } else {
+            ++save_count;
+        }
+        busy = false;
+        done_cv.notify_all();
+    }
+}
@@ -0,0 +1,241 @@
+#include "downloader.h"
+#include "log.h"
+#include "metrics.h"
+#include <curl/curl.h>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+
+// State of one file across all of its attempts
+struct Transfer {
+    const DownloadJob* job = nullptr;
+    std::string part_path;
+    CURL* easy = nullptr;
+    FILE* fp = nullptr;
+    size_t url_index = 0;         // index into job->urls of the current mirror
+    int failures = 0;             // attempts that added nothing to the .part file
+    curl_off_t start_size = 0;    // size of the .part file when this attempt started
+    curl_off_t resume_from = 0;   // offset requested from the server (reset if it ignores Range)
+    curl_off_t received = 0;      // bytes written during this attempt
+    long long abort_after = 0;
+    bool range_checked = false;
+    std::string last_error;
+};
+
+curl_off_t file_size(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<curl_off_t>(st.st_size) : 0;
+}
+
+bool has_gzip_header(const std::string& path) {
+    FILE* fp = std::fopen(path.c_str(), "rb");
+    if (!fp) return false;
+    unsigned char header[2] = {0, 0};
+    size_t n = std::fread(header, 1, 2, fp);
+    std::fclose(fp);
+    return n == 2 && header[0] == 0x1f && header[1] == 0x8b;
+}
+
+// Callback function for curl to append data to the .part file
+size_t write_part(void* ptr, size_t size, size_t nmemb, void* userdata) {
+    Transfer* t = static_cast<Transfer*>(userdata);
+    size_t bytes = size * nmemb;
+
+    // A server that ignores Range answers 200 with the whole file: start the .part over.
+    // The attempt then starts from an empty file, so progress is measured from zero
+    if (t->resume_from > 0 && !t->range_checked) {
+        t->range_checked = true;
+        long code = 0;
+        curl_easy_getinfo(t->easy, CURLINFO_RESPONSE_CODE, &code);
+        if (code == 200) {
+            t->fp = std::freopen(t->part_path.c_str(), "wb", t->fp);
+            if (!t->fp) return 0;
+            t->resume_from = 0;
+            t->start_size = 0;
+        }
+    }
+
+    size_t allowed = bytes;
+    if (t->abort_after > 0 && t->received + static_cast<curl_off_t>(bytes) > t->abort_after) {
+        allowed = static_cast<size_t>(t->abort_after - t->received);
+    }
+    size_t written = std::fwrite(ptr, 1, allowed, t->fp);
+    t->received += written;
+    metrics_add(MetricCounter::DownloadBytes, written);
+    // Returning a short count makes curl fail the transfer with CURLE_WRITE_ERROR
+    return written == bytes ? bytes : 0;
+}
+
+const std::string& current_url(const Transfer& t) {
+    return t.job->urls[t.url_index % t.job->urls.size()];
+}
+
+// Configures the easy handle for the next attempt, resuming from the .part file
+bool start_attempt(Transfer& t, const DownloadOptions& options) {
+    t.start_size = file_size(t.part_path);
+    t.resume_from = t.start_size;
+    t.received = 0;
+    t.range_checked = false;
+    t.fp = std::fopen(t.part_path.c_str(), t.resume_from > 0 ? "ab" : "wb");
+    if (!t.fp) {
+        t.last_error = "Failed to open " + t.part_path + " for writing";
+        return false;
+    }
+
+    const std::string& url = current_url(t);
+    curl_easy_reset(t.easy);
+    curl_easy_setopt(t.easy, CURLOPT_URL, url.c_str());
+    curl_easy_setopt(t.easy, CURLOPT_WRITEFUNCTION, write_part);
+    curl_easy_setopt(t.easy, CURLOPT_WRITEDATA, &t);
+    curl_easy_setopt(t.easy, CURLOPT_PRIVATE, &t);
+    curl_easy_setopt(t.easy, CURLOPT_RESUME_FROM_LARGE, t.resume_from);
+    curl_easy_setopt(t.easy, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(t.easy, CURLOPT_MAXREDIRS, 5L);
+    curl_easy_setopt(t.easy, CURLOPT_USERAGENT, "libcurl-mnist-downloader/1.2");
+    curl_easy_setopt(t.easy, CURLOPT_FAILONERROR, 1L);
+    curl_easy_setopt(t.easy, CURLOPT_CONNECTTIMEOUT, options.connect_timeout);
+    // Stalled transfers fail and resume elsewhere instead of hitting a fixed total timeout
+    curl_easy_setopt(t.easy, CURLOPT_LOW_SPEED_LIMIT, 1024L);
+    curl_easy_setopt(t.easy, CURLOPT_LOW_SPEED_TIME, 30L);
+
+    if (t.resume_from > 0) {
+        MNIST_LOG_INFO("Attempting download from: " << url << " (resuming at byte " << t.resume_from << ") ...");
+    } else {
+        MNIST_LOG_INFO("Attempting download from: " << url << " ...");
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+void download_all(const std::vector<DownloadJob>& jobs, const DownloadOptions& options) {
+    if (jobs.empty()) {
+        return;
+    }
+    ScopedTimer timer(MetricTimer::Download);
+    CURLM* multi = curl_multi_init();
+    if (!multi) {
+        throw std::runtime_error("curl_multi_init() failed");
+    }
+    struct MultiCleaner {
+        CURLM* handle;
+        ~MultiCleaner() { curl_multi_cleanup(handle); }
+    } multi_cleaner{multi};
+
+    std::vector<std::unique_ptr<Transfer>> transfers;
+    for (const auto& job : jobs) {
+        if (job.urls.empty()) {
+            throw std::runtime_error("No download URLs provided for " + job.out_path);
+        }
+        auto t = std::make_unique<Transfer>();
+        t->job = &job;
+        t->part_path = job.out_path + ".part";
+        t->abort_after = options.abort_after_bytes;
+        t->easy = curl_easy_init();
+        if (!t->easy) {
+            throw std::runtime_error("curl_easy_init() failed");
+        }
+        transfers.push_back(std::move(t));
+    }
+    struct EasyCleaner {
+        std::vector<std::unique_ptr<Transfer>>& list;
+        CURLM* multi;
+        ~EasyCleaner() {
+            for (auto& t : list) {
+                curl_multi_remove_handle(multi, t->easy);
+                curl_easy_cleanup(t->easy);
+                if (t->fp) std::fclose(t->fp);
+            }
+        }
+    } easy_cleaner{transfers, multi};
+
+    std::deque<Transfer*> pending;
+    for (auto& t : transfers) pending.push_back(t.get());
+    std::vector<std::string> failed;
+    int active = 0;
+    const int max_parallel = options.max_parallel > 0 ? options.max_parallel : 1;
+
+    auto launch = [&](Transfer* t) {
+        if (start_attempt(*t, options)) {
+            curl_multi_add_handle(multi, t->easy);
+            ++active;
+        } else {
+            failed.push_back(t->job->out_path + ": " + t->last_error);
+        }
+    };
+
+    while (active > 0 || !pending.empty()) {
+        while (active < max_parallel && !pending.empty()) {
+            Transfer* t = pending.front();
+            pending.pop_front();
+            launch(t);
+        }
+        int running = 0;
+        curl_multi_perform(multi, &running);
+
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+            Transfer* t = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&t));
+            CURLcode res = msg->data.result;
+            long http_code = 0;
+            curl_easy_getinfo(t->easy, CURLINFO_RESPONSE_CODE, &http_code);
+            curl_multi_remove_handle(multi, t->easy);
+            --active;
+            bool closed = std::fclose(t->fp) == 0;
+            t->fp = nullptr;
+            const std::string url = current_url(*t);
+
+            if (res == CURLE_OK && closed && has_gzip_header(t->part_path)) {
+                std::remove(t->job->out_path.c_str());
+                if (std::rename(t->part_path.c_str(), t->job->out_path.c_str()) == 0) {
+                    MNIST_LOG_INFO("Download complete and verified (gzip header OK) for " << t->job->out_path);
+                    continue;
+                }
+                t->last_error = "Failed to rename " + t->part_path;
+            } else if (res == CURLE_OK) {
+                // Complete but not gzip: the bytes are wrong, so resuming would not help
+                std::remove(t->part_path.c_str());
+                t->last_error = "Downloaded file is not in valid gzip format (URL: " + url + ")";
+            } else {
+                if (http_code == 416) {
+                    // The .part no longer matches what the server has; start over
+                    std::remove(t->part_path.c_str());
+                }
+                t->last_error = "Download failed: " + std::string(curl_easy_strerror(res)) +
+                                " (URL: " + url + ", CURLcode: " + std::to_string(res) +
+                                ", HTTP code: " + std::to_string(http_code) + ", " +
+                                std::to_string(t->received) + " bytes received)";
+            }
+            MNIST_LOG_WARN("Download attempt failed: " << t->last_error);
+
+            // An attempt that moved the .part forward resumes on the same mirror; one that
+            // did not counts against the budget and fails over to the next mirror
+            if (file_size(t->part_path) <= t->start_size) {
+                ++t->failures;
+                ++t->url_index;
+            }
+            int max_failures = options.max_rounds * static_cast<int>(t->job->urls.size());
+            if (t->failures < max_failures) {
+                pending.push_front(t);
+            } else {
+                failed.push_back(t->job->out_path + ": " + t->last_error);
+            }
+        }
+
+        if (active > 0) {
+            curl_multi_wait(multi, nullptr, 0, 1000, nullptr);
+        }
+    }
+
+    if (!failed.empty()) {
+        std::string message = "Failed to download " + std::to_string(failed.size()) + " file(s) from all provided sources:";
+        for (const auto& f : failed) message += "\n  " + f;
+        throw std::runtime_error(message);
+    }
+}
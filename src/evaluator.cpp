@@ -0,0 +1,109 @@
+#include "evaluator.h"
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+float EvalReport::precision(int c) const {
+    int64_t predicted = 0;
+    for (int t = 0; t < num_classes; ++t) {
+        predicted += cell(t, c);
+    }
+    return predicted > 0 ? static_cast<float>(cell(c, c)) / predicted : 0.0f;
+}
+
+float EvalReport::recall(int c) const {
+    int64_t actual = 0;
+    for (int p = 0; p < num_classes; ++p) {
+        actual += cell(c, p);
+    }
+    return actual > 0 ? static_cast<float>(cell(c, c)) / actual : 0.0f;
+}
+
+void print_eval_report(std::ostream& out, const EvalReport& report) {
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(4) << "accuracy " << report.accuracy() << " (" << report.correct << "/"
+        << report.count << "), " << std::setprecision(2) << report.seconds * 1e3 << " ms, " << std::setprecision(0)
+        << report.samples_per_second() << " samples/s on " << report.threads << " threads\n";
+    out << "class  precision  recall   support\n";
+    for (int c = 0; c < report.num_classes; ++c) {
+        int64_t support = 0;
+        for (int p = 0; p < report.num_classes; ++p) support += report.cell(c, p);
+        out << std::setw(5) << c << std::setprecision(4) << std::setw(11) << report.precision(c) << std::setw(8)
+            << report.recall(c) << std::setw(10) << support << "\n";
+    }
+    out << "confusion (rows: label, columns: prediction)\n";
+    for (int t = 0; t < report.num_classes; ++t) {
+        out << std::setw(5) << t;
+        for (int p = 0; p < report.num_classes; ++p) {
+            out << std::setw(6) << report.cell(t, p);
+        }
+        out << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+EvalShard::EvalShard(int num_classes, int block)
+    : predictions(block), confusion(static_cast<size_t>(num_classes) * num_classes, 0) {}
+
+void EvalShard::count(const int* labels, int start, int count, int num_classes, const char* classes_of) {
+    for (int i = 0; i < count; ++i) {
+        const int truth = labels[start + i];
+        if (truth < 0 || truth >= num_classes) {
+            throw std::runtime_error("Label " + std::to_string(truth) + " of sample " + std::to_string(start + i) +
+                                     " is outside " + classes_of + " " + std::to_string(num_classes) + " classes");
+        }
+        const int predicted = predictions[i];
+        ++confusion[static_cast<size_t>(truth) * num_classes + predicted];
+        correct += predicted == truth;
+    }
+}
+
+EvalReport merge_eval_shards(const std::vector<EvalShard>& shards, int num_classes, int count) {
+    EvalReport report;
+    report.num_classes = num_classes;
+    report.count = count;
+    report.confusion.assign(static_cast<size_t>(num_classes) * num_classes, 0);
+    for (const auto& shard : shards) {
+        for (size_t i = 0; i < report.confusion.size(); ++i) {
+            report.confusion[i] += shard.confusion[i];
+        }
+        report.correct += shard.correct;
+    }
+    return report;
+}
+
+MnistEvaluator::MnistEvaluator(const Mlp& model, const MnistData& data, int batch_size, int num_threads)
+    : model(model), data(data), batch_size(batch_size > 0 ? batch_size : 1), num_classes(model.output_size()),
+      team(num_threads) {
+    if (model.input_size() != data.rows * data.cols) {
+        throw std::runtime_error("Model input size " + std::to_string(model.input_size()) +
+                                 " does not match image size " + std::to_string(data.rows * data.cols));
+    }
+    replicas.resize(team.size());
+    for (auto& replica : replicas) {
+        replica.workspace = MlpWorkspace(model.layout(), this->batch_size);
+        // Float storage is predicted in place, so only uint8 storage needs a conversion buffer
+        if (data.storage == MnistStorage::Uint8) {
+            replica.images.resize(this->batch_size, model.input_size());
+        }
+    }
+    shards.assign(team.size(), EvalShard(num_classes, this->batch_size));
+}
+
+EvalReport MnistEvaluator::evaluate(MnistSplit split) {
+    const size_t img_size = static_cast<size_t>(data.rows) * data.cols;
+    return evaluate_classifier(team, shards, data, split, num_classes, batch_size, "the model's",
+                               [&](int thread_index, int start, int count, int* predictions) {
+        Replica& replica = replicas[thread_index];
+        const float* x;
+        if (data.storage == MnistStorage::Float) {
+            x = data.image_data(split) + static_cast<size_t>(start) * img_size;
+        } else {
+            copy_images(data, split, start, count, replica.images.data());
+            x = replica.images.data();
+        }
+        model.predict(x, count, predictions, replica.workspace);
+    });
+}
@@ -0,0 +1,73 @@
+#include "gz_reader.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+
+GzReader::GzReader(const std::string& path) : input(path) {
+    std::memset(&stream, 0, sizeof(stream));
+    // 16 + MAX_WBITS selects gzip framing
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        throw std::runtime_error("inflateInit2 failed for " + path);
+    }
+    stream.next_in = const_cast<Bytef*>(input.data());
+    stream.avail_in = 0;
+}
+
+GzReader::~GzReader() {
+    inflateEnd(&stream);
+}
+
+size_t GzReader::read(void* dst, size_t n) {
+    if (finished || n == 0) {
+        return 0;
+    }
+    size_t total = 0;
+    unsigned char* out = static_cast<unsigned char*>(dst);
+    while (total < n) {
+        // zlib counts in uInt, so feed very large inputs and outputs in pieces
+        if (stream.avail_in == 0) {
+            size_t consumed = static_cast<size_t>(stream.next_in - input.data());
+            size_t remaining = input.size() - consumed;
+            stream.avail_in = static_cast<uInt>(std::min<size_t>(remaining, UINT_MAX));
+        }
+        size_t chunk = std::min<size_t>(n - total, UINT_MAX);
+        stream.next_out = out + total;
+        stream.avail_out = static_cast<uInt>(chunk);
+
+        int ret = inflate(&stream, Z_NO_FLUSH);
+        total += chunk - stream.avail_out;
+
+        if (ret == Z_STREAM_END) {
+            size_t consumed = static_cast<size_t>(stream.next_in - input.data());
+            if (consumed >= input.size()) {
+                finished = true;
+                break;
+            }
+            // Concatenated gzip members decode as one stream
+            inflateReset(&stream);
+        } else if (ret == Z_BUF_ERROR && stream.avail_in == 0) {
+            throw std::runtime_error("Unexpected end of compressed data in " + path());
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            throw std::runtime_error("Error during decompression of " + path() + ": " +
+                                     (stream.msg ? stream.msg : "unknown zlib error") +
+                                     " (zlib error code: " + std::to_string(ret) + ")");
+        }
+    }
+    return total;
+}
+
+void GzReader::read_exact(void* dst, size_t n) {
+    size_t got = read(dst, n);
+    if (got != n) {
+        throw std::runtime_error("Compressed file " + path() + " is truncated: expected " + std::to_string(n) +
+                                 " more bytes, got " + std::to_string(got));
+    }
+}
+
+int GzReader::read_int() {
+    unsigned char buf[4];
+    read_exact(buf, 4);
+    return (static_cast<int>(buf[0]) << 24) | (static_cast<int>(buf[1]) << 16) |
+           (static_cast<int>(buf[2]) << 8) | static_cast<int>(buf[3]);
+}
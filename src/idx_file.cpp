@@ -0,0 +1,268 @@
+#include "idx_file.h"
+#include "kernels.h"
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <fstream>
+#include <utility>
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Decodes a 32-bit big-endian integer in place
+int decode_int(const uint8_t* p) {
+    return (static_cast<int>(p[0]) << 24) | (static_cast<int>(p[1]) << 16) |
+           (static_cast<int>(p[2]) << 8) | static_cast<int>(p[3]);
+}
+
+uint32_t load_be32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+int16_t load_be16(const uint8_t* p) {
+    return static_cast<int16_t>((p[0] << 8) | p[1]);
+}
+
+float load_be_f32(const uint8_t* p) {
+    uint32_t bits = load_be32(p);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+double load_be_f64(const uint8_t* p) {
+    uint64_t bits = (static_cast<uint64_t>(load_be32(p)) << 32) | load_be32(p + 4);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+} // anonymous namespace
+
+// --- IDX types and headers ---
+
+size_t idx_type_size(IdxType type) {
+    switch (type) {
+    case IdxType::UInt8:
+    case IdxType::Int8: return 1;
+    case IdxType::Int16: return 2;
+    case IdxType::Int32:
+    case IdxType::Float32: return 4;
+    case IdxType::Float64: return 8;
+    }
+    throw std::runtime_error("unsupported IDX data type code " + std::to_string(static_cast<int>(type)));
+}
+
+const char* idx_type_name(IdxType type) {
+    switch (type) {
+    case IdxType::UInt8: return "uint8";
+    case IdxType::Int8: return "int8";
+    case IdxType::Int16: return "int16";
+    case IdxType::Int32: return "int32";
+    case IdxType::Float32: return "float32";
+    case IdxType::Float64: return "float64";
+    }
+    return "unknown";
+}
+
+IdxHeader parse_idx_header(const uint8_t* data, size_t size) {
+    if (size < 4) {
+        throw std::runtime_error("file is too small to hold an IDX header");
+    }
+    if (data[0] != 0 || data[1] != 0) {
+        throw std::runtime_error("magic number does not start with two zero bytes");
+    }
+    IdxHeader header;
+    header.type = static_cast<IdxType>(data[2]);
+    idx_type_size(header.type); // rejects unknown type codes
+    header.magic = decode_int(data);
+    int rank = data[3];
+    if (rank == 0) {
+        throw std::runtime_error("IDX rank must be at least 1");
+    }
+    header.header_bytes = 4 + 4 * static_cast<size_t>(rank);
+    if (size < header.header_bytes) {
+        throw std::runtime_error("header is truncated");
+    }
+    header.shape.resize(rank);
+    for (int d = 0; d < rank; ++d) {
+        int dim = decode_int(data + 4 + 4 * d);
+        if (dim < 0) {
+            throw std::runtime_error("negative dimension in header");
+        }
+        header.shape[d] = dim;
+        if (d > 0) {
+            if (dim != 0 && header.item_elements > std::numeric_limits<size_t>::max() / 8 / dim) {
+                throw std::runtime_error("item size overflows");
+            }
+            header.item_elements *= static_cast<size_t>(dim);
+        }
+    }
+    return header;
+}
+
+// Big-endian elements are assembled byte by byte; GCC turns each load into a single bswap
+void idx_decode(IdxType type, const uint8_t* src, size_t n, float* dst, float divisor) {
+    switch (type) {
+    case IdxType::UInt8:
+        u8_to_f32(src, dst, n, divisor);
+        return;
+    case IdxType::Int8:
+        for (size_t i = 0; i < n; ++i) dst[i] = static_cast<int8_t>(src[i]) / divisor;
+        return;
+    case IdxType::Int16:
+        for (size_t i = 0; i < n; ++i) dst[i] = load_be16(src + 2 * i) / divisor;
+        return;
+    case IdxType::Int32:
+        for (size_t i = 0; i < n; ++i) dst[i] = static_cast<float>(static_cast<int32_t>(load_be32(src + 4 * i))) / divisor;
+        return;
+    case IdxType::Float32:
+        for (size_t i = 0; i < n; ++i) dst[i] = load_be_f32(src + 4 * i) / divisor;
+        return;
+    case IdxType::Float64:
+        for (size_t i = 0; i < n; ++i) dst[i] = static_cast<float>(load_be_f64(src + 8 * i)) / divisor;
+        return;
+    }
+    idx_type_size(type);
+}
+
+void idx_decode(IdxType type, const uint8_t* src, size_t n, int* dst) {
+    switch (type) {
+    case IdxType::UInt8:
+        for (size_t i = 0; i < n; ++i) dst[i] = src[i];
+        return;
+    case IdxType::Int8:
+        for (size_t i = 0; i < n; ++i) dst[i] = static_cast<int8_t>(src[i]);
+        return;
+    case IdxType::Int16:
+        for (size_t i = 0; i < n; ++i) dst[i] = load_be16(src + 2 * i);
+        return;
+    case IdxType::Int32:
+        for (size_t i = 0; i < n; ++i) dst[i] = static_cast<int32_t>(load_be32(src + 4 * i));
+        return;
+    case IdxType::Float32:
+    case IdxType::Float64:
+        throw std::runtime_error(std::string("cannot decode ") + idx_type_name(type) + " IDX data as integers");
+    }
+    idx_type_size(type);
+}
+
+// --- MappedFile ---
+
+MappedFile::MappedFile(const std::string& path, bool sequential) : file_path(path) {
+#ifdef _WIN32
+    (void)sequential;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+    fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    mapping = fallback.data();
+    mapping_size = fallback.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open file: " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        const std::string reason = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("Cannot stat file: " + path + ": " + reason);
+    }
+    mapping_size = static_cast<size_t>(st.st_size);
+    if (mapping_size > 0) {
+        void* addr = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            const std::string reason = std::strerror(errno);
+            ::close(fd);
+            throw std::runtime_error("Failed to mmap file: " + path + ": " + reason);
+        }
+        mapping = static_cast<const uint8_t*>(addr);
+        if (sequential) {
+            ::madvise(addr, mapping_size, MADV_SEQUENTIAL);
+        }
+    }
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        release();
+        file_path = std::move(other.file_path);
+        mapping = other.mapping;
+        mapping_size = other.mapping_size;
+        fallback = std::move(other.fallback);
+        other.mapping = nullptr;
+        other.mapping_size = 0;
+    }
+    return *this;
+}
+
+void MappedFile::release() {
+#ifndef _WIN32
+    if (mapping && mapping_size > 0) {
+        ::munmap(const_cast<uint8_t*>(mapping), mapping_size);
+    }
+#endif
+    fallback.clear();
+    mapping = nullptr;
+    mapping_size = 0;
+}
+
+// --- IdxFile ---
+
+IdxFile::IdxFile(const std::string& path) {
+    // MappedFile's error already names the path and the reason
+    file = MappedFile(path);
+    const uint8_t* mapping = file.data();
+    const size_t mapping_size = file.size();
+
+    try {
+        header = parse_idx_header(mapping, mapping_size);
+        const size_t items = static_cast<size_t>(header.count());
+        if (header.item_bytes() != 0 && items > std::numeric_limits<size_t>::max() / header.item_bytes()) {
+            throw std::runtime_error("payload size overflows");
+        }
+        size_t expected = static_cast<size_t>(header.count()) * header.item_bytes();
+        size_t available = mapping_size - header.header_bytes;
+        if (available < expected) {
+            throw std::runtime_error("payload is truncated: expected " + std::to_string(expected) +
+                                     " bytes, got " + std::to_string(available));
+        }
+        trailing = available - expected;
+    } catch (const std::runtime_error& e) {
+        file = MappedFile();
+        throw std::runtime_error("Invalid IDX file " + path + ": " + e.what());
+    }
+}
+
+ByteSpan IdxFile::payload() const {
+    return ByteSpan{file.data() + header.header_bytes, static_cast<size_t>(count()) * item_size()};
+}
+
+ByteSpan IdxFile::item(int i) const {
+    if (i < 0 || i >= count()) {
+        throw std::out_of_range("IDX item index " + std::to_string(i) + " out of range in " + path());
+    }
+    return ByteSpan{file.data() + header.header_bytes + static_cast<size_t>(i) * item_size(), item_size()};
+}
@@ -0,0 +1,210 @@
+#include "idx_stream.h"
+#include "log.h"
+#include "metrics.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Opens an IDX file as a stream and parses its header, checking that the payload is all there
+IdxHeader open_idx_stream(std::ifstream& file, const std::string& path) {
+    file.open(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open IDX file: " + path);
+    }
+    try {
+        uint8_t buf[4 + 4 * 255];
+        file.read(reinterpret_cast<char*>(buf), 4);
+        size_t header_bytes = file.gcount() == 4 ? 4 + 4 * static_cast<size_t>(buf[3]) : 0;
+        if (header_bytes > 0) {
+            file.read(reinterpret_cast<char*>(buf + 4), header_bytes - 4);
+            header_bytes = 4 + static_cast<size_t>(file.gcount());
+        }
+        IdxHeader header = parse_idx_header(buf, header_bytes);
+
+        file.clear();
+        file.seekg(0, std::ios::end);
+        size_t available = static_cast<size_t>(file.tellg()) - header.header_bytes;
+        size_t expected = static_cast<size_t>(header.count()) * header.item_bytes();
+        if (available < expected) {
+            throw std::runtime_error("payload is truncated: expected " + std::to_string(expected) +
+                                     " bytes, got " + std::to_string(available));
+        }
+        if (available > expected) {
+            MNIST_LOG_WARN("Extra data detected at the end of IDX file: " << path);
+        }
+        return header;
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error("Invalid IDX file " + path + ": " + e.what());
+    }
+}
+
+void read_exact(std::ifstream& file, uint8_t* dst, size_t n) {
+    file.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(n));
+    if (static_cast<size_t>(file.gcount()) != n) {
+        throw std::runtime_error("IDX stream ended early");
+    }
+}
+
+} // anonymous namespace
+
+IdxStreamLoader::IdxStreamLoader(const std::string& images_path, const std::string& labels_path,
+                                 const IdxStreamOptions& options)
+    : chunk_samples(options.chunk_size > 0 ? options.chunk_size : 1) {
+    if (options.chunk_size <= 0) {
+        MNIST_LOG_WARN("Invalid chunk_size " << options.chunk_size << ". Using chunk_size=1.");
+    }
+    image_header = open_idx_stream(images, images_path);
+    label_header = open_idx_stream(labels, labels_path);
+
+    // Same shape rules as load_mnist: count x rows x cols, or count x features
+    if (image_header.shape.size() < 2) {
+        throw std::runtime_error("Image file must have at least 2 dimensions: " + images_path);
+    }
+    if (image_header.item_elements > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        throw std::runtime_error("Image size too large in " + images_path);
+    }
+    image_rows = image_header.shape.size() == 2 ? 1 : image_header.shape[1];
+    image_cols = static_cast<int>(image_header.item_elements) / std::max(image_rows, 1);
+    if (label_header.shape.size() != 1 || label_header.type == IdxType::Float32 ||
+        label_header.type == IdxType::Float64) {
+        throw std::runtime_error("Label file must be one integer per sample: " + labels_path);
+    }
+    if (label_header.count() != image_header.count()) {
+        throw std::runtime_error("Label count mismatch in " + labels_path + ": expected " +
+                                 std::to_string(image_header.count()) + ", got " +
+                                 std::to_string(label_header.count()));
+    }
+
+    chunk_count = (count() + chunk_samples - 1) / chunk_samples;
+    divisor = options.normalize && image_header.type == IdxType::UInt8 ? 255.0f : 1.0f;
+
+    // Every buffer is allocated once, here; chunks only ever swap buffers afterwards
+    raw_images.resize(static_cast<size_t>(chunk_samples) * image_header.item_bytes());
+    raw_labels.resize(static_cast<size_t>(chunk_samples) * label_header.item_bytes());
+    slots.resize(std::max(options.depth, 1));
+    for (auto& slot : slots) {
+        slot.batch.images.resize(chunk_samples, image_header.item_elements);
+        slot.batch.labels.resize(chunk_samples);
+    }
+    start();
+}
+
+IdxStreamLoader::~IdxStreamLoader() {
+    stop();
+}
+
+size_t IdxStreamLoader::buffer_bytes() const {
+    size_t slot_bytes = static_cast<size_t>(chunk_samples) * (image_header.item_elements * sizeof(float) + sizeof(int));
+    return slots.size() * slot_bytes + raw_images.size() + raw_labels.size();
+}
+
+void IdxStreamLoader::start() {
+    images.clear();
+    labels.clear();
+    images.seekg(static_cast<std::streamoff>(image_header.header_bytes));
+    labels.seekg(static_cast<std::streamoff>(label_header.header_bytes));
+    consume_seq = 0;
+    stopping = false;
+    error = nullptr;
+    for (auto& slot : slots) {
+        slot.ready_seq = -1;
+    }
+    reader = std::thread(&IdxStreamLoader::reader_loop, this);
+}
+
+void IdxStreamLoader::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    free_cv.notify_all();
+    if (reader.joinable()) {
+        reader.join();
+    }
+}
+
+// The files are read strictly in order, so one thread owns both streams and the raw buffers
+void IdxStreamLoader::reader_loop() {
+    for (int64_t seq = 0; seq < chunk_count; ++seq) {
+        Slot& slot = slots[seq % slots.size()];
+        {
+            // A slot is free once the chunk that last used it has been consumed
+            std::unique_lock<std::mutex> lock(mutex);
+            free_cv.wait(lock, [&] { return stopping || seq < consume_seq + static_cast<int64_t>(slots.size()); });
+            if (stopping) {
+                return;
+            }
+        }
+        try {
+            read_chunk(seq, slot.batch);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+            ready_cv.notify_all();
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        slot.ready_seq = seq;
+        ready_cv.notify_all();
+    }
+}
+
+void IdxStreamLoader::read_chunk(int64_t seq, MnistBatch& batch) {
+    ScopedTimer timer(MetricTimer::Parse);
+    int n = static_cast<int>(std::min<int64_t>(chunk_samples, count() - seq * chunk_samples));
+    size_t image_bytes = static_cast<size_t>(n) * image_header.item_bytes();
+    size_t label_bytes = static_cast<size_t>(n) * label_header.item_bytes();
+    read_exact(images, raw_images.data(), image_bytes);
+    read_exact(labels, raw_labels.data(), label_bytes);
+    {
+        ScopedTimer normalize_timer(MetricTimer::Normalize);
+        idx_decode(image_header.type, raw_images.data(), static_cast<size_t>(n) * image_header.item_elements,
+                   batch.images.data(), divisor);
+    }
+    idx_decode(label_header.type, raw_labels.data(), n, batch.labels.data());
+    batch.count = n;
+    metrics_add(MetricCounter::ParsedBytes, image_bytes + label_bytes);
+}
+
+bool IdxStreamLoader::next_chunk(MnistBatch& chunk) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (consume_seq >= chunk_count) {
+        return false;
+    }
+    Slot& slot = slots[consume_seq % slots.size()];
+    if (slot.ready_seq != consume_seq && !error) {
+        // The consumer outran the disk
+        metrics_add(MetricCounter::DataWaits);
+        ScopedTimer timer(MetricTimer::DataWait);
+        ready_cv.wait(lock, [&] { return slot.ready_seq == consume_seq || error; });
+    }
+    // Chunks read before the failure are still handed out in order
+    if (slot.ready_seq != consume_seq) {
+        std::rethrow_exception(error);
+    }
+
+    // The caller's buffers go back into the ring, so they must have the slot's capacity
+    const Eigen::Index width = static_cast<Eigen::Index>(image_header.item_elements);
+    if (chunk.images.rows() != chunk_samples || chunk.images.cols() != width) {
+        chunk.images.resize(chunk_samples, width);
+        chunk.labels.resize(chunk_samples);
+    }
+    chunk.images.swap(slot.batch.images);
+    chunk.labels.swap(slot.batch.labels);
+    chunk.count = slot.batch.count;
+    metrics_add(MetricCounter::BatchesServed);
+    metrics_add(MetricCounter::SamplesServed, static_cast<uint64_t>(chunk.count));
+    slot.ready_seq = -1;
+    ++consume_seq;
+    lock.unlock();
+    free_cv.notify_all();
+    return true;
+}
+
+void IdxStreamLoader::reset() {
+    stop();
+    start();
+}
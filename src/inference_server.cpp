@@ -0,0 +1,384 @@
+#include "inference_server.h"
+#include "kernels.h"
+#include "log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr size_t kLatencyWindow = 65536;
+// Replies a connection may have queued or in flight before its reader stops taking requests
+constexpr size_t kMaxBufferedReplies = 65536;
+
+// Splits "host:port"; anything without a colon is a Unix socket path.
+// Throws for a malformed port or a host outside 127.0.0.0/8, since the server has no authentication
+bool parse_tcp_address(const std::string& address, std::string& host, int& port) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || address.find('/') != std::string::npos) {
+        return false;
+    }
+    host = address.substr(0, colon);
+    const std::string digits = address.substr(colon + 1);
+    if (digits.empty() || digits.size() > 5 || digits.find_first_not_of("0123456789") != std::string::npos ||
+        std::stoi(digits) < 1 || std::stoi(digits) > 65535) {
+        throw std::runtime_error("Invalid port in " + address + ": expected 1-65535");
+    }
+    port = std::stoi(digits);
+    in_addr ip{};
+    if (::inet_pton(AF_INET, host.c_str(), &ip) != 1) {
+        throw std::runtime_error("Invalid IPv4 address: " + host);
+    }
+    if ((ntohl(ip.s_addr) >> 24) != 127) {
+        throw std::runtime_error("Inference server only listens on loopback (127.0.0.0/8), not " + host);
+    }
+    return true;
+}
+
+std::string errno_message(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+} // anonymous namespace
+
+// The descriptor is closed only when the reader, the writer and every queued request have let go of it
+struct InferenceServer::Connection {
+    int fd;
+    std::mutex out_mutex;
+    std::condition_variable out_cv;   // replies appended, buffer space freed, or the connection closed
+    std::vector<uint8_t> pending;     // replies not yet handed to the writer
+    size_t outstanding = 0;           // requests read but not yet answered, plus replies not yet sent
+    bool reading_done = false;
+    bool closed = false;              // a send failed or the server is stopping; replies are dropped
+
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() { ::close(fd); }
+
+    // Marks the connection dead and unblocks both of its threads
+    void close_connection() {
+        {
+            std::lock_guard<std::mutex> lock(out_mutex);
+            closed = true;
+        }
+        ::shutdown(fd, SHUT_RDWR);
+        out_cv.notify_all();
+    }
+};
+
+InferenceServer::InferenceServer(const Mlp& model, const InferenceServerOptions& options)
+    : model(model), opts(options), latencies_us(kLatencyWindow, 0.0f) {
+    if (model.input_size() != image_bytes) {
+        throw std::runtime_error("Inference server needs a model with " + std::to_string(image_bytes) + " inputs");
+    }
+    opts.max_batch = std::max(opts.max_batch, 1);
+    opts.max_wait_us = std::max(opts.max_wait_us, 0);
+    opts.queue_capacity = std::max(opts.queue_capacity, opts.max_batch);
+
+    std::string host;
+    int port = 0;
+    if (parse_tcp_address(opts.address, host, port)) {
+        listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (listen_fd < 0) throw std::runtime_error(errno_message("socket() failed"));
+        int one = 1;
+        ::setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        ::inet_pton(AF_INET, host.c_str(), &addr.sin_addr); // validated by parse_tcp_address
+        if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::string message = errno_message("bind(" + opts.address + ") failed");
+            ::close(listen_fd);
+            throw std::runtime_error(message);
+        }
+    } else {
+        unix_socket = true;
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (opts.address.empty() || opts.address.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Invalid Unix socket path: " + opts.address);
+        }
+        std::strncpy(addr.sun_path, opts.address.c_str(), sizeof(addr.sun_path) - 1);
+        listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0) throw std::runtime_error(errno_message("socket() failed"));
+        ::unlink(opts.address.c_str()); // a stale socket file from an earlier run
+        if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::string message = errno_message("bind(" + opts.address + ") failed");
+            ::close(listen_fd);
+            throw std::runtime_error(message);
+        }
+    }
+    if (::listen(listen_fd, 128) != 0) {
+        std::string message = errno_message("listen() failed");
+        ::close(listen_fd);
+        throw std::runtime_error(message);
+    }
+
+    started = Clock::now();
+    batcher = std::thread(&InferenceServer::batch_loop, this);
+    acceptor = std::thread(&InferenceServer::accept_loop, this);
+    MNIST_LOG_INFO("Inference server listening on " << opts.address << " (max batch " << opts.max_batch
+                   << ", max wait " << opts.max_wait_us << " us)");
+}
+
+InferenceServer::~InferenceServer() {
+    stop();
+}
+
+void InferenceServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    space_cv.notify_all();
+    acceptor.join();
+    reap_readers(true);
+    batcher.join();
+    queue.clear();
+    ::close(listen_fd);
+    if (unix_socket) {
+        ::unlink(opts.address.c_str());
+    }
+}
+
+void InferenceServer::accept_loop() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping) return;
+        }
+        // Wake up periodically to notice stop()
+        pollfd pfd{listen_fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, 100);
+        if (ready <= 0) {
+            continue;
+        }
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        if (!unix_socket) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        reap_readers(false);
+        auto connection = std::make_shared<Connection>(fd);
+        auto done = std::make_shared<std::atomic<int>>(0);
+        std::lock_guard<std::mutex> lock(readers_mutex);
+        readers.push_back(Reader{std::thread(&InferenceServer::read_loop, this, connection, done),
+                                 std::thread(&InferenceServer::write_loop, this, connection, done), connection, done});
+    }
+}
+
+void InferenceServer::reap_readers(bool all) {
+    std::lock_guard<std::mutex> lock(readers_mutex);
+    for (auto it = readers.begin(); it != readers.end();) {
+        if (all) {
+            // Unblocks the reader's recv() and the writer; queued replies to this client are dropped
+            it->connection->close_connection();
+        }
+        if (all || it->done->load() == 2) {
+            it->thread.join();
+            it->writer.join();
+            it = readers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void InferenceServer::read_loop(std::shared_ptr<Connection> connection, std::shared_ptr<std::atomic<int>> done) {
+    std::array<uint8_t, image_bytes> image;
+    size_t filled = 0;
+    while (true) {
+        ssize_t n = ::recv(connection->fd, image.data() + filled, image_bytes - filled, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        filled += static_cast<size_t>(n);
+        if (filled < image_bytes) {
+            continue;
+        }
+        filled = 0;
+        {
+            // A client that stops reading its replies stalls here, and only its own connection stalls
+            std::unique_lock<std::mutex> out_lock(connection->out_mutex);
+            connection->out_cv.wait(out_lock, [&] {
+                return connection->closed || connection->outstanding < kMaxBufferedReplies;
+            });
+            if (connection->closed) {
+                break;
+            }
+            ++connection->outstanding;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        space_cv.wait(lock, [this] { return stopping || static_cast<int>(queue.size()) < opts.queue_capacity; });
+        if (stopping) {
+            break;
+        }
+        queue.push_back(Request{connection, image, Clock::now()});
+        if (static_cast<int>(queue.size()) == 1 || static_cast<int>(queue.size()) >= opts.max_batch) {
+            queue_cv.notify_one();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(connection->out_mutex);
+        connection->reading_done = true;
+    }
+    connection->out_cv.notify_all();
+    done->fetch_add(1);
+}
+
+void InferenceServer::write_loop(std::shared_ptr<Connection> connection, std::shared_ptr<std::atomic<int>> done) {
+    std::vector<uint8_t> sending;
+    std::unique_lock<std::mutex> lock(connection->out_mutex);
+    while (true) {
+        // Runs until every request the reader took has been answered, so a half-closed client still gets its replies
+        connection->out_cv.wait(lock, [&] {
+            return connection->closed || !connection->pending.empty() ||
+                   (connection->reading_done && connection->outstanding == 0);
+        });
+        if (connection->closed || connection->pending.empty()) {
+            break;
+        }
+        sending.swap(connection->pending);
+        lock.unlock();
+
+        size_t sent = 0;
+        bool failed = false;
+        while (sent < sending.size()) {
+            ssize_t n = ::send(connection->fd, sending.data() + sent, sending.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                failed = true;
+                break;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        if (failed) {
+            // Later replies would no longer line up with their requests, so the connection ends here.
+            // A connection already closed by stop() is not worth a warning
+            const std::string message = errno_message("Inference reply send failed; closing the connection");
+            lock.lock();
+            const bool was_closed = connection->closed;
+            lock.unlock();
+            if (!was_closed) {
+                MNIST_LOG_WARN(message);
+            }
+            connection->close_connection();
+            lock.lock();
+            break;
+        }
+        lock.lock();
+        connection->outstanding -= sending.size();
+        sending.clear();
+        connection->out_cv.notify_all();
+    }
+    lock.unlock();
+    done->fetch_add(1);
+}
+
+void InferenceServer::batch_loop() {
+    const int max_batch = opts.max_batch;
+    RowMatrixXf images(max_batch, image_bytes);
+    MlpWorkspace workspace(model.layout(), max_batch);
+    std::vector<int> predictions(max_batch);
+    std::vector<Request> batch;
+    batch.reserve(max_batch);
+    const float divisor = opts.normalize ? 255.0f : 1.0f;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queue_cv.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (stopping) {
+            return;
+        }
+        // The oldest request sets the deadline; a full batch goes out immediately
+        auto deadline = queue.front().arrival + std::chrono::microseconds(opts.max_wait_us);
+        queue_cv.wait_until(lock, deadline, [&] { return stopping || static_cast<int>(queue.size()) >= max_batch; });
+        if (stopping) {
+            return;
+        }
+        int count = std::min(max_batch, static_cast<int>(queue.size()));
+        for (int i = 0; i < count; ++i) {
+            batch.push_back(std::move(queue.front()));
+            queue.pop_front();
+        }
+        lock.unlock();
+        space_cv.notify_all();
+
+        for (int i = 0; i < count; ++i) {
+            u8_to_f32(batch[i].image.data(), images.row(i).data(), image_bytes, divisor);
+        }
+        model.predict(images.data(), count, predictions.data(), workspace);
+
+        // Requests from one connection are consecutive in arrival order, so each run is one append;
+        // the connection's writer sends it, and a client that went away is not an error for the others
+        for (int i = 0; i < count;) {
+            Connection& connection = *batch[i].connection;
+            int j = i;
+            {
+                std::lock_guard<std::mutex> out_lock(connection.out_mutex);
+                while (j < count && batch[j].connection == batch[i].connection) {
+                    if (!connection.closed) {
+                        connection.pending.push_back(static_cast<uint8_t>(predictions[j]));
+                    }
+                    ++j;
+                }
+            }
+            connection.out_cv.notify_all();
+            i = j;
+        }
+        auto now = Clock::now();
+
+        lock.lock();
+        for (int i = 0; i < count; ++i) {
+            latencies_us[latency_next] = std::chrono::duration<float, std::micro>(now - batch[i].arrival).count();
+            latency_next = (latency_next + 1) % kLatencyWindow;
+        }
+        total_requests += count;
+        total_batches += 1;
+        batch.clear();
+    }
+}
+
+InferenceStats InferenceServer::stats() const {
+    InferenceStats s;
+    std::vector<float> window;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        s.requests = total_requests;
+        s.batches = total_batches;
+        size_t n = std::min<uint64_t>(total_requests, kLatencyWindow);
+        window.assign(latencies_us.begin(), latencies_us.begin() + n);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - started).count();
+    s.mean_batch = s.batches > 0 ? static_cast<double>(s.requests) / s.batches : 0.0;
+    s.requests_per_sec = seconds > 0.0 ? s.requests / seconds : 0.0;
+    if (!window.empty()) {
+        auto percentile = [&](double p) {
+            size_t k = std::min(window.size() - 1, static_cast<size_t>(p * (window.size() - 1) + 0.5));
+            std::nth_element(window.begin(), window.begin() + k, window.end());
+            return static_cast<double>(window[k]);
+        };
+        s.p50_us = percentile(0.50);
+        s.p99_us = percentile(0.99);
+    }
+    return s;
+}
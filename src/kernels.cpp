@@ -0,0 +1,455 @@
+#include "kernels.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MNIST_X86 1
+#endif
+
+namespace {
+
+// Source rows of a gather are visited in random order, so the next one is fetched ahead
+constexpr int kPrefetchDistance = 2;
+
+inline void prefetch_row(const void* row, size_t bytes) {
+    const char* p = static_cast<const char*>(row);
+    for (size_t offset = 0; offset < bytes; offset += 64) {
+        __builtin_prefetch(p + offset);
+    }
+}
+
+// --- Scalar ---
+
+void u8_to_f32_scalar(const uint8_t* src, float* dst, size_t n, float divisor) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = src[i] / divisor;
+    }
+}
+
+void gather_f32_scalar(const float* src, size_t row_size, const int* indices, int count, float* dst) {
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchDistance < count) {
+            prefetch_row(src + static_cast<size_t>(indices[i + kPrefetchDistance]) * row_size, row_size * sizeof(float));
+        }
+        std::memcpy(dst + static_cast<size_t>(i) * row_size, src + static_cast<size_t>(indices[i]) * row_size,
+                    row_size * sizeof(float));
+    }
+}
+
+void gather_u8_scalar(const uint8_t* src, size_t row_size, const int* indices, int count, float* dst, float divisor) {
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchDistance < count) {
+            prefetch_row(src + static_cast<size_t>(indices[i + kPrefetchDistance]) * row_size, row_size);
+        }
+        u8_to_f32_scalar(src + static_cast<size_t>(indices[i]) * row_size, dst + static_cast<size_t>(i) * row_size,
+                         row_size, divisor);
+    }
+}
+
+// First index of the row maximum
+inline int argmax_row_scalar(const float* row, int cols) {
+    int best = 0;
+    for (int j = 1; j < cols; ++j) {
+        if (row[j] > row[best]) best = j;
+    }
+    return best;
+}
+
+// Kept out of line: inlined into the target("sse4.1") caller, GCC unrolls the narrow-row
+// loop into a chain of unpredictable branches instead of the cmov loop below
+__attribute__((noinline)) void argmax_scalar(const float* x, int rows, int cols, int* out) {
+    for (int r = 0; r < rows; ++r) {
+        out[r] = argmax_row_scalar(x + static_cast<size_t>(r) * cols, cols);
+    }
+}
+
+// Coordinates are clamped to one pixel beyond the image, so every corner index fits an int
+// and any corner outside the image reads as 0
+constexpr float kSampleMargin = 2.0f;
+
+inline float pixel_or_zero(const float* src, int rows, int cols, int y, int x) {
+    return y >= 0 && y < rows && x >= 0 && x < cols ? src[y * cols + x] : 0.0f;
+}
+
+// The vector versions evaluate exactly these operations in this order, so all levels agree bit for bit
+void bilinear_scalar(const float* src, int rows, int cols, const float* xs, const float* ys, float* dst, int n) {
+    const float max_x = cols + kSampleMargin, max_y = rows + kSampleMargin;
+    for (int i = 0; i < n; ++i) {
+        float x = std::min(std::max(xs[i], -kSampleMargin), max_x);
+        float y = std::min(std::max(ys[i], -kSampleMargin), max_y);
+        float x0 = std::floor(x), y0 = std::floor(y);
+        float fx = x - x0, fy = y - y0;
+        int ix = static_cast<int>(x0), iy = static_cast<int>(y0);
+        float v00 = pixel_or_zero(src, rows, cols, iy, ix), v01 = pixel_or_zero(src, rows, cols, iy, ix + 1);
+        float v10 = pixel_or_zero(src, rows, cols, iy + 1, ix), v11 = pixel_or_zero(src, rows, cols, iy + 1, ix + 1);
+        float top = v00 + fx * (v01 - v00);
+        float bottom = v10 + fx * (v11 - v10);
+        dst[i] = top + fy * (bottom - top);
+    }
+}
+
+#ifdef MNIST_X86
+
+// --- SSE4.1 ---
+
+#define MNIST_SSE4 __attribute__((target("sse4.1")))
+
+MNIST_SSE4 void u8_to_f32_sse4(const uint8_t* src, float* dst, size_t n, float divisor) {
+    const __m128 vdivisor = _mm_set1_ps(divisor);
+    size_t i = 0;
+    // 16 pixels per iteration, each group of 4 zero-extended straight to int32 by pmovzxbd
+    for (; i + 16 <= n; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128 f0 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(bytes));
+        __m128 f1 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 4)));
+        __m128 f2 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+        __m128 f3 = _mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(bytes, 12)));
+        _mm_storeu_ps(dst + i, _mm_div_ps(f0, vdivisor));
+        _mm_storeu_ps(dst + i + 4, _mm_div_ps(f1, vdivisor));
+        _mm_storeu_ps(dst + i + 8, _mm_div_ps(f2, vdivisor));
+        _mm_storeu_ps(dst + i + 12, _mm_div_ps(f3, vdivisor));
+    }
+    for (; i < n; ++i) {
+        dst[i] = src[i] / divisor;
+    }
+}
+
+MNIST_SSE4 void gather_u8_sse4(const uint8_t* src, size_t row_size, const int* indices, int count, float* dst,
+                               float divisor) {
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchDistance < count) {
+            prefetch_row(src + static_cast<size_t>(indices[i + kPrefetchDistance]) * row_size, row_size);
+        }
+        u8_to_f32_sse4(src + static_cast<size_t>(indices[i]) * row_size, dst + static_cast<size_t>(i) * row_size,
+                       row_size, divisor);
+    }
+}
+
+// Vector maximum over the row, then the first lane that equals it. The second pass only
+// pays off on wide rows; narrower matrices (MNIST's 10 logits) go to argmax_scalar
+MNIST_SSE4 void argmax_sse4(const float* x, int rows, int cols, int* out) {
+    if (cols < 16) {
+        argmax_scalar(x, rows, cols, out);
+        return;
+    }
+    for (int r = 0; r < rows; ++r) {
+        const float* row = x + static_cast<size_t>(r) * cols;
+        __m128 vmax = _mm_loadu_ps(row);
+        int j = 4;
+        for (; j + 4 <= cols; j += 4) vmax = _mm_max_ps(vmax, _mm_loadu_ps(row + j));
+        vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+        vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+        float best = _mm_cvtss_f32(vmax);
+        for (; j < cols; ++j) best = row[j] > best ? row[j] : best;
+        const __m128 target = _mm_set1_ps(best);
+        int index = -1;
+        for (j = 0; j + 4 <= cols && index < 0; j += 4) {
+            int mask = _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(row + j), target));
+            if (mask) index = j + __builtin_ctz(mask);
+        }
+        for (; index < 0; ++j) {
+            if (row[j] == best) index = j;
+        }
+        out[r] = index;
+    }
+}
+
+// --- AVX2 ---
+
+#define MNIST_AVX2 __attribute__((target("avx2")))
+
+MNIST_AVX2 void u8_to_f32_avx2(const uint8_t* src, float* dst, size_t n, float divisor) {
+    const __m256 vdivisor = _mm256_set1_ps(divisor);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        for (int k = 0; k < 4; ++k) {
+            __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i + 8 * k));
+            __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes));
+            _mm256_storeu_ps(dst + i + 8 * k, _mm256_div_ps(f, vdivisor));
+        }
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)), vdivisor));
+    }
+    for (; i < n; ++i) {
+        dst[i] = src[i] / divisor;
+    }
+}
+
+MNIST_AVX2 void gather_u8_avx2(const uint8_t* src, size_t row_size, const int* indices, int count, float* dst,
+                               float divisor) {
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchDistance < count) {
+            prefetch_row(src + static_cast<size_t>(indices[i + kPrefetchDistance]) * row_size, row_size);
+        }
+        u8_to_f32_avx2(src + static_cast<size_t>(indices[i]) * row_size, dst + static_cast<size_t>(i) * row_size,
+                       row_size, divisor);
+    }
+}
+
+MNIST_AVX2 void argmax_avx2(const float* x, int rows, int cols, int* out) {
+    if (cols < 32) {
+        argmax_scalar(x, rows, cols, out);
+        return;
+    }
+    for (int r = 0; r < rows; ++r) {
+        const float* row = x + static_cast<size_t>(r) * cols;
+        __m256 vmax = _mm256_loadu_ps(row);
+        int j = 8;
+        for (; j + 8 <= cols; j += 8) vmax = _mm256_max_ps(vmax, _mm256_loadu_ps(row + j));
+        __m128 half = _mm_max_ps(_mm256_castps256_ps128(vmax), _mm256_extractf128_ps(vmax, 1));
+        half = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(1, 0, 3, 2)));
+        half = _mm_max_ps(half, _mm_shuffle_ps(half, half, _MM_SHUFFLE(2, 3, 0, 1)));
+        float best = _mm_cvtss_f32(half);
+        for (; j < cols; ++j) best = row[j] > best ? row[j] : best;
+        const __m256 target = _mm256_set1_ps(best);
+        int index = -1;
+        for (j = 0; j + 8 <= cols && index < 0; j += 8) {
+            int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(row + j), target, _CMP_EQ_OQ));
+            if (mask) index = j + __builtin_ctz(mask);
+        }
+        for (; index < 0; ++j) {
+            if (row[j] == best) index = j;
+        }
+        out[r] = index;
+    }
+}
+
+// Four masked gathers per 8 points; corners outside the image keep the zero pass-through.
+// SSE4.1 has no gather and gains nothing over the scalar loop
+MNIST_AVX2 void bilinear_avx2(const float* src, int rows, int cols, const float* xs, const float* ys, float* dst,
+                              int n) {
+    const __m256 lo = _mm256_set1_ps(-kSampleMargin);
+    const __m256 hi_x = _mm256_set1_ps(cols + kSampleMargin), hi_y = _mm256_set1_ps(rows + kSampleMargin);
+    const __m256i vcols = _mm256_set1_epi32(cols), vrows = _mm256_set1_epi32(rows);
+    const __m256i minus_one = _mm256_set1_epi32(-1), one = _mm256_set1_epi32(1);
+    const __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(xs + i), lo), hi_x);
+        __m256 y = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(ys + i), lo), hi_y);
+        __m256 x0 = _mm256_floor_ps(x), y0 = _mm256_floor_ps(y);
+        __m256 fx = _mm256_sub_ps(x, x0), fy = _mm256_sub_ps(y, y0);
+        __m256i ix = _mm256_cvttps_epi32(x0), iy = _mm256_cvttps_epi32(y0);
+        __m256i ix1 = _mm256_add_epi32(ix, one), iy1 = _mm256_add_epi32(iy, one);
+        // 0 <= v < limit as two signed compares
+        __m256i in_x0 = _mm256_and_si256(_mm256_cmpgt_epi32(ix, minus_one), _mm256_cmpgt_epi32(vcols, ix));
+        __m256i in_x1 = _mm256_and_si256(_mm256_cmpgt_epi32(ix1, minus_one), _mm256_cmpgt_epi32(vcols, ix1));
+        __m256i in_y0 = _mm256_and_si256(_mm256_cmpgt_epi32(iy, minus_one), _mm256_cmpgt_epi32(vrows, iy));
+        __m256i in_y1 = _mm256_and_si256(_mm256_cmpgt_epi32(iy1, minus_one), _mm256_cmpgt_epi32(vrows, iy1));
+        __m256i base = _mm256_add_epi32(_mm256_mullo_epi32(iy, vcols), ix);
+        __m256i below = _mm256_add_epi32(base, vcols);
+        __m256 v00 = _mm256_mask_i32gather_ps(zero, src, base, _mm256_castsi256_ps(_mm256_and_si256(in_y0, in_x0)), 4);
+        __m256 v01 = _mm256_mask_i32gather_ps(zero, src, _mm256_add_epi32(base, one),
+                                              _mm256_castsi256_ps(_mm256_and_si256(in_y0, in_x1)), 4);
+        __m256 v10 = _mm256_mask_i32gather_ps(zero, src, below, _mm256_castsi256_ps(_mm256_and_si256(in_y1, in_x0)), 4);
+        __m256 v11 = _mm256_mask_i32gather_ps(zero, src, _mm256_add_epi32(below, one),
+                                              _mm256_castsi256_ps(_mm256_and_si256(in_y1, in_x1)), 4);
+        __m256 top = _mm256_add_ps(v00, _mm256_mul_ps(fx, _mm256_sub_ps(v01, v00)));
+        __m256 bottom = _mm256_add_ps(v10, _mm256_mul_ps(fx, _mm256_sub_ps(v11, v10)));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(top, _mm256_mul_ps(fy, _mm256_sub_ps(bottom, top))));
+    }
+    bilinear_scalar(src, rows, cols, xs + i, ys + i, dst + i, n - i);
+}
+
+// --- AVX-512 ---
+
+// GCC 12 reports the deliberately undefined pass-through operands inside its own
+// AVX-512 intrinsic headers as maybe-uninitialized
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+#define MNIST_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl")))
+
+MNIST_AVX512 void u8_to_f32_avx512(const uint8_t* src, float* dst, size_t n, float divisor) {
+    const __m512 vdivisor = _mm512_set1_ps(divisor);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        for (int k = 0; k < 4; ++k) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 16 * k));
+            __m512 f = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(bytes));
+            _mm512_storeu_ps(dst + i + 16 * k, _mm512_div_ps(f, vdivisor));
+        }
+    }
+    // The remainder (784 = 12 * 64 + 16) runs under a mask instead of a scalar loop
+    for (; i < n; i += 16) {
+        size_t left = n - i < 16 ? n - i : 16;
+        __mmask16 mask = static_cast<__mmask16>((1u << left) - 1);
+        __m128i bytes = _mm_maskz_loadu_epi8(mask, src + i);
+        __m512 f = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(bytes));
+        _mm512_mask_storeu_ps(dst + i, mask, _mm512_div_ps(f, vdivisor));
+    }
+}
+
+MNIST_AVX512 void copy_f32_avx512(const float* src, float* dst, size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512 a = _mm512_loadu_ps(src + i);
+        __m512 b = _mm512_loadu_ps(src + i + 16);
+        __m512 c = _mm512_loadu_ps(src + i + 32);
+        __m512 d = _mm512_loadu_ps(src + i + 48);
+        _mm512_storeu_ps(dst + i, a);
+        _mm512_storeu_ps(dst + i + 16, b);
+        _mm512_storeu_ps(dst + i + 32, c);
+        _mm512_storeu_ps(dst + i + 48, d);
+    }
+    for (; i < n; i += 16) {
+        size_t left = n - i < 16 ? n - i : 16;
+        __mmask16 mask = static_cast<__mmask16>((1u << left) - 1);
+        _mm512_mask_storeu_ps(dst + i, mask, _mm512_maskz_loadu_ps(mask, src + i));
+    }
+}
+
+MNIST_AVX512 void gather_f32_avx512(const float* src, size_t row_size, const int* indices, int count, float* dst) {
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchDistance < count) {
+            prefetch_row(src + static_cast<size_t>(indices[i + kPrefetchDistance]) * row_size, row_size * sizeof(float));
+        }
+        copy_f32_avx512(src + static_cast<size_t>(indices[i]) * row_size, dst + static_cast<size_t>(i) * row_size,
+                        row_size);
+    }
+}
+
+MNIST_AVX512 void gather_u8_avx512(const uint8_t* src, size_t row_size, const int* indices, int count, float* dst,
+                                   float divisor) {
+    for (int i = 0; i < count; ++i) {
+        if (i + kPrefetchDistance < count) {
+            prefetch_row(src + static_cast<size_t>(indices[i + kPrefetchDistance]) * row_size, row_size);
+        }
+        u8_to_f32_avx512(src + static_cast<size_t>(indices[i]) * row_size, dst + static_cast<size_t>(i) * row_size,
+                         row_size, divisor);
+    }
+}
+
+// Rows of up to 16 (MNIST's 10 classes) are one masked load
+MNIST_AVX512 void argmax_avx512(const float* x, int rows, int cols, int* out) {
+    if (cols > 16) {
+        argmax_avx2(x, rows, cols, out);
+        return;
+    }
+    const __mmask16 mask = static_cast<__mmask16>((1u << cols) - 1);
+    const __m512 lowest = _mm512_set1_ps(-__builtin_inff());
+    for (int r = 0; r < rows; ++r) {
+        __m512 v = _mm512_mask_loadu_ps(lowest, mask, x + static_cast<size_t>(r) * cols);
+        float best = _mm512_reduce_max_ps(v);
+        __mmask16 hits = _mm512_mask_cmp_ps_mask(mask, v, _mm512_set1_ps(best), _CMP_EQ_OQ);
+        out[r] = hits ? __builtin_ctz(hits) : 0;
+    }
+}
+
+#pragma GCC diagnostic pop
+
+#endif // MNIST_X86
+
+struct KernelTable {
+    void (*u8_to_f32)(const uint8_t*, float*, size_t, float);
+    void (*gather_f32)(const float*, size_t, const int*, int, float*);
+    void (*gather_u8)(const uint8_t*, size_t, const int*, int, float*, float);
+    void (*argmax)(const float*, int, int, int*);
+    void (*bilinear)(const float*, int, int, const float*, const float*, float*, int);
+};
+
+const KernelTable scalar_table = {u8_to_f32_scalar, gather_f32_scalar, gather_u8_scalar, argmax_scalar,
+                                  bilinear_scalar};
+#ifdef MNIST_X86
+// A float row is a plain 3 KB copy: libc's memcpy (itself CPU-dispatched) beats 16- and 32-byte
+// loops there, so only AVX-512, with its masked tail, has its own row copy
+const KernelTable sse4_table = {u8_to_f32_sse4, gather_f32_scalar, gather_u8_sse4, argmax_sse4, bilinear_scalar};
+const KernelTable avx2_table = {u8_to_f32_avx2, gather_f32_scalar, gather_u8_avx2, argmax_avx2, bilinear_avx2};
+const KernelTable avx512_table = {u8_to_f32_avx512, gather_f32_avx512, gather_u8_avx512, argmax_avx512,
+                                  bilinear_avx2};
+#endif
+
+const KernelTable& table_for(SimdLevel level) {
+    switch (level) {
+#ifdef MNIST_X86
+    case SimdLevel::Sse4: return sse4_table;
+    case SimdLevel::Avx2: return avx2_table;
+    case SimdLevel::Avx512: return avx512_table;
+#endif
+    default: return scalar_table;
+    }
+}
+
+SimdLevel detect() {
+#ifdef MNIST_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) {
+        return SimdLevel::Avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+    if (__builtin_cpu_supports("sse4.1")) return SimdLevel::Sse4;
+#endif
+    return SimdLevel::Scalar;
+}
+
+struct Dispatch {
+    SimdLevel detected = detect();
+    std::atomic<SimdLevel> level{detected};
+    std::atomic<const KernelTable*> table{&table_for(detected)};
+};
+
+// CPUID runs once, on first use, so static initialization order does not matter
+Dispatch& dispatch() {
+    static Dispatch d;
+    return d;
+}
+
+inline const KernelTable& kernels() {
+    return *dispatch().table.load(std::memory_order_relaxed);
+}
+
+} // anonymous namespace
+
+SimdLevel detected_simd_level() {
+    return dispatch().detected;
+}
+
+SimdLevel simd_level() {
+    return dispatch().level.load(std::memory_order_relaxed);
+}
+
+void set_simd_level(SimdLevel level) {
+    Dispatch& d = dispatch();
+    if (static_cast<int>(level) > static_cast<int>(d.detected)) {
+        throw std::runtime_error(std::string("SIMD level not supported on this CPU: ") + simd_level_name(level));
+    }
+    d.table.store(&table_for(level), std::memory_order_relaxed);
+    d.level.store(level, std::memory_order_relaxed);
+}
+
+const char* simd_level_name(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar: return "scalar";
+    case SimdLevel::Sse4: return "sse4.1";
+    case SimdLevel::Avx2: return "avx2";
+    case SimdLevel::Avx512: return "avx512";
+    }
+    return "unknown";
+}
+
+void u8_to_f32(const uint8_t* src, float* dst, size_t n, float divisor) {
+    kernels().u8_to_f32(src, dst, n, divisor);
+}
+
+void gather_rows_f32(const float* src, size_t row_size, const int* indices, int count, float* dst) {
+    kernels().gather_f32(src, row_size, indices, count, dst);
+}
+
+void gather_rows_u8_to_f32(const uint8_t* src, size_t row_size, const int* indices, int count, float* dst,
+                           float divisor) {
+    kernels().gather_u8(src, row_size, indices, count, dst, divisor);
+}
+
+void argmax_rows(const float* x, int rows, int cols, int* out) {
+    kernels().argmax(x, rows, cols, out);
+}
+
+void bilinear_sample(const float* src, int rows, int cols, const float* xs, const float* ys, float* dst, int n) {
+    kernels().bilinear(src, rows, cols, xs, ys, dst, n);
+}
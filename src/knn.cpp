@@ -0,0 +1,195 @@
+#include "knn.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+KnnClassifier::KnnClassifier(const MnistData& data, const KnnOptions& options)
+    : data(data), neighbors(options.centroids ? 1 : options.k), query_block(options.query_block),
+      reference_block(options.reference_block), features(data.rows * data.cols), num_classes(0), reference_count(0),
+      team(options.num_threads) {
+    if (options.k <= 0 || query_block <= 0 || reference_block <= 0) {
+        throw std::runtime_error("k-NN needs positive k, query_block and reference_block");
+    }
+    if (data.train_count == 0) {
+        throw std::runtime_error("k-NN needs a non-empty training split");
+    }
+    if (data.train_labels.minCoeff() < 0) {
+        throw std::runtime_error("k-NN training labels must be non-negative");
+    }
+    num_classes = data.train_labels.maxCoeff() + 1;
+
+    // One pass over the training images in blocks, widened to float like every later use of them
+    RowMatrixXf rows(reference_block, features);
+    Eigen::MatrixXd sums;
+    std::vector<int64_t> class_counts;
+    if (options.centroids) {
+        sums.setZero(num_classes, features);
+        class_counts.assign(num_classes, 0);
+    } else {
+        reference_count = data.train_count;
+        reference_labels.assign(data.train_labels.data(), data.train_labels.data() + data.train_count);
+        reference_norms.resize(reference_count);
+    }
+    for (int begin = 0; begin < data.train_count; begin += reference_block) {
+        const int count = std::min(reference_block, data.train_count - begin);
+        copy_images(data, MnistSplit::Train, begin, count, rows.data());
+        for (int i = 0; i < count; ++i) {
+            if (options.centroids) {
+                const int label = data.train_labels[begin + i];
+                sums.row(label) += rows.row(i).cast<double>();
+                ++class_counts[label];
+            } else {
+                reference_norms[begin + i] = rows.row(i).squaredNorm();
+            }
+        }
+    }
+    if (options.centroids) {
+        // Classes without samples get no centroid rather than a zero image that could win
+        for (int c = 0; c < num_classes; ++c) {
+            if (class_counts[c] > 0) {
+                reference_labels.push_back(c);
+            }
+        }
+        reference_count = static_cast<int>(reference_labels.size());
+        centroid_images.resize(reference_count, features);
+        reference_norms.resize(reference_count);
+        for (int r = 0; r < reference_count; ++r) {
+            const int c = reference_labels[r];
+            centroid_images.row(r) = (sums.row(c) / static_cast<double>(class_counts[c])).cast<float>();
+            reference_norms[r] = centroid_images.row(r).squaredNorm();
+        }
+    }
+
+    replicas.resize(team.size());
+    for (auto& replica : replicas) {
+        // Float storage is read in place, so only uint8 storage needs conversion buffers
+        if (data.storage == MnistStorage::Uint8) {
+            replica.queries.resize(query_block, features);
+            if (!options.centroids) {
+                replica.references.resize(reference_block, features);
+            }
+        }
+        replica.scores.resize(query_block, reference_block);
+        replica.best_distances.resize(static_cast<size_t>(query_block) * neighbors);
+        replica.best_indices.resize(static_cast<size_t>(query_block) * neighbors);
+        replica.votes.resize(num_classes);
+    }
+    shards.assign(team.size(), EvalShard(num_classes, query_block));
+}
+
+const float* KnnClassifier::reference_rows(Replica& replica, int begin, int count) const {
+    if (centroid_images.size() > 0) {
+        return centroid_images.data() + static_cast<size_t>(begin) * features;
+    }
+    if (data.storage == MnistStorage::Float) {
+        return data.image_data(MnistSplit::Train) + static_cast<size_t>(begin) * features;
+    }
+    copy_images(data, MnistSplit::Train, begin, count, replica.references.data());
+    return replica.references.data();
+}
+
+void KnnClassifier::search_block(Replica& replica, const float* queries, int count) {
+    const int k = neighbors;
+    float* best_distances = replica.best_distances.data();
+    int* best_indices = replica.best_indices.data();
+    std::fill(best_distances, best_distances + static_cast<size_t>(count) * k, std::numeric_limits<float>::infinity());
+    std::fill(best_indices, best_indices + static_cast<size_t>(count) * k, -1);
+
+    Eigen::Map<const RowMatrixXf> q(queries, count, features);
+    for (int begin = 0; begin < reference_count; begin += reference_block) {
+        const int n = std::min(reference_block, reference_count - begin);
+        Eigen::Map<const RowMatrixXf> r(reference_rows(replica, begin, n), n, features);
+        // The block of q.r products stays in cache while every query scans its row of it
+        Eigen::Map<RowMatrixXf> scores(replica.scores.data(), count, n);
+        scores.noalias() = q * r.transpose();
+        const float* norms = reference_norms.data() + begin;
+        for (int i = 0; i < count; ++i) {
+            const float* row = scores.data() + static_cast<size_t>(i) * n;
+            float* dist = best_distances + static_cast<size_t>(i) * k;
+            int* index = best_indices + static_cast<size_t>(i) * k;
+            float worst = dist[k - 1];
+            for (int j = 0; j < n; ++j) {
+                // ||q||² is the same for every reference, so it is left out of the ranking
+                const float d = norms[j] - 2.0f * row[j];
+                if (d < worst) {
+                    // Insertion into the sorted k best; equal distances keep the earlier reference first
+                    int pos = k - 1;
+                    while (pos > 0 && dist[pos - 1] > d) {
+                        dist[pos] = dist[pos - 1];
+                        index[pos] = index[pos - 1];
+                        --pos;
+                    }
+                    dist[pos] = d;
+                    index[pos] = begin + j;
+                    worst = dist[k - 1];
+                }
+            }
+        }
+    }
+}
+
+int KnnClassifier::vote(Replica& replica, int query) const {
+    const int* index = replica.best_indices.data() + static_cast<size_t>(query) * neighbors;
+    std::fill(replica.votes.begin(), replica.votes.end(), 0);
+    for (int n = 0; n < neighbors && index[n] >= 0; ++n) {
+        ++replica.votes[reference_labels[index[n]]];
+    }
+    // Walking the neighbours nearest first, a tie goes to the class of the nearest one
+    int best_label = 0, best_votes = 0;
+    for (int n = 0; n < neighbors && index[n] >= 0; ++n) {
+        const int label = reference_labels[index[n]];
+        if (replica.votes[label] > best_votes) {
+            best_votes = replica.votes[label];
+            best_label = label;
+        }
+    }
+    return best_label;
+}
+
+void KnnClassifier::search(const float* queries, int count, int* out_indices) {
+    auto task = [&](int thread_index) {
+        Replica& replica = replicas[thread_index];
+        const int end = thread_range_begin(count, thread_index + 1, team.size());
+        for (int start = thread_range_begin(count, thread_index, team.size()); start < end; start += query_block) {
+            const int n = std::min(query_block, end - start);
+            search_block(replica, queries + static_cast<size_t>(start) * features, n);
+            std::copy_n(replica.best_indices.data(), static_cast<size_t>(n) * neighbors,
+                        out_indices + static_cast<size_t>(start) * neighbors);
+        }
+    };
+    team.run(task);
+}
+
+void KnnClassifier::predict(const float* queries, int count, int* out_labels) {
+    auto task = [&](int thread_index) {
+        Replica& replica = replicas[thread_index];
+        const int end = thread_range_begin(count, thread_index + 1, team.size());
+        for (int start = thread_range_begin(count, thread_index, team.size()); start < end; start += query_block) {
+            const int n = std::min(query_block, end - start);
+            search_block(replica, queries + static_cast<size_t>(start) * features, n);
+            for (int i = 0; i < n; ++i) {
+                out_labels[start + i] = vote(replica, i);
+            }
+        }
+    };
+    team.run(task);
+}
+
+EvalReport KnnClassifier::evaluate(MnistSplit split) {
+    return evaluate_classifier(team, shards, data, split, num_classes, query_block, "the training set's",
+                               [&](int thread_index, int start, int count, int* predictions) {
+        Replica& replica = replicas[thread_index];
+        const float* x;
+        if (data.storage == MnistStorage::Float) {
+            x = data.image_data(split) + static_cast<size_t>(start) * features;
+        } else {
+            copy_images(data, split, start, count, replica.queries.data());
+            x = replica.queries.data();
+        }
+        search_block(replica, x, count);
+        for (int i = 0; i < count; ++i) {
+            predictions[i] = vote(replica, i);
+        }
+    });
+}
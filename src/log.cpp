@@ -0,0 +1,40 @@
+#include "log.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+LogLevel initial_level() {
+    const char* env = std::getenv("MNIST_LOG_LEVEL");
+    if (env == nullptr) return LogLevel::Info;
+    if (std::strcmp(env, "silent") == 0) return LogLevel::Silent;
+    if (std::strcmp(env, "warning") == 0) return LogLevel::Warning;
+    if (std::strcmp(env, "debug") == 0) return LogLevel::Debug;
+    return LogLevel::Info;
+}
+
+std::atomic<int>& level_storage() {
+    static std::atomic<int> level{static_cast<int>(initial_level())};
+    return level;
+}
+
+} // anonymous namespace
+
+void set_log_level(LogLevel level) {
+    level_storage().store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel log_level() {
+    return static_cast<LogLevel>(level_storage().load(std::memory_order_relaxed));
+}
+
+bool log_enabled(LogLevel level) {
+    return level != LogLevel::Silent && static_cast<int>(level) <= level_storage().load(std::memory_order_relaxed);
+}
+
+void log_write(LogLevel level, const std::string& line) {
+    std::ostream& out = level == LogLevel::Warning ? std::cerr : std::cout;
+    out.write(line.data(), static_cast<std::streamsize>(line.size()));
+}
@@ -1,30 +1,219 @@
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <string>
 #include "math.hpp"
+#include "mlp.h"
+#include "parallel_trainer.h"
 #include "mnist_loader.h"
+#include "mnist_manifest.h"
+#include "evaluator.h"
+#include "checkpoint.h"
+#include "inference_server.h"
+#include "log.h"
+#include "metrics.h"
 
-int main() {
+namespace {
+
+struct TrainArgs {
+    int epochs = 5;
+    int batch_size = 100;
+    int hidden = 100;
+    int threads = 1;
+    OptimizerConfig optimizer;
+    uint64_t seed = 42;
+    InferenceServerOptions serve; // address为空时不启动推理服务器
+    std::string metrics_path;     // 非空时在退出前写入指标（.json为JSON，否则为Prometheus文本）
+    bool verify_data = false;     // 训练的同时在后台按清单完整校验数据文件
+    std::string checkpoint_path;  // 非空时每轮结束后在后台写入检查点
+    std::string load_checkpoint;  // 非空时映射该检查点作为模型，不训练
+};
+
+LogLevel parse_log_level(const std::string& name) {
+    if (name == "silent") return LogLevel::Silent;
+    if (name == "warning") return LogLevel::Warning;
+    if (name == "info") return LogLevel::Info;
+    if (name == "debug") return LogLevel::Debug;
+    throw std::runtime_error("Unknown log level: " + name);
+}
+
+void write_metrics(const std::string& path) {
+    MetricsSnapshot snapshot = metrics_snapshot();
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    write_metrics_file(path, json ? metrics_json(snapshot) + "\n" : metrics_prometheus(snapshot));
+}
+
+void print_usage(const char* prog) {
+    std::cerr << "Usage: " << prog
+              << " [--epochs N] [--batch N] [--hidden N] [--optimizer sgd|momentum|adam] [--lr X] [--seed N] [--threads N]\n"
+              << "       [--serve ADDRESS] [--max-batch N] [--max-wait-us N]   训练后在Unix套接字或127.0.0.1:端口上提供推理服务\n"
+              << "       [--log-level silent|warning|info|debug] [--metrics FILE]   数据加载日志级别；退出前写入各阶段指标\n"
+              << "       [--verify-data on|off]   在后台按清单重新计算数据文件的哈希\n"
+              << "       [--checkpoint FILE] [--load-checkpoint FILE]   每轮后台写入检查点；映射检查点直接评估或提供服务，不训练\n";
+}
+
+TrainArgs parse_args(int argc, char** argv) {
+    TrainArgs args;
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (i + 1 >= argc) {
+            throw std::runtime_error("Missing value for " + flag);
+        }
+        std::string value = argv[++i];
+        if (flag == "--epochs") args.epochs = std::stoi(value);
+        else if (flag == "--batch") args.batch_size = std::stoi(value);
+        else if (flag == "--hidden") args.hidden = std::stoi(value);
+        else if (flag == "--optimizer") args.optimizer.kind = parse_optimizer(value);
+        else if (flag == "--lr") args.optimizer.learning_rate = std::stof(value);
+        else if (flag == "--seed") args.seed = std::stoull(value);
+        else if (flag == "--threads") args.threads = std::stoi(value);
+        else if (flag == "--serve") args.serve.address = value;
+        else if (flag == "--max-batch") args.serve.max_batch = std::stoi(value);
+        else if (flag == "--max-wait-us") args.serve.max_wait_us = std::stoi(value);
+        else if (flag == "--log-level") set_log_level(parse_log_level(value));
+        else if (flag == "--metrics") args.metrics_path = value;
+        else if (flag == "--verify-data") args.verify_data = value == "on";
+        else if (flag == "--checkpoint") args.checkpoint_path = value;
+        else if (flag == "--load-checkpoint") args.load_checkpoint = value;
+        else throw std::runtime_error("Unknown option: " + flag);
+    }
+    return args;
+}
+
+void print_stats(const InferenceStats& stats) {
+    std::cout << "推理: " << stats.requests << " 个请求, " << stats.batches << " 个批次 (平均 " << std::fixed
+              << std::setprecision(1) << stats.mean_batch << "), p50 " << stats.p50_us << " us, p99 "
+              << stats.p99_us << " us, " << std::setprecision(0) << stats.requests_per_sec << " 请求/秒" << std::endl;
+}
+
+// 提供推理服务直到收到SIGINT或SIGTERM，每10秒打印一次统计
+void serve(const Mlp& model, const InferenceServerOptions& options, const sigset_t& signals) {
+    InferenceServer server(model, options);
+    uint64_t reported = 0;
+    while (true) {
+        timespec timeout{10, 0};
+        if (sigtimedwait(&signals, nullptr, &timeout) > 0) {
+            break;
+        }
+        InferenceStats stats = server.stats();
+        if (stats.requests != reported) {
+            print_stats(stats);
+            reported = stats.requests;
+        }
+    }
+    server.stop();
+    print_stats(server.stats());
+}
+
+// 训练args.epochs轮，每轮结束后评估测试集
+void train(Mlp& model, const MnistData& mnist, MnistEvaluator& evaluator, const TrainArgs& args) {
+    // 单线程时与MlpTrainer的结果逐位相同
+    DataParallelTrainer trainer(model, mnist, args.optimizer, args.batch_size, args.threads);
+    trainer.enable_shuffle(args.seed);
+    std::cout << "优化器: " << optimizer_name(args.optimizer.kind) << ", 学习率 "
+              << trainer.optimizer().config().learning_rate << ", 批大小 " << args.batch_size
+              << ", 线程数 " << trainer.num_threads() << std::endl;
+
+    EvalReport eval;
+    CheckpointWriter writer;
+    bool checkpoint_current = true;
+    double train_seconds = 0.0;
+    for (int epoch = 1; epoch <= args.epochs; ++epoch) {
+        auto start = std::chrono::steady_clock::now();
+        float loss = trainer.train_epoch();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        train_seconds += seconds;
+        eval = evaluator.evaluate(MnistSplit::Test);
+        std::cout << "epoch " << epoch << ": loss " << std::fixed << std::setprecision(4) << loss
+                  << ", 测试准确率 " << eval.accuracy() << ", " << std::setprecision(0)
+                  << mnist.train_count / seconds << " 样本/秒, 评估 " << std::setprecision(1)
+                  << eval.seconds * 1e3 << " ms" << std::endl;
+        if (!args.checkpoint_path.empty()) {
+            // 只拷贝参数与优化器状态，写盘在后台进行；上一次尚未写完时跳过本轮
+            checkpoint_current = writer.save_async(args.checkpoint_path, model, &trainer.optimizer(), trainer.epoch());
+        }
+    }
+    if (!args.checkpoint_path.empty()) {
+        writer.wait();
+        if (!checkpoint_current) {
+            save_checkpoint(args.checkpoint_path, model, &trainer.optimizer(), trainer.epoch());
+        }
+        std::cout << "检查点已写入 " << args.checkpoint_path << " (后台写入 " << writer.saved() << " 次, 跳过 "
+                  << writer.skipped() << " 次)" << std::endl;
+    }
+    if (args.epochs > 0) {
+        std::cout << "测试集评估:\n";
+        print_eval_report(std::cout, eval);
+    }
+    if (train_seconds > 0.0) {
+        std::cout << "平均训练吞吐量: " << std::fixed << std::setprecision(0)
+                  << trainer.samples_seen() / train_seconds << " 样本/秒" << std::endl;
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
     try {
+        if (argc > 1 && (std::strcmp(argv[1], "-h") == 0 || std::strcmp(argv[1], "--help") == 0)) {
+            print_usage(argv[0]);
+            return 0;
+        }
+        TrainArgs args = parse_args(argc, argv);
+
+        // 在创建任何线程之前屏蔽SIGINT/SIGTERM，由serve同步等待
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        if (!args.serve.address.empty()) {
+            pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        }
+
         init_mnist("./data", false);
         
         // 加载MNIST数据集
         MnistData mnist = load_mnist();
+        // 校验会删除不一致的文件与清单，须在加载完成之后才开始，不与init_mnist、映射与解析交错
+        std::future<bool> verification;
+        if (args.verify_data) {
+            verification = verify_mnist_manifest_async("./data");
+        }
         
         std::cout << "训练图像: " << mnist.train_count << " x " 
                   << mnist.rows << "x" << mnist.cols << std::endl;
         std::cout << "测试图像: " << mnist.test_count << " x " 
                   << mnist.rows << "x" << mnist.cols << std::endl;
         
-        // 使用批处理加载器示例
-        int batch_size = 100;
-        MnistBatchLoader batch_loader(mnist, batch_size);
-        
-        Eigen::MatrixXf batch_x;
-        Eigen::VectorXi batch_y;
-        
-        // 处理第一批数据示例
-        if (batch_loader.next_train_batch(batch_x, batch_y)) {
-            std::cout << "成功加载第一批训练数据: " << batch_x.rows() << " 样本" << std::endl;
-            // 处理批次数据...
+        // 两层网络：Affine -> ReLU -> Affine -> SoftmaxWithLoss；推理副本直接映射检查点中的权重
+        // 输出层的大小取自标签（MNIST为10，EMNIST letters的标签为1~26，即27）
+        const int classes = mnist_num_classes(mnist);
+        Mlp model = args.load_checkpoint.empty() ? Mlp({mnist.rows * mnist.cols, args.hidden, classes}, args.seed)
+                                                 : map_checkpoint(args.load_checkpoint);
+        // 评估不需要反向传播，用更大的批次；与训练使用相同的线程数
+        MnistEvaluator evaluator(model, mnist, 512, args.threads);
+        if (model.is_mapped()) {
+            EvalReport eval = evaluator.evaluate(MnistSplit::Test);
+            std::cout << "已映射检查点 " << args.load_checkpoint << "，测试准确率 " << std::fixed
+                      << std::setprecision(4) << eval.accuracy() << std::endl;
+        } else {
+            train(model, mnist, evaluator, args);
+        }
+
+        if (verification.valid()) {
+            // 本次运行已无法补救不一致的数据，下次启动时会重新解压或下载出错的文件
+            std::cout << "数据校验: " << (verification.get() ? "通过" : "失败，已删除出错的文件，下次启动时恢复")
+                      << std::endl;
+        }
+
+        if (!args.serve.address.empty()) {
+            serve(model, args.serve, signals);
+        }
+        if (!args.metrics_path.empty()) {
+            write_metrics(args.metrics_path);
+            std::cout << "指标已写入 " << args.metrics_path << std::endl;
         }
         
     } catch (const std::exception& e) {
@@ -34,4 +223,3 @@ int main() {
     
     return 0;
 }
-
@@ -0,0 +1,135 @@
+#include "metrics.h"
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const char* const counter_names[metric_counter_count] = {
+    "download_bytes", "decompressed_bytes", "parsed_bytes", "batches_served", "samples_served", "data_waits",
+};
+
+const char* const timer_names[metric_timer_count] = {
+    "download", "decompress", "parse", "normalize", "data_wait", "evaluate",
+};
+
+#if MNIST_METRICS
+
+struct TimerCell {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> total_ns{0};
+    std::atomic<uint64_t> max_ns{0};
+};
+
+// Relaxed atomics: every update is independent and a snapshot need not be a consistent cut
+std::atomic<uint64_t> counters[metric_counter_count];
+TimerCell timers[metric_timer_count];
+
+#endif // MNIST_METRICS
+
+} // anonymous namespace
+
+#if MNIST_METRICS
+
+void metrics_detail::add(MetricCounter counter, uint64_t n) {
+    counters[static_cast<int>(counter)].fetch_add(n, std::memory_order_relaxed);
+}
+
+void metrics_detail::record(MetricTimer timer, uint64_t ns) {
+    TimerCell& cell = timers[static_cast<int>(timer)];
+    cell.count.fetch_add(1, std::memory_order_relaxed);
+    cell.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t seen = cell.max_ns.load(std::memory_order_relaxed);
+    while (ns > seen && !cell.max_ns.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {
+    }
+}
+
+#endif // MNIST_METRICS
+
+const char* metric_name(MetricCounter counter) {
+    return counter_names[static_cast<int>(counter)];
+}
+
+const char* metric_name(MetricTimer timer) {
+    return timer_names[static_cast<int>(timer)];
+}
+
+MetricsSnapshot metrics_snapshot() {
+    MetricsSnapshot snapshot;
+#if MNIST_METRICS
+    for (int i = 0; i < metric_counter_count; ++i) {
+        snapshot.counters[i] = counters[i].load(std::memory_order_relaxed);
+    }
+    for (int i = 0; i < metric_timer_count; ++i) {
+        snapshot.timers[i].count = timers[i].count.load(std::memory_order_relaxed);
+        snapshot.timers[i].total_ns = timers[i].total_ns.load(std::memory_order_relaxed);
+        snapshot.timers[i].max_ns = timers[i].max_ns.load(std::memory_order_relaxed);
+    }
+#endif
+    return snapshot;
+}
+
+void metrics_reset() {
+#if MNIST_METRICS
+    for (auto& c : counters) c.store(0, std::memory_order_relaxed);
+    for (auto& t : timers) {
+        t.count.store(0, std::memory_order_relaxed);
+        t.total_ns.store(0, std::memory_order_relaxed);
+        t.max_ns.store(0, std::memory_order_relaxed);
+    }
+#endif
+}
+
+std::string metrics_json(const MetricsSnapshot& snapshot) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"enabled\": " << (snapshot.enabled ? "true" : "false") << ", \"counters\": {";
+    for (int i = 0; i < metric_counter_count; ++i) {
+        out << (i ? ", " : "") << "\"" << counter_names[i] << "\": " << snapshot.counters[i];
+    }
+    out << "}, \"timers\": {";
+    for (int i = 0; i < metric_timer_count; ++i) {
+        const TimerStats& t = snapshot.timers[i];
+        out << (i ? ", " : "") << "\"" << timer_names[i] << "\": {\"count\": " << t.count
+            << ", \"total_ms\": " << t.total_ns * 1e-6 << ", \"max_ms\": " << t.max_ns * 1e-6 << "}";
+    }
+    out << "}}";
+    return out.str();
+}
+
+std::string metrics_prometheus(const MetricsSnapshot& snapshot) {
+    std::ostringstream out;
+    out << std::setprecision(9);
+    for (int i = 0; i < metric_counter_count; ++i) {
+        std::string name = std::string("mnist_") + counter_names[i] + "_total";
+        out << "# TYPE " << name << " counter\n" << name << " " << snapshot.counters[i] << "\n";
+    }
+    for (int i = 0; i < metric_timer_count; ++i) {
+        const TimerStats& t = snapshot.timers[i];
+        std::string name = std::string("mnist_") + timer_names[i];
+        out << "# TYPE " << name << "_seconds_total counter\n"
+            << name << "_seconds_total " << t.total_ns * 1e-9 << "\n"
+            << "# TYPE " << name << "_count counter\n"
+            << name << "_count " << t.count << "\n"
+            << "# TYPE " << name << "_max_seconds gauge\n"
+            << name << "_max_seconds " << t.max_ns * 1e-9 << "\n";
+    }
+    return out.str();
+}
+
+void write_metrics_file(const std::string& path, const std::string& text) {
+    // A scraper must never see a half-written file
+    std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        out << text;
+        if (!out) throw std::runtime_error("Cannot write metrics file: " + tmp_path);
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Cannot rename metrics file to " + path);
+    }
+}
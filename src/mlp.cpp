@@ -0,0 +1,260 @@
+#include "mlp.h"
+#include "evaluator.h"
+#include "kernels.h"
+#include "math.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+// Every arena segment starts on a cache line: 16 floats = 64 bytes
+constexpr Eigen::Index kAlignFloats = 16;
+
+Eigen::Index align_up(Eigen::Index n) {
+    return (n + kAlignFloats - 1) / kAlignFloats * kAlignFloats;
+}
+
+} // anonymous namespace
+
+// --- MlpLayout ---
+
+MlpLayout::MlpLayout(const std::vector<int>& layer_sizes) : sizes(layer_sizes) {
+    if (sizes.size() < 2) {
+        throw std::runtime_error("An MLP needs at least an input and an output size");
+    }
+    for (int size : sizes) {
+        if (size <= 0) {
+            throw std::runtime_error("Invalid MLP layer size: " + std::to_string(size));
+        }
+    }
+    for (int l = 0; l < num_layers(); ++l) {
+        weight_offsets.push_back(total);
+        total += align_up(static_cast<Eigen::Index>(sizes[l]) * sizes[l + 1]);
+        bias_offsets.push_back(total);
+        total += align_up(sizes[l + 1]);
+    }
+}
+
+int MlpLayout::max_width() const {
+    return *std::max_element(sizes.begin() + 1, sizes.end());
+}
+
+Eigen::Map<RowMatrixXf, Eigen::Aligned64> MlpLayout::weight(float* arena, int l) const {
+    return Eigen::Map<RowMatrixXf, Eigen::Aligned64>(arena + weight_offsets[l], sizes[l], sizes[l + 1]);
+}
+
+Eigen::Map<const RowMatrixXf, Eigen::Aligned64> MlpLayout::weight(const float* arena, int l) const {
+    return Eigen::Map<const RowMatrixXf, Eigen::Aligned64>(arena + weight_offsets[l], sizes[l], sizes[l + 1]);
+}
+
+Eigen::Map<Eigen::RowVectorXf, Eigen::Aligned64> MlpLayout::bias(float* arena, int l) const {
+    return Eigen::Map<Eigen::RowVectorXf, Eigen::Aligned64>(arena + bias_offsets[l], sizes[l + 1]);
+}
+
+Eigen::Map<const Eigen::RowVectorXf, Eigen::Aligned64> MlpLayout::bias(const float* arena, int l) const {
+    return Eigen::Map<const Eigen::RowVectorXf, Eigen::Aligned64>(arena + bias_offsets[l], sizes[l + 1]);
+}
+
+// --- MlpWorkspace ---
+
+MlpWorkspace::MlpWorkspace(const MlpLayout& layout, int max_batch) : max_batch(max_batch) {
+    if (max_batch <= 0) {
+        throw std::runtime_error("Invalid MLP workspace batch size: " + std::to_string(max_batch));
+    }
+    Eigen::Index total = 0;
+    for (int l = 0; l < layout.num_layers(); ++l) {
+        output_offsets.push_back(total);
+        total += align_up(static_cast<Eigen::Index>(max_batch) * layout.sizes[l + 1]);
+    }
+    activations.setZero(total);
+    delta_stride = align_up(static_cast<Eigen::Index>(max_batch) * layout.max_width());
+    deltas.setZero(2 * delta_stride);
+    gradients.setZero(layout.total);
+}
+
+// --- Mlp ---
+
+Mlp::Mlp(const std::vector<int>& layer_sizes, uint64_t seed) : shape(layer_sizes) {
+    params.setZero(shape.total);
+    // He initialization suits the ReLU hidden layers
+    std::mt19937_64 rng(seed);
+    for (int l = 0; l < shape.num_layers(); ++l) {
+        std::normal_distribution<float> normal(0.0f, std::sqrt(2.0f / shape.sizes[l]));
+        auto w = shape.weight(params.data(), l);
+        for (Eigen::Index i = 0; i < w.size(); ++i) {
+            w.data()[i] = normal(rng);
+        }
+    }
+}
+
+Mlp::Mlp(const std::vector<int>& layer_sizes, std::shared_ptr<const MappedFile> mapping, const float* params)
+    : shape(layer_sizes), mapping(std::move(mapping)), mapped_params(params) {
+    if (reinterpret_cast<uintptr_t>(params) % 64 != 0) {
+        throw std::runtime_error("Mapped MLP parameters must be 64-byte aligned");
+    }
+}
+
+Eigen::Map<const RowMatrixXf> Mlp::forward(const float* x, int count, MlpWorkspace& workspace) const {
+    if (count > workspace.max_batch) {
+        throw std::runtime_error("Batch of " + std::to_string(count) + " exceeds the workspace capacity of " +
+                                 std::to_string(workspace.max_batch));
+    }
+    const float* input = x;
+    for (int l = 0; l < shape.num_layers(); ++l) {
+        Eigen::Map<const RowMatrixXf> in(input, count, shape.sizes[l]);
+        Eigen::Map<RowMatrixXf, Eigen::Aligned64> out(workspace.activations.data() + workspace.output_offsets[l],
+                                                      count, shape.sizes[l + 1]);
+        out.noalias() = in * shape.weight(parameter_data(), l);
+        out.rowwise() += shape.bias(parameter_data(), l);
+        if (l + 1 < shape.num_layers()) {
+            out = out.cwiseMax(0.0f);
+        }
+        input = out.data();
+    }
+    return Eigen::Map<const RowMatrixXf>(input, count, output_size());
+}
+
+float Mlp::forward_backward(const float* x, const int* labels, int count, MlpWorkspace& workspace) const {
+    // The loss kernel indexes the gradient by label and only asserts the range, which release builds compile out
+    for (int i = 0; i < count; ++i) {
+        if (labels[i] < 0 || labels[i] >= output_size()) {
+            throw std::runtime_error("Label " + std::to_string(labels[i]) + " is outside the model's " +
+                                     std::to_string(output_size()) + " classes");
+        }
+    }
+    Eigen::Map<const RowMatrixXf> logits = forward(x, count, workspace);
+    const int last = shape.num_layers() - 1;
+    float* grads = workspace.gradients.data();
+
+    // SoftmaxWithLoss: the fused kernel writes dL/dlogits into the first delta buffer
+    int current = 0;
+    Eigen::Map<RowMatrixXf, Eigen::Aligned64> delta(workspace.deltas.data(), count, output_size());
+    float loss = Math::softmax_cross_entropy<float>(logits, Eigen::Map<const Eigen::VectorXi>(labels, count), delta);
+
+    for (int l = last; l >= 0; --l) {
+        Eigen::Map<RowMatrixXf, Eigen::Aligned64> dy(workspace.deltas.data() + current * workspace.delta_stride,
+                                                     count, shape.sizes[l + 1]);
+        const float* input = l == 0 ? x : workspace.activations.data() + workspace.output_offsets[l - 1];
+        Eigen::Map<const RowMatrixXf> in(input, count, shape.sizes[l]);
+
+        // Affine backward: dW = x^T dy, db = sum over the batch of dy
+        shape.weight(grads, l).noalias() = in.transpose() * dy;
+        shape.bias(grads, l) = dy.colwise().sum();
+
+        if (l > 0) {
+            // dx = dy W^T, then ReLU backward: the saved output is positive exactly where the input was
+            Eigen::Map<RowMatrixXf, Eigen::Aligned64> dx(
+                workspace.deltas.data() + (1 - current) * workspace.delta_stride, count, shape.sizes[l]);
+            dx.noalias() = dy * shape.weight(parameter_data(), l).transpose();
+            dx = (in.array() > 0.0f).select(dx, 0.0f);
+            current = 1 - current;
+        }
+    }
+    return loss;
+}
+
+void Mlp::predict(const float* x, int count, int* out_labels, MlpWorkspace& workspace) const {
+    Eigen::Map<const RowMatrixXf> logits = forward(x, count, workspace);
+    argmax_rows(logits.data(), count, static_cast<int>(logits.cols()), out_labels);
+}
+
+// --- Optimizer ---
+
+OptimizerKind parse_optimizer(const std::string& name) {
+    if (name == "sgd") return OptimizerKind::SGD;
+    if (name == "momentum") return OptimizerKind::Momentum;
+    if (name == "adam") return OptimizerKind::Adam;
+    throw std::runtime_error("Unknown optimizer: " + name + " (expected sgd, momentum or adam)");
+}
+
+const char* optimizer_name(OptimizerKind kind) {
+    switch (kind) {
+    case OptimizerKind::SGD: return "sgd";
+    case OptimizerKind::Momentum: return "momentum";
+    case OptimizerKind::Adam: return "adam";
+    }
+    return "unknown";
+}
+
+Optimizer::Optimizer(const OptimizerConfig& config, Eigen::Index size) : cfg(config), size(size) {
+    if (cfg.learning_rate <= 0.0f) {
+        switch (cfg.kind) {
+        case OptimizerKind::SGD: cfg.learning_rate = 0.1f; break;
+        case OptimizerKind::Momentum: cfg.learning_rate = 0.01f; break;
+        case OptimizerKind::Adam: cfg.learning_rate = 0.001f; break;
+        }
+    }
+    switch (cfg.kind) {
+    case OptimizerKind::SGD: break;
+    case OptimizerKind::Momentum: state_arena.setZero(size); break;
+    case OptimizerKind::Adam: state_arena.setZero(2 * size); break;
+    }
+}
+
+void Optimizer::step(Eigen::VectorXf& params, const Eigen::VectorXf& grads) {
+    ++step_count;
+    switch (cfg.kind) {
+    case OptimizerKind::SGD:
+        params.noalias() -= cfg.learning_rate * grads;
+        break;
+    case OptimizerKind::Momentum: {
+        auto v = state_arena.head(size);
+        v = cfg.momentum * v - cfg.learning_rate * grads;
+        params += v;
+        break;
+    }
+    case OptimizerKind::Adam: {
+        auto m = state_arena.head(size);
+        auto v = state_arena.tail(size);
+        const double t = static_cast<double>(step_count);
+        const float lr_t = static_cast<float>(cfg.learning_rate * std::sqrt(1.0 - std::pow(cfg.beta2, t)) /
+                                              (1.0 - std::pow(cfg.beta1, t)));
+        m.array() += (1.0f - cfg.beta1) * (grads.array() - m.array());
+        v.array() += (1.0f - cfg.beta2) * (grads.array().square() - v.array());
+        params.array() -= lr_t * m.array() / (v.array().sqrt() + cfg.epsilon);
+        break;
+    }
+    }
+}
+
+// --- MlpTrainer ---
+
+MlpTrainer::MlpTrainer(Mlp& model, const OptimizerConfig& config, int batch_size)
+    : model(model), opt(config, model.parameters().size()), workspace(model.layout(), batch_size) {
+    if (model.is_mapped()) {
+        throw std::runtime_error("A model mapped from a checkpoint is read-only; load_checkpoint it to train");
+    }
+    buffer.images.resize(batch_size, model.input_size());
+    buffer.labels.resize(batch_size);
+}
+
+float MlpTrainer::train_step(const MnistBatch& batch) {
+    if (batch.images.cols() != model.input_size()) {
+        throw std::runtime_error("Batch images have " + std::to_string(batch.images.cols()) +
+                                 " pixels, but the model takes " + std::to_string(model.input_size()) + " inputs");
+    }
+    float loss = model.forward_backward(batch.images.data(), batch.labels.data(), batch.count, workspace);
+    opt.step(model.parameters(), workspace.gradients);
+    samples += batch.count;
+    return loss;
+}
+
+float MlpTrainer::train_epoch(MnistBatchLoader& loader) {
+    double total_loss = 0.0;
+    int64_t total = 0;
+    while (loader.next_train_batch(buffer)) {
+        total_loss += static_cast<double>(train_step(buffer)) * buffer.count;
+        total += buffer.count;
+    }
+    loader.reset();
+    return total > 0 ? static_cast<float>(total_loss / total) : 0.0f;
+}
+
+float MlpTrainer::evaluate(const MnistData& data, MnistSplit split) {
+    // The shared evaluation loop on one thread, which also checks the image size and the labels
+    return MnistEvaluator(model, data, workspace.max_batch, 1).evaluate(split).accuracy();
+}
@@ -1,5 +1,11 @@
 #include "mnist_loader.h"
-#include <curl/curl.h>
+#include "kernels.h"
+#include "gz_reader.h"
+#include "mnist_snapshot.h"
+#include "mnist_manifest.h"
+#include "downloader.h"
+#include "log.h"
+#include "metrics.h"
 #include <zlib.h>
 #include <fstream>
 #include <sys/stat.h> // For stat and mkdir
@@ -9,12 +15,16 @@
 #include <cerrno> // Include for errno on Windows
 #endif
 #include <vector>
-#include <string> // Make sure string is included
+#include <string>
 #include <stdexcept>
 #include <iostream>
 #include <iomanip>
 #include <cstdio> // For std::remove
-#include <vector> // Include vector for base_urls
+#include <algorithm>
+#include <new>
+#include <exception>
+#include <limits>
+#include <thread>
 
 namespace {
 
@@ -24,7 +34,7 @@ const std::vector<std::string> base_urls = {
     "https://ossci-datasets.s3.amazonaws.com/mnist/"     // Secondary AWS S3
 };
 
-// Filenames remain the same
+// Archive names, identical on every mirror
 const char* names[] = {
     "train-images-idx3-ubyte.gz",
     "train-labels-idx1-ubyte.gz",
@@ -32,9 +42,7 @@ const char* names[] = {
     "t10k-labels-idx1-ubyte.gz"
 };
 
-// --- Helper Functions (exists, write_file, download, ungzip, read_int, delete_if_exists, verify_magic_number) ---
-// These functions remain largely the same as the previous refined version.
-// Make sure they are present here. I'll include them for completeness.
+// --- Helper Functions (exists, ungzip, read_int, delete_if_exists, verify_magic_number) ---
 
 // Check if a file or directory exists
 bool exists(const std::string& path) {
@@ -42,93 +50,9 @@ bool exists(const std::string& path) {
     return stat(path.c_str(), &st) == 0;
 }
 
-// Callback function for curl to write data to a file
-size_t write_file(void* ptr, size_t size, size_t nmemb, void* stream) {
-    size_t written = fwrite(ptr, size, nmemb, (FILE*)stream);
-    // Check for write errors
-    if (written < nmemb && ferror((FILE*)stream)) {
-        return 0; // Indicate error to curl
-    }
-    return written;
-}
-
-// Downloads a file from a URL to a specified path
-void download(const std::string& url, const std::string& out_path) {
-    CURL* curl = curl_easy_init();
-    if (!curl) {
-        throw std::runtime_error("curl_easy_init() failed");
-    }
-
-    // RAII handle for CURL cleanup
-    struct CurlCleaner {
-        CURL* curl_handle;
-        CurlCleaner(CURL* h) : curl_handle(h) {}
-        ~CurlCleaner() { if (curl_handle) curl_easy_cleanup(curl_handle); }
-    } curl_cleaner(curl);
-
-    FILE* fp = fopen(out_path.c_str(), "wb");
-    if (!fp) {
-        throw std::runtime_error("Failed to create output file: " + out_path);
-    }
-
-    // RAII handle for file closing
-    struct FileCloser {
-        FILE* file_handle;
-        FileCloser(FILE* h) : file_handle(h) {}
-        ~FileCloser() { if (file_handle) fclose(file_handle); }
-    } file_closer(fp);
-
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_file);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 5L);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-mnist-downloader/1.1"); // Version bump
-    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 15L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 90L);
-    // curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L); // Debugging
-
-    std::cout << "Attempting download from: " << url << " ..." << std::endl;
-    CURLcode res = curl_easy_perform(curl);
-
-    long http_code = 0;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
-
-    // Ensure file is closed before checking results or throwing
-    file_closer.file_handle = nullptr;
-    if (fclose(fp) != 0) {
-         // Warning or error if closing failed
-         std::cerr << "Warning: fclose failed for " << out_path << std::endl;
-         // Depending on severity, could throw here
-    }
-    fp = nullptr; // Mark as closed
-
-
-    if (res != CURLE_OK) {
-        std::remove(out_path.c_str()); // Clean up partial file
-        throw std::runtime_error("Download failed: " + std::string(curl_easy_strerror(res)) +
-                                 " (URL: " + url +
-                                 ", CURLcode: " + std::to_string(res) +
-                                 ", HTTP code: " + std::to_string(http_code) + ")");
-    }
-
-    // Basic gzip header check
-    std::ifstream file(out_path, std::ios::binary);
-    if (!file.is_open()) {
-         std::remove(out_path.c_str()); // Clean up file if can't verify
-        throw std::runtime_error("Failed to open downloaded file for verification: " + out_path);
-    }
-    unsigned char header[2];
-    file.read(reinterpret_cast<char*>(header), 2);
-    bool is_gzip = (file.gcount() == 2 && header[0] == 0x1f && header[1] == 0x8b);
-    file.close();
-
-    if (!is_gzip) {
-        std::remove(out_path.c_str()); // Clean up invalid file
-        throw std::runtime_error("Downloaded file is not in valid gzip format: " + out_path + " from URL: " + url);
-    }
-     std::cout << "Download complete and verified (gzip header OK) for " << out_path << std::endl;
+uint64_t file_bytes(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
 }
 
 // Decompresses a gzipped file
@@ -151,8 +75,10 @@ void ungzip(const std::string& src_path, const std::string& dst_path) {
 
     char buffer[4096];
     int len;
-    std::cout << "Decompressing " << src_path << " to " << dst_path << " ..." << std::endl;
+    MNIST_LOG_INFO("Decompressing " << src_path << " to " << dst_path << " ...");
+    ScopedTimer timer(MetricTimer::Decompress);
     while ((len = gzread(in, buffer, sizeof(buffer))) > 0) {
+        metrics_add(MetricCounter::DecompressedBytes, static_cast<uint64_t>(len));
         out.write(buffer, len);
         if (!out) {
              throw std::runtime_error("Error writing to output file: " + dst_path);
@@ -173,7 +99,7 @@ void ungzip(const std::string& src_path, const std::string& dst_path) {
          throw std::runtime_error("Error closing output file after writing: " + dst_path);
      }
 
-    std::cout << "Decompression complete for " << dst_path << std::endl;
+    MNIST_LOG_INFO("Decompression complete for " << dst_path);
 }
 
 // Reads a 32-bit big-endian integer
@@ -191,9 +117,9 @@ int read_int(std::ifstream& f) {
 void delete_if_exists(const std::string& path) {
     if (exists(path)) {
         if (std::remove(path.c_str()) != 0) {
-            std::cerr << "Warning: Failed to delete existing file: " << path << " (errno: " << errno << ")" << std::endl;
+            MNIST_LOG_WARN("Failed to delete existing file: " << path << " (errno: " << errno << ")");
         } else {
-            std::cout << "Deleted existing file: " << path << std::endl;
+            MNIST_LOG_INFO("Deleted existing file: " << path);
         }
     }
 }
@@ -220,14 +146,50 @@ void verify_magic_number(const std::string& file_path, bool is_image_file) {
                                  ". Expected: " + std::to_string(expected_magic) +
                                  ", Got: " + std::to_string(magic));
     }
-    std::cout << "Magic number verified for " << file_path << std::endl;
+    MNIST_LOG_INFO("Magic number verified for " << file_path);
 }
 
 
+// The files a finished init leaves behind: the archives, plus the IDX files when decompressing
+std::vector<std::string> required_files(bool decompress) {
+    std::vector<std::string> files;
+    for (const char* name : names) {
+        std::string gz_name = name;
+        files.push_back(decompress ? gz_name.substr(0, gz_name.size() - 3) : gz_name);
+    }
+    return files;
+}
+
+// Builds one download job per archive, trying each base URL in turn
+DownloadJob make_job(const std::vector<std::string>& urls, const std::string& filename, const std::string& gz_path) {
+    DownloadJob job;
+    job.out_path = gz_path;
+    for (const auto& base_url : urls) {
+        job.urls.push_back(base_url + filename);
+    }
+    return job;
+}
+
 } // anonymous namespace
 
 // Initializes MNIST data: creates directory, downloads (trying sources), and unzips if necessary.
-void init_mnist(const std::string& root, bool force_download) {
+void init_mnist(const std::string& root, bool force_download, bool decompress) {
+    MnistInitOptions options;
+    options.force_download = force_download;
+    options.decompress = decompress;
+    init_mnist(root, options);
+}
+
+// Missing archives are collected first and downloaded concurrently; decompression
+// runs afterwards, file by file.
+void init_mnist(const std::string& root, const MnistInitOptions& options) {
+    // Warm start: one read of the manifest and one stat per file; no data file is opened
+    if (options.use_manifest && !options.force_download &&
+        mnist_manifest_current(root, required_files(options.decompress))) {
+        MNIST_LOG_INFO("MNIST dataset in " << root << " matches its manifest.");
+        return;
+    }
+
     // Create root directory
     if (!exists(root)) {
         #ifdef _WIN32
@@ -239,229 +201,756 @@ void init_mnist(const std::string& root, bool force_download) {
                 throw std::runtime_error("Failed to create directory: " + root + " (errno: " + std::to_string(errno) + ")");
             }
         #endif
-         std::cout << "Created directory: " << root << std::endl;
+         MNIST_LOG_INFO("Created directory: " << root);
     }
-    std::cout << "Initializing MNIST dataset in: " << root << std::endl;
+    MNIST_LOG_INFO("Initializing MNIST dataset in: " << root);
 
-    if (base_urls.empty()) {
+    const std::vector<std::string>& urls = options.base_urls.empty() ? base_urls : options.base_urls;
+    if (urls.empty()) {
          throw std::runtime_error("No download base URLs provided.");
     }
 
+    // A stale manifest still knows how large each file was when it was last verified
+    std::vector<ManifestEntry> manifest;
+    if (options.force_download) {
+        delete_if_exists(mnist_manifest_path(root));
+    } else if (options.use_manifest) {
+        read_mnist_manifest(root, manifest);
+    }
+
+    std::vector<DownloadJob> jobs;
+    std::vector<int> to_decompress;
     for (int i = 0; i < 4; ++i) {
         std::string filename = names[i];
         std::string gz_path = root + "/" + filename;
         std::string dst_path = gz_path.substr(0, gz_path.size() - 3);
 
-        if (force_download) {
-            std::cout << "Force download requested for " << filename << "." << std::endl;
+        if (options.force_download) {
+            MNIST_LOG_INFO("Force download requested for " << filename << ".");
             delete_if_exists(gz_path);
+            delete_if_exists(gz_path + ".part");
             delete_if_exists(dst_path);
         }
 
+        // The streaming gzip loader only needs the archives
+        if (!options.decompress) {
+            if (exists(gz_path)) {
+                MNIST_LOG_INFO("Compressed file already exists: " << gz_path << ". Skipping download.");
+            } else {
+                MNIST_LOG_INFO("Compressed file not found: " << gz_path << ". Queued for download.");
+                jobs.push_back(make_job(urls, filename, gz_path));
+            }
+            continue;
+        }
+
+        // The magic number survives truncation and appended bytes; a size change against the
+        // manifest does not. The archive is kept, the file is simply extracted again
+        const std::string dst_name = dst_path.substr(root.size() + 1);
+        for (const ManifestEntry& entry : manifest) {
+            if (entry.name == dst_name && exists(dst_path) && entry.size != file_bytes(dst_path)) {
+                MNIST_LOG_WARN("Existing file " << dst_path << " is " << file_bytes(dst_path) << " bytes, manifest says "
+                               << entry.size << "; extracting it again.");
+                delete_if_exists(dst_path);
+            }
+        }
+
         // Check if the final unzipped file exists and is valid
-        bool dst_exists_and_valid = false;
         if (exists(dst_path)) {
              try {
                  bool is_image = filename.find("images") != std::string::npos;
                  verify_magic_number(dst_path, is_image);
-                 std::cout << "Dataset file already exists and is valid: " << dst_path << std::endl;
-                 dst_exists_and_valid = true;
+                 MNIST_LOG_INFO("Dataset file already exists and is valid: " << dst_path);
+                 continue;
              } catch (const std::exception& e) {
-                  std::cerr << "Warning: Existing file " << dst_path << " failed verification: " << e.what() << std::endl;
-                  std::cerr << "Will attempt to re-download and unzip." << std::endl;
+                  MNIST_LOG_WARN("Existing file " << dst_path << " failed verification: " << e.what());
+                  MNIST_LOG_WARN("Will attempt to re-download and unzip.");
                   delete_if_exists(dst_path); // Delete invalid existing file
                   delete_if_exists(gz_path);  // Delete corresponding gz too, likely corrupt source
              }
         }
 
+        // Only download if gz doesn't exist; an existing gz is treated as successfully "downloaded"
+        if (!exists(gz_path)) {
+            MNIST_LOG_INFO("Compressed file not found: " << gz_path << ". Queued for download.");
+            jobs.push_back(make_job(urls, filename, gz_path));
+        } else {
+            MNIST_LOG_INFO("Compressed file already exists: " << gz_path << ". Skipping download.");
+        }
+        to_decompress.push_back(i);
+    }
 
-        // If destination file doesn't exist or wasn't valid, proceed with download/unzip
-        if (!dst_exists_and_valid) {
-            // Download phase: Try sources until one works or all fail
-            bool downloaded = false;
-            if (!exists(gz_path)) { // Only download if gz doesn't exist
-                std::cout << "Compressed file not found: " << gz_path << ". Starting download..." << std::endl;
-                for (const auto& base_url : base_urls) {
-                    std::string full_url = base_url + filename;
-                    try {
-                        download(full_url, gz_path);
-                        downloaded = true;
-                        break; // Success! Stop trying other sources
-                    } catch (const std::exception& e) {
-                        std::cerr << "Download attempt failed from " << base_url << ": " << e.what() << std::endl;
-                        // Cleanup potentially failed partial download before trying next source
-                        delete_if_exists(gz_path);
-                    }
-                }
-                // If loop finishes without success
-                if (!downloaded) {
-                    throw std::runtime_error("Failed to download " + filename + " from all provided sources.");
-                }
-            } else {
-                 std::cout << "Compressed file already exists: " << gz_path << ". Skipping download." << std::endl;
-                 downloaded = true; // Treat existing gz as successfully "downloaded" for the next step
-            }
-
+    // Download phase: all missing archives at once, resuming any .part left by an earlier run
+    DownloadOptions download_options;
+    download_options.max_parallel = options.max_parallel;
+    download_options.max_rounds = options.max_rounds;
+    download_options.abort_after_bytes = options.abort_after_bytes;
+    download_all(jobs, download_options);
 
-            // Unzip phase (only if download was successful or gz existed)
-            if (downloaded) {
-                 try {
-                    ungzip(gz_path, dst_path);
-                    // Verify after unzipping
-                    bool is_image = filename.find("images") != std::string::npos;
-                    verify_magic_number(dst_path, is_image);
+    // Unzip phase
+    for (int i : to_decompress) {
+        std::string filename = names[i];
+        std::string gz_path = root + "/" + filename;
+        std::string dst_path = gz_path.substr(0, gz_path.size() - 3);
+        try {
+            ungzip(gz_path, dst_path);
+            // Verify after unzipping
+            bool is_image = filename.find("images") != std::string::npos;
+            verify_magic_number(dst_path, is_image);
 
-                    // Optional: Delete the .gz file after successful decompression and verification
-                    // delete_if_exists(gz_path);
+            // Optional: Delete the .gz file after successful decompression and verification
+            // delete_if_exists(gz_path);
 
-                } catch (const std::exception& e) {
-                    // Clean up potentially corrupt unzipped file and rethrow
-                    delete_if_exists(dst_path);
-                    // Optionally delete gz file too if unzip failed badly
-                    // delete_if_exists(gz_path);
-                    throw std::runtime_error("Failed to process " + filename + " after download: " + e.what());
-                }
+        } catch (const std::exception& e) {
+            // Clean up potentially corrupt unzipped file and rethrow
+            delete_if_exists(dst_path);
+            throw std::runtime_error("Failed to process " + filename + " after download: " + e.what());
+        }
+    }
+    // Everything on disk has just been verified; record it for the next start. The archives
+    // are listed too (when still present), so a later gzip-only start also takes the fast path
+    if (options.use_manifest) {
+        std::vector<std::string> files = required_files(options.decompress);
+        if (options.decompress) {
+            for (const std::string& gz_name : required_files(false)) {
+                if (exists(root + "/" + gz_name)) files.push_back(gz_name);
             }
-            // If !downloaded, we already threw an error earlier.
+        }
+        try {
+            write_mnist_manifest(root, files);
+        } catch (const std::exception& e) {
+            MNIST_LOG_WARN("Could not write manifest: " << e.what());
         }
     }
-    std::cout << "MNIST dataset initialization complete." << std::endl;
+    MNIST_LOG_INFO("MNIST dataset initialization complete.");
 }
 
 
 // --- load_mnist function ---
-// This function remains the same as the previous refined version.
-// It calls init_mnist() first, then loads images/labels using the helper lambdas.
-// Make sure it's present here. I'll include it for completeness.
+// Files are memory-mapped through IdxFile; headers are validated in place and the
+// payloads are converted straight into the Eigen storage.
+
+// Maps the four decompressed IDX files under root and validates their headers.
+MnistMapped map_mnist(const std::string& root) {
+    MnistMapped mapped;
+    mapped.train_images = IdxFile(root + "/train-images-idx3-ubyte");
+    mapped.train_labels = IdxFile(root + "/train-labels-idx1-ubyte");
+    mapped.test_images = IdxFile(root + "/t10k-images-idx3-ubyte");
+    mapped.test_labels = IdxFile(root + "/t10k-labels-idx1-ubyte");
+    return mapped;
+}
 
 // Loads the MNIST dataset from the specified root directory.
 MnistData load_mnist(const std::string& root, bool normalize) {
-    // Ensure data is present, downloading/unzipping if necessary using the new logic
-    init_mnist(root);
+    MnistLoadOptions options;
+    options.normalize = normalize;
+    return load_mnist(root, options);
+}
+
+namespace {
+
+void check_shard_options(const MnistLoadOptions& options) {
+    if (options.world_size < 1 || options.rank < 0 || options.rank >= options.world_size) {
+        throw std::runtime_error("Invalid shard: rank " + std::to_string(options.rank) + " of world_size " +
+                                 std::to_string(options.world_size));
+    }
+}
+
+// The samples of one split this process keeps
+ShardRange local_range(int n, const MnistLoadOptions& options, bool sharded) {
+    return sharded ? shard_range(n, options.rank, options.world_size) : shard_range(n, 0, 1);
+}
+
+// Narrows a snapshot-backed dataset to this process's shard; the images stay in the shared
+// mapping and only the pages of the shard are ever touched
+void slice_snapshot(MnistData& mnist, const MnistLoadOptions& options) {
+    const size_t row_bytes = static_cast<size_t>(mnist.rows) * mnist.cols *
+                             (mnist.storage == MnistStorage::Uint8 ? sizeof(uint8_t) : sizeof(float));
+    auto slice = [&](int i, int& count, Eigen::VectorXi& labels, int& offset, bool sharded) {
+        ShardRange range = local_range(count, options, sharded);
+        mnist.snapshot_images[i] = static_cast<const uint8_t*>(mnist.snapshot_images[i]) + range.begin * row_bytes;
+        labels = labels.segment(range.begin, range.count()).eval();
+        count = range.count();
+        offset = range.begin;
+    };
+    slice(0, mnist.train_count, mnist.train_labels, mnist.train_offset, true);
+    slice(1, mnist.test_count, mnist.test_labels, mnist.test_offset, options.shard_test);
+    mnist.shard_rank = options.rank;
+    mnist.shard_world_size = options.world_size;
+}
+
+} // anonymous namespace
+
+MnistData load_mnist(const std::string& root, const MnistLoadOptions& options) {
+    check_shard_options(options);
+    const bool sharded = options.world_size > 1;
+    std::string snapshot_path;
+    if (options.use_snapshot) {
+        snapshot_path = options.snapshot_path.empty() ? default_snapshot_path(root, options) : options.snapshot_path;
+        // Warm start: the snapshot already holds the final arrays, so init_mnist is skipped entirely
+        // as long as the source files it was written from are unchanged (one stat each)
+        MnistData mnist;
+        if (load_current_mnist_snapshot(snapshot_path, options, mnist_source_stamp(root, options.source), mnist)) {
+            try {
+                mnist.normalize = options.normalize;
+                if (sharded) {
+                    slice_snapshot(mnist, options);
+                }
+                MNIST_LOG_INFO("MNIST dataset loaded from snapshot " << snapshot_path << ": "
+                               << mnist.train_count << " training samples, "
+                               << mnist.test_count << " test samples.");
+                return mnist;
+            } catch (const std::exception& e) {
+                MNIST_LOG_WARN("Ignoring snapshot " << snapshot_path << ": " << e.what());
+            }
+        }
+    }
 
     MnistData mnist;
-    const int expected_rows = 28;
-    const int expected_cols = 28;
-    mnist.rows = expected_rows;
-    mnist.cols = expected_cols;
-    int img_size = mnist.rows * mnist.cols;
-
-    auto load_images = [&](const std::string& path, Eigen::MatrixXf& matrix, int& count) {
-        std::ifstream file(path, std::ios::binary);
-        if (!file.is_open()) throw std::runtime_error("Cannot open image file: " + path);
-
-        int magic = read_int(file);
-        if (magic != 2051) throw std::runtime_error("Invalid magic number in image file: " + path);
-
-        count = read_int(file);
-        int rows = read_int(file);
-        int cols = read_int(file);
-        if (rows != expected_rows || cols != expected_cols) {
-            throw std::runtime_error("Unexpected image dimensions in " + path +
-                                     ": got " + std::to_string(rows) + "x" + std::to_string(cols) +
-                                     ", expected " + std::to_string(expected_rows) + "x" + std::to_string(expected_cols));
+    if (options.source == MnistSource::Gzip) {
+        // Only the archives are needed; nothing decompressed is written to disk
+        init_mnist(root, false, false);
+        mnist = load_mnist_gz(root, options);
+    } else {
+        // Ensure data is present, downloading and decompressing if necessary
+        init_mnist(root);
+        mnist = load_mnist(map_mnist(root), options);
+    }
+
+    // A shard is not the dataset the snapshot describes; an unsharded run has to write it
+    if (options.use_snapshot && sharded) {
+        MNIST_LOG_DEBUG("Sharded load: not writing snapshot " << snapshot_path);
+    } else if (options.use_snapshot) {
+        try {
+            save_mnist_snapshot(mnist, snapshot_path, mnist_source_stamp(root, options.source));
+            MNIST_LOG_INFO("Wrote dataset snapshot " << snapshot_path);
+        } catch (const std::exception& e) {
+            MNIST_LOG_WARN(e.what());
         }
+    }
 
-        matrix.resize(count, img_size);
-        std::vector<unsigned char> buffer(img_size);
-        for (int i = 0; i < count; ++i) {
-            file.read(reinterpret_cast<char*>(buffer.data()), img_size);
-            if (file.gcount() != img_size) throw std::runtime_error("Error reading image data for item " + std::to_string(i) + " from " + path);
-            for (int j = 0; j < img_size; ++j) {
-                matrix(i, j) = normalize ? buffer[j] / 255.0f : static_cast<float>(buffer[j]);
-            }
+    MNIST_LOG_INFO("MNIST dataset loading complete: "
+                   << mnist.train_count << " training samples, "
+                   << mnist.test_count << " test samples"
+                   << (sharded ? " (shard " + std::to_string(options.rank) + " of " +
+                                     std::to_string(options.world_size) + ")" : std::string()) << ".");
+
+    return mnist;
+}
+
+MnistData load_mnist(const MnistMapped& mapped, bool normalize) {
+    MnistLoadOptions options;
+    options.normalize = normalize;
+    return load_mnist(mapped, options);
+}
+
+namespace {
+
+// Image shape of one split, taken from its header
+struct ImageShape {
+    int rows = 0;
+    int cols = 0;
+};
+
+// Image files hold count x rows x cols samples (higher ranks fold the trailing dimensions
+// into cols) or count x features (one row per sample). Any element type is accepted; only
+// the raw uint8 storage needs uint8 pixels.
+ImageShape check_image_header(const std::string& path, const IdxHeader& header, const MnistLoadOptions& options) {
+    const std::vector<int>& shape = header.shape;
+    if (shape.size() < 2) throw std::runtime_error("Image file must have at least 2 dimensions: " + path);
+    if (options.storage == MnistStorage::Uint8 && header.type != IdxType::UInt8) {
+        throw std::runtime_error("Uint8 storage needs uint8 images, got " + std::string(idx_type_name(header.type)) +
+                                 " in " + path);
+    }
+    if (header.item_elements > static_cast<size_t>(std::numeric_limits<int>::max())) {
+        throw std::runtime_error("Image size too large in " + path);
+    }
+    ImageShape image;
+    image.rows = shape.size() == 2 ? 1 : shape[1];
+    image.cols = static_cast<int>(header.item_elements) / std::max(image.rows, 1);
+    return image;
+}
+
+// Validates that a label file is one integer per sample and matches its image file
+void check_label_header(const std::string& path, const IdxHeader& header, int expected_count) {
+    if (header.shape.size() != 1) throw std::runtime_error("Label file must have 1 dimension: " + path);
+    if (header.type == IdxType::Float32 || header.type == IdxType::Float64) {
+        throw std::runtime_error("Label file must hold integers, got " + std::string(idx_type_name(header.type)) +
+                                 " in " + path);
+    }
+    if (header.count() != expected_count) {
+        throw std::runtime_error("Label count mismatch in " + path +
+                                 ": expected " + std::to_string(expected_count) +
+                                 ", got " + std::to_string(header.count()));
+    }
+}
+
+// Both splits must share one image shape; it becomes the shape of the dataset
+void set_image_shape(MnistData& mnist, const ImageShape& train, const ImageShape& test, const std::string& test_path) {
+    if (train.rows != test.rows || train.cols != test.cols) {
+        throw std::runtime_error("Image dimensions differ between splits: " + std::to_string(train.rows) + "x" +
+                                 std::to_string(train.cols) + " vs. " + std::to_string(test.rows) + "x" +
+                                 std::to_string(test.cols) + " in " + test_path);
+    }
+    mnist.rows = train.rows;
+    mnist.cols = train.cols;
+}
+
+// Pixels are scaled to [0, 1] only when they are bytes; other types load as stored
+float image_divisor(IdxType type, const MnistLoadOptions& options) {
+    return options.normalize && type == IdxType::UInt8 ? 255.0f : 1.0f;
+}
+
+MnistData make_empty(const MnistLoadOptions& options) {
+    check_shard_options(options);
+    MnistData mnist;
+    mnist.storage = options.storage;
+    mnist.normalize = options.normalize;
+    mnist.shard_rank = options.rank;
+    mnist.shard_world_size = options.world_size;
+    return mnist;
+}
+
+IdxHeader header_of(const IdxFile& file) {
+    IdxHeader header;
+    header.magic = file.magic();
+    header.type = file.type();
+    header.shape = file.shape();
+    header.item_elements = file.item_elements();
+    return header;
+}
+
+// Reads and parses the IDX header at the start of a gzip stream
+IdxHeader read_gz_header(GzReader& gz) {
+    uint8_t buf[4 + 4 * 255];
+    try {
+        gz.read_exact(buf, 4);
+        size_t header_bytes = 4 + 4 * static_cast<size_t>(buf[3]);
+        gz.read_exact(buf + 4, header_bytes - 4);
+        return parse_idx_header(buf, header_bytes);
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error("Invalid IDX file " + gz.path() + ": " + e.what());
+    }
+}
+
+} // anonymous namespace
+
+// Fills MnistData straight from the mapped payloads, without intermediate buffers.
+MnistData load_mnist(const MnistMapped& mapped, const MnistLoadOptions& options) {
+    ScopedTimer timer(MetricTimer::Parse);
+    MnistData mnist = make_empty(options);
+
+    // IDX records have a fixed size, so a shard is one contiguous range of the mapping; the
+    // pages of other shards are never touched
+    auto load_images = [&](const IdxFile& file, const ShardRange& range, RowMatrixXf& matrix, MatrixXu8& raw,
+                           int& count) {
+        ImageShape shape = check_image_header(file.path(), header_of(file), options);
+        count = range.count();
+        const size_t img_size = file.item_elements();
+
+        const uint8_t* pixels = file.payload().data + static_cast<size_t>(range.begin) * file.item_size();
+        if (options.storage == MnistStorage::Uint8) {
+            // Raw bytes keep the file's row-major layout; conversion happens per batch
+            raw = Eigen::Map<const MatrixXu8>(pixels, count, img_size);
+        } else {
+            // Both layouts are row-major, so the whole split converts as one contiguous run
+            matrix.resize(count, img_size);
+            ScopedTimer normalize_timer(MetricTimer::Normalize);
+            idx_decode(file.type(), pixels, static_cast<size_t>(count) * img_size, matrix.data(),
+                       image_divisor(file.type(), options));
+        }
+        metrics_add(MetricCounter::ParsedBytes, static_cast<uint64_t>(count) * file.item_size());
+        if (file.trailing_bytes() != 0) {
+            MNIST_LOG_WARN("Extra data detected at the end of image file: " << file.path());
+        }
+        MNIST_LOG_INFO("Loaded " << count << " images from " << file.path());
+        return shape;
+    };
+
+    auto load_labels = [&](const IdxFile& file, const ShardRange& range, Eigen::VectorXi& vector,
+                           int expected_count) {
+        check_label_header(file.path(), header_of(file), expected_count);
+        int count = range.count();
+
+        vector.resize(count);
+        idx_decode(file.type(), file.payload().data + static_cast<size_t>(range.begin) * file.item_size(), count,
+                   vector.data());
+        metrics_add(MetricCounter::ParsedBytes, static_cast<uint64_t>(count) * file.item_size());
+        if (file.trailing_bytes() != 0) {
+            MNIST_LOG_WARN("Extra data detected at the end of label file: " << file.path());
         }
-         if (!file.eof() && file.peek() != EOF) {
-             std::cerr << "Warning: Extra data detected at the end of image file: " << path << std::endl;
-         }
-        std::cout << "Loaded " << count << " images from " << path << std::endl;
+        MNIST_LOG_INFO("Loaded " << count << " labels from " << file.path());
     };
 
-    auto load_labels = [&](const std::string& path, Eigen::VectorXi& vector, int expected_count) {
-        std::ifstream file(path, std::ios::binary);
-        if (!file.is_open()) throw std::runtime_error("Cannot open label file: " + path);
+    const ShardRange train_range = local_range(mapped.train_images.count(), options, true);
+    const ShardRange test_range = local_range(mapped.test_images.count(), options, options.shard_test);
+    ImageShape train = load_images(mapped.train_images, train_range, mnist.train_images, mnist.train_pixels,
+                                   mnist.train_count);
+    load_labels(mapped.train_labels, train_range, mnist.train_labels, mapped.train_images.count());
+    ImageShape test = load_images(mapped.test_images, test_range, mnist.test_images, mnist.test_pixels,
+                                  mnist.test_count);
+    load_labels(mapped.test_labels, test_range, mnist.test_labels, mapped.test_images.count());
+    mnist.train_offset = train_range.begin;
+    mnist.test_offset = test_range.begin;
+    set_image_shape(mnist, train, test, mapped.test_images.path());
 
-        int magic = read_int(file);
-        if (magic != 2049) throw std::runtime_error("Invalid magic number in label file: " + path);
+    return mnist;
+}
 
-        int count = read_int(file);
-        if (count != expected_count) {
-            throw std::runtime_error("Label count mismatch in " + path +
-                                     ": expected " + std::to_string(expected_count) +
-                                     ", got " + std::to_string(count));
+// Inflates the four archives concurrently, parsing each IDX stream straight into MnistData.
+MnistData load_mnist_gz(const std::string& root, const MnistLoadOptions& options) {
+    MnistData mnist = make_empty(options);
+
+    auto warn_if_trailing = [](GzReader& gz, const char* kind) {
+        unsigned char extra;
+        if (gz.read(&extra, 1) != 0) {
+            MNIST_LOG_WARN("Extra data detected at the end of " << kind << " file: " << gz.path());
         }
+    };
 
-        vector.resize(count);
-        // Read labels one by one for potentially better error reporting if needed
-        // Can also read into a buffer like before for slight performance gain
-        for (int i = 0; i < count; ++i) {
-            unsigned char label;
-             file.read(reinterpret_cast<char*>(&label), 1);
-             if (file.gcount() != 1) throw std::runtime_error("Error reading label data for item " + std::to_string(i) + " from " + path);
-             vector(i) = static_cast<int>(label);
+    // A gzip stream cannot seek: records outside the shard are inflated into a scratch buffer and dropped
+    auto skip = [](GzReader& gz, size_t n) {
+        std::vector<uint8_t> scratch(std::min<size_t>(n, size_t(1) << 20));
+        for (size_t done = 0; done < n; done += scratch.size()) {
+            gz.read_exact(scratch.data(), std::min(scratch.size(), n - done));
         }
-         if (!file.eof() && file.peek() != EOF) {
-             std::cerr << "Warning: Extra data detected at the end of label file: " << path << std::endl;
-         }
-         std::cout << "Loaded " << count << " labels from " << path << std::endl;
     };
 
-    // Load training data
-    std::string train_img_path = root + "/train-images-idx3-ubyte";
-    std::string train_lbl_path = root + "/train-labels-idx1-ubyte";
-    load_images(train_img_path, mnist.train_images, mnist.train_count);
-    load_labels(train_lbl_path, mnist.train_labels, mnist.train_count);
+    auto decode_images = [&](const std::string& path, bool sharded, RowMatrixXf& matrix, MatrixXu8& raw,
+                             int& count, int& offset, int& total, ImageShape& shape) {
+        ScopedTimer timer(MetricTimer::Decompress);
+        GzReader gz(path);
+        IdxHeader header = read_gz_header(gz);
+        shape = check_image_header(path, header, options);
+        total = header.count();
+        const ShardRange range = local_range(total, options, sharded);
+        count = range.count();
+        offset = range.begin;
+        const size_t img_size = header.item_elements;
+
+        skip(gz, static_cast<size_t>(range.begin) * header.item_bytes());
+        if (options.storage == MnistStorage::Uint8) {
+            // zlib writes the pixels straight into their final home
+            raw.resize(count, img_size);
+            gz.read_exact(raw.data(), raw.size());
+        } else {
+            // Float storage inflates through a 1 MiB staging buffer that the decoder drains
+            const size_t chunk_images = std::max<size_t>(1, (size_t(1) << 20) / header.item_bytes());
+            matrix.resize(count, img_size);
+            std::vector<uint8_t> chunk(chunk_images * header.item_bytes());
+            const float divisor = image_divisor(header.type, options);
+            for (size_t done = 0; done < static_cast<size_t>(count); done += chunk_images) {
+                size_t n = std::min(chunk_images, static_cast<size_t>(count) - done);
+                gz.read_exact(chunk.data(), n * header.item_bytes());
+                ScopedTimer normalize_timer(MetricTimer::Normalize);
+                idx_decode(header.type, chunk.data(), n * img_size, matrix.data() + done * img_size, divisor);
+            }
+        }
+        skip(gz, static_cast<size_t>(total - range.end) * header.item_bytes());
+        metrics_add(MetricCounter::DecompressedBytes, static_cast<uint64_t>(total) * header.item_bytes());
+        warn_if_trailing(gz, "image");
+        MNIST_LOG_INFO("Decoded " << count << " images from " << path);
+    };
 
-    // Load test data
-    std::string test_img_path = root + "/t10k-images-idx3-ubyte";
-    std::string test_lbl_path = root + "/t10k-labels-idx1-ubyte";
-    load_images(test_img_path, mnist.test_images, mnist.test_count);
-    load_labels(test_lbl_path, mnist.test_labels, mnist.test_count);
+    auto decode_labels = [&](const std::string& path, bool sharded, Eigen::VectorXi& vector, IdxHeader& header) {
+        ScopedTimer timer(MetricTimer::Decompress);
+        GzReader gz(path);
+        header = read_gz_header(gz);
+        if (header.shape.size() != 1) throw std::runtime_error("Label file must have 1 dimension: " + path);
+        std::vector<uint8_t> bytes(static_cast<size_t>(header.count()) * header.item_bytes());
+        gz.read_exact(bytes.data(), bytes.size());
+        metrics_add(MetricCounter::DecompressedBytes, bytes.size());
+        // Sliced by the label file's own count; a mismatch with the images is reported after the join
+        const ShardRange range = local_range(header.count(), options, sharded);
+        vector.resize(range.count());
+        idx_decode(header.type, bytes.data() + static_cast<size_t>(range.begin) * header.item_bytes(),
+                   range.count(), vector.data());
+        warn_if_trailing(gz, "label");
+        MNIST_LOG_INFO("Decoded " << range.count() << " labels from " << path);
+    };
 
-    std::cout << "MNIST dataset loading complete: "
-              << mnist.train_count << " training samples, "
-              << mnist.test_count << " test samples." << std::endl;
+    ImageShape train_shape, test_shape;
+    int train_total = 0, test_total = 0;
+    IdxHeader train_label_header, test_label_header;
+    std::exception_ptr errors[4];
+    auto guarded = [&errors](int slot, auto&& fn) {
+        return [&errors, slot, fn]() {
+            try {
+                fn();
+            } catch (...) {
+                errors[slot] = std::current_exception();
+            }
+        };
+    };
+    std::thread workers[4] = {
+        std::thread(guarded(0, [&] { decode_images(root + "/" + names[0], true, mnist.train_images, mnist.train_pixels, mnist.train_count, mnist.train_offset, train_total, train_shape); })),
+        std::thread(guarded(1, [&] { decode_labels(root + "/" + names[1], true, mnist.train_labels, train_label_header); })),
+        std::thread(guarded(2, [&] { decode_images(root + "/" + names[2], options.shard_test, mnist.test_images, mnist.test_pixels, mnist.test_count, mnist.test_offset, test_total, test_shape); })),
+        std::thread(guarded(3, [&] { decode_labels(root + "/" + names[3], options.shard_test, mnist.test_labels, test_label_header); })),
+    };
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (auto& error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
 
+    check_label_header(root + "/" + names[1], train_label_header, train_total);
+    check_label_header(root + "/" + names[3], test_label_header, test_total);
+    set_image_shape(mnist, train_shape, test_shape, root + "/" + names[2]);
     return mnist;
 }
 
 
+const float* MnistData::image_data(MnistSplit split) const {
+    int i = split == MnistSplit::Train ? 0 : 1;
+    if (snapshot) return static_cast<const float*>(snapshot_images[i]);
+    return (i == 0 ? train_images : test_images).data();
+}
+
+const uint8_t* MnistData::pixel_data(MnistSplit split) const {
+    int i = split == MnistSplit::Train ? 0 : 1;
+    if (snapshot) return static_cast<const uint8_t*>(snapshot_images[i]);
+    return (i == 0 ? train_pixels : test_pixels).data();
+}
+
+void copy_images(const MnistData& data, MnistSplit split, int start, int count, float* out) {
+    const size_t img_size = static_cast<size_t>(data.rows) * data.cols;
+    const size_t offset = static_cast<size_t>(start) * img_size;
+    const size_t n = static_cast<size_t>(count) * img_size;
+    if (data.storage == MnistStorage::Float) {
+        // The batch is one contiguous range of the row-major storage
+        const float* src = data.image_data(split) + offset;
+        std::copy(src, src + n, out);
+    } else {
+        // Only the rows of this batch are widened to float, straight into the output
+        const uint8_t* src = data.pixel_data(split) + offset;
+        u8_to_f32(src, out, n, data.normalize ? 255.0f : 1.0f);
+    }
+}
+
+void gather_batch(const MnistData& data, MnistSplit split, const int* indices, int count,
+                  float* out_images, int* out_labels) {
+    const size_t img_size = static_cast<size_t>(data.rows) * data.cols;
+    bool train = split == MnistSplit::Train;
+    const Eigen::VectorXi& labels = train ? data.train_labels : data.test_labels;
+    if (data.storage == MnistStorage::Float) {
+        gather_rows_f32(data.image_data(split), img_size, indices, count, out_images);
+    } else {
+        gather_rows_u8_to_f32(data.pixel_data(split), img_size, indices, count, out_images,
+                              data.normalize ? 255.0f : 1.0f);
+    }
+    for (int i = 0; i < count; ++i) {
+        out_labels[i] = labels[indices[i]];
+    }
+}
+
+namespace {
+
+// Uniform integer in [0, range) without modulo bias
+uint64_t bounded(uint64_t& state, uint64_t range) {
+    const uint64_t limit = UINT64_MAX - UINT64_MAX % range;
+    uint64_t r;
+    do {
+        r = splitmix64(state);
+    } while (r >= limit);
+    return r % range;
+}
+
+} // anonymous namespace
+
+void shuffle_order(int* order, int n, uint64_t seed, uint64_t epoch) {
+    uint64_t state = seed;
+    state = splitmix64(state) ^ epoch;
+    for (int i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    for (int i = n - 1; i > 0; --i) {
+        int j = static_cast<int>(bounded(state, static_cast<uint64_t>(i) + 1));
+        std::swap(order[i], order[j]);
+    }
+}
+
+ShardRange shard_range(int n, int rank, int world_size) {
+    ShardRange range;
+    range.begin = static_cast<int>(static_cast<int64_t>(n) * rank / world_size);
+    range.end = static_cast<int>(static_cast<int64_t>(n) * (rank + 1) / world_size);
+    return range;
+}
+
+int mnist_num_classes(const MnistData& data) {
+    int classes = 1;
+    for (const Eigen::VectorXi* labels : {&data.train_labels, &data.test_labels}) {
+        if (labels->size() == 0) {
+            continue;
+        }
+        if (labels->minCoeff() < 0) {
+            throw std::runtime_error("Negative label " + std::to_string(labels->minCoeff()) + " in the dataset");
+        }
+        classes = std::max(classes, labels->maxCoeff() + 1);
+    }
+    return classes;
+}
+
+uint64_t shard_shuffle_seed(const MnistData& data, uint64_t seed) {
+    if (data.shard_world_size <= 1) {
+        return seed;
+    }
+    uint64_t state = seed ^ (static_cast<uint64_t>(data.shard_rank) << 32 | static_cast<uint32_t>(data.shard_world_size));
+    return splitmix64(state);
+}
+
+
 // --- MnistBatchLoader Implementation ---
-// This implementation remains the same as the previous version.
-// Make sure it's present here.
 
 MnistBatchLoader::MnistBatchLoader(const MnistData& data, int batch_size)
     : data(data), batch_size(batch_size > 0 ? batch_size : 1),
       train_index(0), test_index(0) {
     if (batch_size <= 0) {
-        std::cerr << "Warning: Invalid batch_size " << batch_size << ". Using batch_size=1." << std::endl;
+        MNIST_LOG_WARN("Invalid batch_size " << batch_size << ". Using batch_size=1.");
     }
 }
 
-bool MnistBatchLoader::next_train_batch(Eigen::MatrixXf& batch_x, Eigen::VectorXi& batch_y) {
+void MnistBatchLoader::enable_shuffle(uint64_t seed) {
+    shuffle = true;
+    shuffle_seed = shard_shuffle_seed(data, seed);
+    epoch_index = 0;
+    train_order.resize(data.train_count);
+    shuffle_order(train_order.data(), data.train_count, shuffle_seed, epoch_index);
+    train_index = 0;
+    test_index = 0;
+}
+
+namespace {
+
+void count_served(int count) {
+    metrics_add(MetricCounter::BatchesServed);
+    metrics_add(MetricCounter::SamplesServed, static_cast<uint64_t>(count));
+}
+
+} // anonymous namespace
+
+bool MnistBatchLoader::next_train_batch(RowMatrixXf& batch_x, Eigen::VectorXi& batch_y) {
     if (train_index >= data.train_count) {
         return false;
     }
     int count = std::min(batch_size, data.train_count - train_index);
-    batch_x = data.train_images.block(train_index, 0, count, data.rows * data.cols);
-    batch_y = data.train_labels.segment(train_index, count);
+    batch_x.resize(count, data.rows * data.cols);
+    if (shuffle) {
+        batch_y.resize(count);
+        gather_batch(data, MnistSplit::Train, train_order.data() + train_index, count,
+                     batch_x.data(), batch_y.data());
+    } else {
+        copy_images(data, MnistSplit::Train, train_index, count, batch_x.data());
+        batch_y = data.train_labels.segment(train_index, count);
+    }
+    count_served(count);
     train_index += count;
     return true;
 }
 
-bool MnistBatchLoader::next_test_batch(Eigen::MatrixXf& batch_x, Eigen::VectorXi& batch_y) {
+bool MnistBatchLoader::next_train_batch(Eigen::MatrixXf& batch_x, Eigen::VectorXi& batch_y) {
+    if (!next_train_batch(staging_batch, batch_y)) {
+        return false;
+    }
+    batch_x = staging_batch;
+    return true;
+}
+
+bool MnistBatchLoader::next_test_batch(RowMatrixXf& batch_x, Eigen::VectorXi& batch_y) {
     if (test_index >= data.test_count) {
         return false;
     }
     int count = std::min(batch_size, data.test_count - test_index);
-    batch_x = data.test_images.block(test_index, 0, count, data.rows * data.cols);
+    batch_x.resize(count, data.rows * data.cols);
+    copy_images(data, MnistSplit::Test, test_index, count, batch_x.data());
     batch_y = data.test_labels.segment(test_index, count);
+    count_served(count);
     test_index += count;
     return true;
 }
 
+bool MnistBatchLoader::next_test_batch(Eigen::MatrixXf& batch_x, Eigen::VectorXi& batch_y) {
+    if (!next_test_batch(staging_batch, batch_y)) {
+        return false;
+    }
+    batch_x = staging_batch;
+    return true;
+}
+
+bool MnistBatchLoader::next_train_batch(MnistBatch& batch) {
+    return next_batch(MnistSplit::Train, batch);
+}
+
+bool MnistBatchLoader::next_test_batch(MnistBatch& batch) {
+    return next_batch(MnistSplit::Test, batch);
+}
+
+bool MnistBatchLoader::next_train_view(MnistBatchView& view) {
+    return next_view(MnistSplit::Train, view);
+}
+
+bool MnistBatchLoader::next_test_view(MnistBatchView& view) {
+    return next_view(MnistSplit::Test, view);
+}
+
+bool MnistBatchLoader::next_batch(MnistSplit split, MnistBatch& batch) {
+    bool train = split == MnistSplit::Train;
+    int& index = train ? train_index : test_index;
+    int total = train ? data.train_count : data.test_count;
+    if (index >= total) {
+        return false;
+    }
+    int count = std::min(batch_size, total - index);
+    const int img_size = data.rows * data.cols;
+    // Only the first call (or a smaller caller buffer) allocates
+    if (batch.images.rows() < batch_size || batch.images.cols() != img_size) {
+        batch.images.resize(batch_size, img_size);
+    }
+    if (batch.labels.size() < batch_size) {
+        batch.labels.resize(batch_size);
+    }
+    if (train && shuffle) {
+        gather_batch(data, split, train_order.data() + index, count, batch.images.data(), batch.labels.data());
+    } else {
+        copy_images(data, split, index, count, batch.images.data());
+        batch.labels.head(count) = (train ? data.train_labels : data.test_labels).segment(index, count);
+    }
+    batch.count = count;
+    count_served(count);
+    index += count;
+    return true;
+}
+
+bool MnistBatchLoader::next_view(MnistSplit split, MnistBatchView& view) {
+    bool train = split == MnistSplit::Train;
+    if (data.storage != MnistStorage::Float || (train && shuffle)) {
+        throw std::logic_error("Batch views need contiguous float storage in file order; "
+                               "use next_*_batch(MnistBatch&) to gather instead");
+    }
+    int& index = train ? train_index : test_index;
+    int total = train ? data.train_count : data.test_count;
+    if (index >= total) {
+        return false;
+    }
+    int count = std::min(batch_size, total - index);
+    const int img_size = data.rows * data.cols;
+    const float* images = data.image_data(split);
+    const Eigen::VectorXi& labels = train ? data.train_labels : data.test_labels;
+    // Eigen::Map is rebound with placement new, as the Eigen documentation recommends
+    new (&view.x) Eigen::Map<const RowMatrixXf>(images + static_cast<size_t>(index) * img_size,
+                                                 count, img_size);
+    new (&view.y) Eigen::Map<const Eigen::VectorXi>(labels.data() + index, count);
+    count_served(count);
+    index += count;
+    return true;
+}
+
 void MnistBatchLoader::reset() {
     train_index = 0;
     test_index = 0;
-    std::cout << "MnistBatchLoader reset." << std::endl;
+    ++epoch_index;
+    if (shuffle) {
+        shuffle_order(train_order.data(), data.train_count, shuffle_seed, epoch_index);
+    }
+    MNIST_LOG_DEBUG("MnistBatchLoader reset.");
 }
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "mnist_manifest.h"
+#include "idx_file.h"
+#include "log.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char manifest_name[] = "mnist.manifest";
+const char manifest_tag[] = "mnist-manifest";
+
+uint32_t file_crc(const std::string& path) {
+    MappedFile file(path);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    // crc32 takes uInt lengths, so feed large files in pieces
+    for (size_t done = 0; done < file.size();) {
+        uInt n = static_cast<uInt>(std::min<size_t>(file.size() - done, 1u << 30));
+        crc = crc32(crc, file.data() + done, n);
+        done += n;
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+} // anonymous namespace
+
+bool stat_file(const std::string& path, uint64_t& size, int64_t& mtime_ns) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0) {
+        return false;
+    }
+    size = static_cast<uint64_t>(st.st_size);
+#ifdef _WIN32
+    mtime_ns = static_cast<int64_t>(st.st_mtime) * 1000000000;
+#else
+    mtime_ns = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+std::string mnist_manifest_path(const std::string& root) {
+    return root + "/" + manifest_name;
+}
+
+bool read_mnist_manifest(const std::string& root, std::vector<ManifestEntry>& entries) {
+    std::ifstream in(mnist_manifest_path(root));
+    std::string tag;
+    unsigned version = 0;
+    if (!(in >> tag >> version) || tag != manifest_tag || version != MNIST_MANIFEST_VERSION) {
+        return false;
+    }
+    entries.clear();
+    ManifestEntry entry;
+    std::string crc;
+    while (in >> entry.name >> entry.size >> entry.mtime_ns >> crc) {
+        try {
+            entry.crc = static_cast<uint32_t>(std::stoul(crc, nullptr, 16));
+        } catch (const std::exception&) {
+            return false;
+        }
+        entries.push_back(entry);
+    }
+    // Anything but a clean end of file means a damaged line
+    return in.eof();
+}
+
+void write_mnist_manifest(const std::string& root, const std::vector<std::string>& names) {
+    std::ostringstream text;
+    text << manifest_tag << " " << MNIST_MANIFEST_VERSION << "\n";
+    for (const std::string& name : names) {
+        const std::string path = root + "/" + name;
+        ManifestEntry entry;
+        if (!stat_file(path, entry.size, entry.mtime_ns)) {
+            throw std::runtime_error("Cannot add missing file to manifest: " + path);
+        }
+        entry.crc = file_crc(path);
+        text << name << " " << entry.size << " " << entry.mtime_ns << " " << std::hex << std::setw(8)
+             << std::setfill('0') << entry.crc << std::dec << "\n";
+    }
+
+    // Concurrent jobs may all find the manifest missing; each writes its own temporary file
+    const std::string path = mnist_manifest_path(root);
+    std::string tmp_path = path + ".tmp";
+#ifndef _WIN32
+    tmp_path += "." + std::to_string(::getpid());
+#endif
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        out << text.str();
+        if (!out) {
+            std::remove(tmp_path.c_str());
+            throw std::runtime_error("Cannot write manifest: " + tmp_path);
+        }
+    }
+    if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Cannot rename manifest to " + path);
+    }
+}
+
+bool mnist_manifest_current(const std::string& root, const std::vector<std::string>& names) {
+    std::vector<ManifestEntry> entries;
+    if (!read_mnist_manifest(root, entries)) {
+        return false;
+    }
+    for (const std::string& name : names) {
+        auto it = std::find_if(entries.begin(), entries.end(), [&](const ManifestEntry& e) { return e.name == name; });
+        uint64_t size = 0;
+        int64_t mtime_ns = 0;
+        if (it == entries.end() || !stat_file(root + "/" + name, size, mtime_ns) || size != it->size ||
+            mtime_ns != it->mtime_ns) {
+            MNIST_LOG_DEBUG("Manifest is stale for " << root << "/" << name);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool verify_mnist_manifest(const std::string& root) {
+    std::vector<ManifestEntry> entries;
+    if (!read_mnist_manifest(root, entries)) {
+        MNIST_LOG_WARN("No readable manifest to verify in " << root);
+        return false;
+    }
+    bool ok = true;
+    for (const ManifestEntry& entry : entries) {
+        const std::string path = root + "/" + entry.name;
+        uint32_t crc = 0;
+        try {
+            crc = file_crc(path);
+        } catch (const std::runtime_error& e) {
+            MNIST_LOG_WARN("Manifest verification could not read " << path << ": " << e.what());
+            ok = false;
+            continue;
+        }
+        if (crc != entry.crc) {
+            // A damaged file would otherwise keep passing the size/mtime check on every start
+            MNIST_LOG_WARN("Checksum mismatch for " << path << "; removing it so the next init restores it");
+            std::remove(path.c_str());
+            ok = false;
+        }
+    }
+    if (!ok) {
+        std::remove(mnist_manifest_path(root).c_str());
+    } else {
+        MNIST_LOG_INFO("Manifest verified: " << entries.size() << " files in " << root);
+    }
+    return ok;
+}
+
+std::future<bool> verify_mnist_manifest_async(const std::string& root) {
+    return std::async(std::launch::async, [root] { return verify_mnist_manifest(root); });
+}
@@ -0,0 +1,172 @@
+#include "mnist_prefetch.h"
+#include "log.h"
+#include "metrics.h"
+#include <algorithm>
+#include <utility>
+
+MnistPrefetchLoader::MnistPrefetchLoader(const MnistData& data, int batch_size, MnistSplit split,
+                                         int depth, int num_workers)
+    : data(data), split(split), batch_size(batch_size > 0 ? batch_size : 1) {
+    if (batch_size <= 0) {
+        MNIST_LOG_WARN("Invalid batch_size " << batch_size << ". Using batch_size=1.");
+    }
+    depth = std::max(depth, 1);
+    num_workers = std::max(num_workers, 1);
+    sample_count = split == MnistSplit::Train ? data.train_count : data.test_count;
+    batch_count = (sample_count + this->batch_size - 1) / this->batch_size;
+
+    // Every buffer is allocated once, here; batches only ever swap buffers afterwards
+    slots.resize(depth);
+    for (auto& slot : slots) {
+        slot.batch.images.resize(this->batch_size, data.rows * data.cols);
+        slot.batch.labels.resize(this->batch_size);
+    }
+    workers.reserve(num_workers);
+    for (int i = 0; i < num_workers; ++i) {
+        workers.emplace_back(&MnistPrefetchLoader::worker_loop, this);
+    }
+}
+
+MnistPrefetchLoader::~MnistPrefetchLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void MnistPrefetchLoader::worker_loop() {
+    std::vector<float> scratch; // augmentation buffers, grown on first use and kept for the loader's life
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        // A batch may be claimed once the batch that last used its slot has been consumed
+        work_cv.wait(lock, [this] {
+            return stopping || (next_claim < batch_count &&
+                                next_claim < consume_seq + static_cast<int64_t>(slots.size()));
+        });
+        if (stopping) {
+            return;
+        }
+        int64_t seq = next_claim++;
+        uint64_t claimed_generation = generation;
+        Slot& slot = slots[seq % slots.size()];
+        ++active_fills;
+        lock.unlock();
+
+        fill(slot.batch, seq, scratch);
+
+        lock.lock();
+        --active_fills;
+        if (claimed_generation == generation) {
+            slot.ready_seq = seq;
+            ready_cv.notify_all();
+        }
+        if (active_fills == 0) {
+            idle_cv.notify_all();
+        }
+    }
+}
+
+void MnistPrefetchLoader::fill(MnistBatch& batch, int64_t seq, std::vector<float>& scratch) const {
+    int start = static_cast<int>(seq) * batch_size;
+    int count = std::min(batch_size, sample_count - start);
+    if (shuffle) {
+        gather_batch(data, split, order.data() + start, count, batch.images.data(), batch.labels.data());
+    } else {
+        copy_images(data, split, start, count, batch.images.data());
+        const Eigen::VectorXi& labels = split == MnistSplit::Train ? data.train_labels : data.test_labels;
+        batch.labels.head(count) = labels.segment(start, count);
+    }
+    if (augment) {
+        // Seeds follow the sample, not the slot or the worker, and use its index in the full
+        // dataset so that shards of one run never repeat each other's transforms
+        const int offset = split == MnistSplit::Train ? data.train_offset : data.test_offset;
+        for (int i = 0; i < count; ++i) {
+            const int sample = shuffle ? order[start + i] : start + i;
+            augment(batch.images.row(i).data(), data.rows, data.cols,
+                    augment_sample_seed(augment_seed, epoch, offset + sample), scratch);
+        }
+    }
+    batch.count = count;
+}
+
+bool MnistPrefetchLoader::next_batch(MnistBatch& batch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (consume_seq >= batch_count) {
+        return false;
+    }
+    Slot& slot = slots[consume_seq % slots.size()];
+    if (slot.ready_seq != consume_seq) {
+        // The consumer outran the workers: this is the time training spends starved of data
+        metrics_add(MetricCounter::DataWaits);
+        ScopedTimer timer(MetricTimer::DataWait);
+        ready_cv.wait(lock, [&] { return slot.ready_seq == consume_seq; });
+    }
+
+    // The caller's buffers go back into the ring, so they must have the slot's capacity
+    if (batch.images.rows() != batch_size || batch.images.cols() != data.rows * data.cols) {
+        batch.images.resize(batch_size, data.rows * data.cols);
+        batch.labels.resize(batch_size);
+    }
+    batch.images.swap(slot.batch.images);
+    batch.labels.swap(slot.batch.labels);
+    batch.count = slot.batch.count;
+    metrics_add(MetricCounter::BatchesServed);
+    metrics_add(MetricCounter::SamplesServed, static_cast<uint64_t>(batch.count));
+    slot.ready_seq = -1;
+    ++consume_seq;
+    lock.unlock();
+    work_cv.notify_all();
+    return true;
+}
+
+void MnistPrefetchLoader::reset() {
+    std::unique_lock<std::mutex> lock(mutex);
+    quiesce(lock);
+    ++epoch;
+    rewind();
+    lock.unlock();
+    work_cv.notify_all();
+}
+
+void MnistPrefetchLoader::enable_shuffle(uint64_t seed) {
+    std::unique_lock<std::mutex> lock(mutex);
+    quiesce(lock);
+    shuffle = true;
+    shuffle_seed = shard_shuffle_seed(data, seed);
+    epoch = 0;
+    order.resize(sample_count);
+    rewind();
+    lock.unlock();
+    work_cv.notify_all();
+}
+
+void MnistPrefetchLoader::set_augment(AugmentFn fn, uint64_t seed) {
+    std::unique_lock<std::mutex> lock(mutex);
+    quiesce(lock);
+    augment = std::move(fn);
+    augment_seed = seed;
+    rewind();
+    lock.unlock();
+    work_cv.notify_all();
+}
+
+void MnistPrefetchLoader::quiesce(std::unique_lock<std::mutex>& lock) {
+    ++generation;
+    // In-flight fills belong to the old epoch; wait for them so no slot (or order) is in use
+    idle_cv.wait(lock, [this] { return active_fills == 0; });
+}
+
+void MnistPrefetchLoader::rewind() {
+    if (shuffle) {
+        shuffle_order(order.data(), sample_count, shuffle_seed, epoch);
+    }
+    next_claim = 0;
+    consume_seq = 0;
+    for (auto& slot : slots) {
+        slot.ready_seq = -1;
+    }
+}
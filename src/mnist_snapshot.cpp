@@ -0,0 +1,266 @@
+#include "mnist_snapshot.h"
+#include "log.h"
+#include "mnist_manifest.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <zlib.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char snapshot_magic[8] = {'M', 'N', 'S', 'N', 'A', 'P', '\0', '\0'};
+const uint32_t byte_order_mark = 0x01020304;
+const uint64_t alignment = 64;
+
+enum ArrayIndex { TrainImages = 0, TrainLabels, TestImages, TestLabels, ArrayCount };
+
+struct MnistSnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t header_size;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t train_count;
+    uint32_t test_count;
+    uint32_t storage;      // 0 = float, 1 = uint8
+    uint32_t normalize;
+    uint32_t reserved[3];
+    uint64_t offsets[ArrayCount];
+    uint64_t sizes[ArrayCount];
+    uint64_t source_sizes[ArrayCount];     // the files the arrays were loaded from, when written
+    int64_t source_mtimes_ns[ArrayCount];
+    uint32_t payload_crc;  // CRC32 over the four arrays, in order
+    uint32_t header_crc;   // CRC32 over every field above
+};
+static_assert(sizeof(MnistSnapshotHeader) == 192, "snapshot header layout changed");
+
+// In ArrayIndex order
+const char* const source_names[ArrayCount] = {
+    "train-images-idx3-ubyte",
+    "train-labels-idx1-ubyte",
+    "t10k-images-idx3-ubyte",
+    "t10k-labels-idx1-ubyte",
+};
+
+uint64_t align_up(uint64_t value) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+uint32_t header_checksum(const MnistSnapshotHeader& header) {
+    return static_cast<uint32_t>(crc32(0L, reinterpret_cast<const Bytef*>(&header),
+                                       offsetof(MnistSnapshotHeader, header_crc)));
+}
+
+uint32_t payload_checksum(const uint8_t* const arrays[ArrayCount], const uint64_t sizes[ArrayCount]) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (int i = 0; i < ArrayCount; ++i) {
+        // crc32 takes uInt lengths, so feed large arrays in pieces
+        for (uint64_t done = 0; done < sizes[i];) {
+            uInt n = static_cast<uInt>(std::min<uint64_t>(sizes[i] - done, 1u << 30));
+            crc = crc32(crc, arrays[i] + done, n);
+            done += n;
+        }
+    }
+    return static_cast<uint32_t>(crc);
+}
+
+// Reads and validates the header at the start of a mapped snapshot
+const MnistSnapshotHeader& parse_header(const MappedFile& file) {
+    if (file.size() < sizeof(MnistSnapshotHeader)) {
+        throw std::runtime_error("Snapshot is too small: " + file.path());
+    }
+    const auto& header = *reinterpret_cast<const MnistSnapshotHeader*>(file.data());
+    if (std::memcmp(header.magic, snapshot_magic, sizeof(snapshot_magic)) != 0) {
+        throw std::runtime_error("Not an MNIST snapshot: " + file.path());
+    }
+    if (header.byte_order != byte_order_mark) {
+        throw std::runtime_error("Snapshot was written with a different byte order: " + file.path());
+    }
+    if (header.version != MNIST_SNAPSHOT_VERSION || header.header_size != sizeof(MnistSnapshotHeader)) {
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(header.version) + " in " + file.path());
+    }
+    if (header.header_crc != header_checksum(header)) {
+        throw std::runtime_error("Snapshot header checksum mismatch: " + file.path());
+    }
+    for (int i = 0; i < ArrayCount; ++i) {
+        if (header.offsets[i] % alignment != 0 || header.offsets[i] + header.sizes[i] > file.size()) {
+            throw std::runtime_error("Snapshot array " + std::to_string(i) + " lies outside the file: " + file.path());
+        }
+    }
+    return header;
+}
+
+// Builds the dataset over an already validated mapping
+MnistData snapshot_data(std::shared_ptr<MappedFile> file, const MnistSnapshotHeader& header, bool verify_checksum) {
+    const std::string& path = file->path();
+    const uint8_t* arrays[ArrayCount];
+    for (int i = 0; i < ArrayCount; ++i) {
+        arrays[i] = file->data() + header.offsets[i];
+    }
+    if (verify_checksum && payload_checksum(arrays, header.sizes) != header.payload_crc) {
+        throw std::runtime_error("Snapshot payload checksum mismatch: " + path);
+    }
+
+    MnistData data;
+    data.rows = header.rows;
+    data.cols = header.cols;
+    data.train_count = header.train_count;
+    data.test_count = header.test_count;
+    data.storage = header.storage == 1 ? MnistStorage::Uint8 : MnistStorage::Float;
+    data.normalize = header.normalize != 0;
+    const int img_size = data.rows * data.cols;
+    const uint64_t pixel_bytes = data.storage == MnistStorage::Uint8 ? sizeof(uint8_t) : sizeof(float);
+    if (header.sizes[TrainImages] != static_cast<uint64_t>(data.train_count) * img_size * pixel_bytes ||
+        header.sizes[TestImages] != static_cast<uint64_t>(data.test_count) * img_size * pixel_bytes ||
+        header.sizes[TrainLabels] != static_cast<uint64_t>(data.train_count) * sizeof(int32_t) ||
+        header.sizes[TestLabels] != static_cast<uint64_t>(data.test_count) * sizeof(int32_t)) {
+        throw std::runtime_error("Snapshot array sizes do not match its dimensions: " + path);
+    }
+
+    // The images stay in the mapping; only the small label arrays are copied
+    data.snapshot_images[0] = arrays[TrainImages];
+    data.snapshot_images[1] = arrays[TestImages];
+    data.train_labels = Eigen::Map<const Eigen::VectorXi, Eigen::Aligned64>(
+        reinterpret_cast<const int*>(arrays[TrainLabels]), data.train_count);
+    data.test_labels = Eigen::Map<const Eigen::VectorXi, Eigen::Aligned64>(
+        reinterpret_cast<const int*>(arrays[TestLabels]), data.test_count);
+    data.snapshot = std::move(file);
+    return data;
+}
+
+} // anonymous namespace
+
+bool MnistSourceStamp::operator==(const MnistSourceStamp& other) const {
+    return std::equal(sizes, sizes + ArrayCount, other.sizes) &&
+           std::equal(mtimes_ns, mtimes_ns + ArrayCount, other.mtimes_ns);
+}
+
+MnistSourceStamp mnist_source_stamp(const std::string& root, MnistSource source) {
+    MnistSourceStamp stamp;
+    for (int i = 0; i < ArrayCount; ++i) {
+        std::string path = root + "/" + source_names[i] + (source == MnistSource::Gzip ? ".gz" : "");
+        if (!stat_file(path, stamp.sizes[i], stamp.mtimes_ns[i])) {
+            stamp.sizes[i] = 0;
+            stamp.mtimes_ns[i] = 0;
+        }
+    }
+    return stamp;
+}
+
+std::string default_snapshot_path(const std::string& root, const MnistLoadOptions& options) {
+    std::string name = options.storage == MnistStorage::Uint8 ? "mnist-u8" : "mnist-f32";
+    if (options.storage == MnistStorage::Float) {
+        name += options.normalize ? "-normalized" : "-raw";
+    }
+    return root + "/" + name + ".snapshot";
+}
+
+void save_mnist_snapshot(const MnistData& data, const std::string& path, const MnistSourceStamp& sources) {
+    if (data.shard_world_size > 1) {
+        throw std::runtime_error("Cannot snapshot shard " + std::to_string(data.shard_rank) + " of " +
+                                 std::to_string(data.shard_world_size) + ": " + path);
+    }
+    bool u8 = data.storage == MnistStorage::Uint8;
+    const uint8_t* arrays[ArrayCount] = {
+        u8 ? data.pixel_data(MnistSplit::Train) : reinterpret_cast<const uint8_t*>(data.image_data(MnistSplit::Train)),
+        reinterpret_cast<const uint8_t*>(data.train_labels.data()),
+        u8 ? data.pixel_data(MnistSplit::Test) : reinterpret_cast<const uint8_t*>(data.image_data(MnistSplit::Test)),
+        reinterpret_cast<const uint8_t*>(data.test_labels.data()),
+    };
+    const uint64_t pixel_bytes = u8 ? sizeof(uint8_t) : sizeof(float);
+    const uint64_t img_size = static_cast<uint64_t>(data.rows) * data.cols;
+
+    MnistSnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, snapshot_magic, sizeof(snapshot_magic));
+    header.version = MNIST_SNAPSHOT_VERSION;
+    header.byte_order = byte_order_mark;
+    header.header_size = sizeof(MnistSnapshotHeader);
+    header.rows = data.rows;
+    header.cols = data.cols;
+    header.train_count = data.train_count;
+    header.test_count = data.test_count;
+    header.storage = u8 ? 1 : 0;
+    header.normalize = data.normalize ? 1 : 0;
+    header.sizes[TrainImages] = data.train_count * img_size * pixel_bytes;
+    header.sizes[TrainLabels] = data.train_count * sizeof(int32_t);
+    header.sizes[TestImages] = data.test_count * img_size * pixel_bytes;
+    header.sizes[TestLabels] = data.test_count * sizeof(int32_t);
+    std::copy(sources.sizes, sources.sizes + ArrayCount, header.source_sizes);
+    std::copy(sources.mtimes_ns, sources.mtimes_ns + ArrayCount, header.source_mtimes_ns);
+    uint64_t offset = align_up(sizeof(MnistSnapshotHeader));
+    for (int i = 0; i < ArrayCount; ++i) {
+        header.offsets[i] = offset;
+        offset = align_up(offset + header.sizes[i]);
+    }
+    header.payload_crc = payload_checksum(arrays, header.sizes);
+    header.header_crc = header_checksum(header);
+
+    // Write next to the destination and rename, so readers only ever see a complete file
+    std::string tmp_path = path + ".tmp";
+#ifndef _WIN32
+    tmp_path += "." + std::to_string(::getpid());
+#endif
+    FILE* fp = std::fopen(tmp_path.c_str(), "wb");
+    if (!fp) {
+        throw std::runtime_error("Failed to create snapshot file: " + tmp_path);
+    }
+    static const char zeros[alignment] = {};
+    bool ok = std::fwrite(&header, sizeof(header), 1, fp) == 1;
+    uint64_t written = sizeof(header);
+    for (int i = 0; i < ArrayCount && ok; ++i) {
+        ok = std::fwrite(zeros, 1, header.offsets[i] - written, fp) == header.offsets[i] - written &&
+             std::fwrite(arrays[i], 1, header.sizes[i], fp) == header.sizes[i];
+        written = header.offsets[i] + header.sizes[i];
+    }
+#ifndef _WIN32
+    ok = ok && std::fflush(fp) == 0 && ::fsync(fileno(fp)) == 0;
+#endif
+    ok = std::fclose(fp) == 0 && ok;
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+        std::remove(tmp_path.c_str());
+        throw std::runtime_error("Failed to write snapshot: " + path);
+    }
+}
+
+MnistData load_mnist_snapshot(const std::string& path, bool verify_checksum) {
+    // Batches read the images in shuffled order, so no sequential read-ahead hint
+    auto file = std::make_shared<MappedFile>(path, false);
+    const MnistSnapshotHeader& header = parse_header(*file);
+    return snapshot_data(std::move(file), header, verify_checksum);
+}
+
+bool load_current_mnist_snapshot(const std::string& path, const MnistLoadOptions& options,
+                                 const MnistSourceStamp& sources, MnistData& out) {
+    std::shared_ptr<MappedFile> file;
+    try {
+        file = std::make_shared<MappedFile>(path, false);
+        const MnistSnapshotHeader& header = parse_header(*file);
+        // uint8 snapshots hold raw bytes either way; normalize only applies per batch
+        const bool same_format = options.storage == MnistStorage::Uint8
+                                     ? header.storage == 1
+                                     : header.storage == 0 && (header.normalize != 0) == options.normalize;
+        if (!same_format) {
+            return false;
+        }
+        MnistSourceStamp recorded;
+        std::copy(header.source_sizes, header.source_sizes + ArrayCount, recorded.sizes);
+        std::copy(header.source_mtimes_ns, header.source_mtimes_ns + ArrayCount, recorded.mtimes_ns);
+        if (!(recorded == sources)) {
+            MNIST_LOG_INFO("Snapshot " << path << " predates the current source files; reloading them");
+            return false;
+        }
+        out = snapshot_data(std::move(file), header, false);
+        return true;
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
@@ -0,0 +1,120 @@
+#include "parallel_trainer.h"
+#include "evaluator.h"
+#include "metrics.h"
+#include <algorithm>
+#include <stdexcept>
+
+DataParallelTrainer::DataParallelTrainer(Mlp& model, const MnistData& data, const OptimizerConfig& config,
+                                         int batch_size, int num_threads)
+    : model(model), data(data), opt(config, model.parameters().size()),
+      batch_size(batch_size > 0 ? batch_size : 1), team(num_threads) {
+    if (model.is_mapped()) {
+        throw std::runtime_error("A model mapped from a checkpoint is read-only; load_checkpoint it to train");
+    }
+    if (model.input_size() != data.rows * data.cols) {
+        throw std::runtime_error("Model input size " + std::to_string(model.input_size()) +
+                                 " does not match image size " + std::to_string(data.rows * data.cols));
+    }
+    if (data.train_count > 0 && mnist_num_classes(data) > model.output_size()) {
+        throw std::runtime_error("Training labels go up to " + std::to_string(mnist_num_classes(data) - 1) +
+                                 ", beyond the model's " + std::to_string(model.output_size()) + " classes");
+    }
+    const int shard_capacity = (this->batch_size + team.size() - 1) / team.size();
+    replicas.resize(team.size());
+    for (auto& replica : replicas) {
+        replica.workspace = MlpWorkspace(model.layout(), shard_capacity);
+        replica.shard.images.resize(shard_capacity, model.input_size());
+        replica.shard.labels.resize(shard_capacity);
+    }
+    shards.assign(team.size(), EvalShard(model.output_size(), shard_capacity));
+}
+
+void DataParallelTrainer::enable_shuffle(uint64_t seed) {
+    shuffle = true;
+    shuffle_seed = shard_shuffle_seed(data, seed);
+    epoch_index = 0;
+    order.resize(data.train_count);
+}
+
+void DataParallelTrainer::compute_shard(int thread_index, int start, int count) {
+    Replica& replica = replicas[thread_index];
+    const int n = team.size();
+    const int begin = thread_range_begin(count, thread_index, n);
+    const int rows = thread_range_begin(count, thread_index + 1, n) - begin;
+    replica.loss = 0.0f;
+    if (rows == 0) {
+        replica.workspace.gradients.setZero();
+        return;
+    }
+    MnistBatch& shard = replica.shard;
+    if (shuffle) {
+        gather_batch(data, MnistSplit::Train, order.data() + start + begin, rows,
+                     shard.images.data(), shard.labels.data());
+    } else {
+        copy_images(data, MnistSplit::Train, start + begin, rows, shard.images.data());
+        shard.labels.head(rows) = data.train_labels.segment(start + begin, rows);
+    }
+    replica.loss = model.forward_backward(shard.images.data(), shard.labels.data(), rows, replica.workspace);
+    // Shard gradients are means over the shard; weighting by its share of the batch makes the sum the batch mean
+    if (rows != count) {
+        replica.workspace.gradients *= static_cast<float>(rows) / static_cast<float>(count);
+        replica.loss *= static_cast<float>(rows) / static_cast<float>(count);
+    }
+}
+
+void DataParallelTrainer::reduce_chunk(int thread_index) {
+    const int n = team.size();
+    const Eigen::Index total = model.parameters().size();
+    // Chunks start on 16-float (64-byte) boundaries so no two threads write the same cache line
+    const Eigen::Index per_thread = ((total + n - 1) / n + 15) / 16 * 16;
+    const Eigen::Index begin = std::min(total, per_thread * thread_index);
+    const Eigen::Index length = std::min(total, begin + per_thread) - begin;
+    if (length == 0) {
+        return;
+    }
+    // Fixed pairwise tree: (0+1) + (2+3), then ((0+1)+(2+3)) + ..., the same order on every run
+    for (int stride = 1; stride < n; stride *= 2) {
+        for (int i = 0; i + stride < n; i += 2 * stride) {
+            replicas[i].workspace.gradients.segment(begin, length) +=
+                replicas[i + stride].workspace.gradients.segment(begin, length);
+        }
+    }
+}
+
+float DataParallelTrainer::train_epoch() {
+    if (shuffle) {
+        shuffle_order(order.data(), data.train_count, shuffle_seed, epoch_index);
+    }
+    double total_loss = 0.0;
+    for (int start = 0; start < data.train_count; start += batch_size) {
+        const int count = std::min(batch_size, data.train_count - start);
+        auto compute = [&](int thread_index) { compute_shard(thread_index, start, count); };
+        team.run(compute);
+        auto reduce = [&](int thread_index) { reduce_chunk(thread_index); };
+        team.run(reduce);
+
+        float loss = replicas[0].loss;
+        for (int i = 1; i < team.size(); ++i) {
+            loss += replicas[i].loss;
+        }
+        opt.step(model.parameters(), replicas[0].workspace.gradients);
+        total_loss += static_cast<double>(loss) * count;
+        samples += count;
+        // The trainer gathers its own shards instead of going through a batch loader
+        metrics_add(MetricCounter::BatchesServed);
+        metrics_add(MetricCounter::SamplesServed, static_cast<uint64_t>(count));
+    }
+    ++epoch_index;
+    return data.train_count > 0 ? static_cast<float>(total_loss / data.train_count) : 0.0f;
+}
+
+float DataParallelTrainer::evaluate(MnistSplit split) {
+    const int block = replicas[0].workspace.max_batch;
+    EvalReport report = evaluate_classifier(team, shards, data, split, model.output_size(), block, "the model's",
+                                            [&](int thread_index, int start, int count, int* predictions) {
+        Replica& replica = replicas[thread_index];
+        copy_images(data, split, start, count, replica.shard.images.data());
+        model.predict(replica.shard.images.data(), count, predictions, replica.workspace);
+    });
+    return report.accuracy();
+}
@@ -0,0 +1,300 @@
+#include "quantized_mlp.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MNIST_X86 1
+#endif
+
+namespace {
+
+constexpr int kLanes = 8;      // int32 accumulators in a 256-bit vector: output channels per vector
+constexpr int kMaxVectors = 4; // vectors per register block: 32 output channels
+
+// The 4 (or fewer, zero-filled) input bytes of group g, as one little-endian word
+inline uint32_t load_group4(const uint8_t* x, int g, int k) {
+    uint32_t word = 0;
+    int begin = 4 * g;
+    if (begin + 4 <= k) {
+        std::memcpy(&word, x + begin, 4);
+    } else {
+        for (int i = begin; i < k; ++i) word |= static_cast<uint32_t>(x[i]) << (8 * (i - begin));
+    }
+    return word;
+}
+
+// acc[r][j] = sum_k x[r][k] * w[k][j] for all rows, using the [k/4][out_pad][4] packing
+void gemm_scalar(const uint8_t* x, int rows, int k, const QuantizedMlp::Layer& layer, int32_t* acc) {
+    const int groups = (k + 3) / 4;
+    const int out_pad = layer.out_pad;
+    for (int r = 0; r < rows; ++r) {
+        const uint8_t* xr = x + static_cast<size_t>(r) * k;
+        int32_t* ar = acc + static_cast<size_t>(r) * out_pad;
+        std::fill(ar, ar + out_pad, 0);
+        for (int g = 0; g < groups; ++g) {
+            uint32_t word = load_group4(xr, g, k);
+            const int32_t x0 = word & 0xff, x1 = (word >> 8) & 0xff, x2 = (word >> 16) & 0xff, x3 = word >> 24;
+            const int8_t* w = layer.w4.data() + static_cast<size_t>(g) * out_pad * 4;
+            for (int j = 0; j < out_pad; ++j) {
+                ar[j] += x0 * w[4 * j] + x1 * w[4 * j + 1] + x2 * w[4 * j + 2] + x3 * w[4 * j + 3];
+            }
+        }
+    }
+}
+
+#ifdef MNIST_X86
+
+// One row, NV vectors (8 * NV output channels) starting at channel j0
+template <int NV>
+__attribute__((target("avx2"))) inline void avx2_block(const uint8_t* x, int k, int out_pad, const int16_t* w2,
+                                                       int j0, int32_t* acc) {
+    __m256i sum[NV];
+    for (int v = 0; v < NV; ++v) sum[v] = _mm256_setzero_si256();
+    const int pairs = (k + 1) / 2;
+    const int16_t* w = w2 + static_cast<size_t>(j0) * 2;
+    for (int p = 0; p < pairs; ++p, w += static_cast<size_t>(out_pad) * 2) {
+        // Two pixels as int16 lanes (x[2p], x[2p+1]); madd_epi16 forms both products in int32, so
+        // 255 * 127 * 2 never saturates the way maddubs_epi16 would
+        uint32_t lo = x[2 * p];
+        uint32_t hi = 2 * p + 1 < k ? x[2 * p + 1] : 0;
+        const __m256i pixels = _mm256_set1_epi32(static_cast<int>(lo | (hi << 16)));
+        for (int v = 0; v < NV; ++v) {
+            __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + v * 2 * kLanes));
+            sum[v] = _mm256_add_epi32(sum[v], _mm256_madd_epi16(pixels, weights));
+        }
+    }
+    for (int v = 0; v < NV; ++v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + j0 + v * kLanes), sum[v]);
+    }
+}
+
+__attribute__((target("avx2"))) void gemm_avx2(const uint8_t* x, int rows, int k, const QuantizedMlp::Layer& layer,
+                                               int32_t* acc) {
+    const int out_pad = layer.out_pad;
+    for (int r = 0; r < rows; ++r) {
+        const uint8_t* xr = x + static_cast<size_t>(r) * k;
+        int32_t* ar = acc + static_cast<size_t>(r) * out_pad;
+        int j0 = 0;
+        for (; j0 + kMaxVectors * kLanes <= out_pad; j0 += kMaxVectors * kLanes) {
+            avx2_block<kMaxVectors>(xr, k, out_pad, layer.w2.data(), j0, ar);
+        }
+        switch ((out_pad - j0) / kLanes) {
+        case 3: avx2_block<3>(xr, k, out_pad, layer.w2.data(), j0, ar); break;
+        case 2: avx2_block<2>(xr, k, out_pad, layer.w2.data(), j0, ar); break;
+        case 1: avx2_block<1>(xr, k, out_pad, layer.w2.data(), j0, ar); break;
+        default: break;
+        }
+    }
+}
+
+#define MNIST_VNNI_TARGET __attribute__((target("avx2,avx512f,avx512vl,avx512bw,avx512vnni")))
+
+template <int NV>
+MNIST_VNNI_TARGET inline void vnni_block(const uint8_t* x, int k, int out_pad, const int8_t* w4, int j0,
+                                         int32_t* acc) {
+    __m256i sum[NV];
+    for (int v = 0; v < NV; ++v) sum[v] = _mm256_setzero_si256();
+    const int groups = (k + 3) / 4;
+    const int8_t* w = w4 + static_cast<size_t>(j0) * 4;
+    for (int g = 0; g < groups; ++g, w += static_cast<size_t>(out_pad) * 4) {
+        // Four pixels broadcast to every lane; dpbusd multiplies them with 4 weights per channel
+        const __m256i pixels = _mm256_set1_epi32(static_cast<int>(load_group4(x, g, k)));
+        for (int v = 0; v < NV; ++v) {
+            __m256i weights = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + v * 4 * kLanes));
+            sum[v] = _mm256_dpbusd_epi32(sum[v], pixels, weights);
+        }
+    }
+    for (int v = 0; v < NV; ++v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + j0 + v * kLanes), sum[v]);
+    }
+}
+
+MNIST_VNNI_TARGET void gemm_vnni(const uint8_t* x, int rows, int k, const QuantizedMlp::Layer& layer, int32_t* acc) {
+    const int out_pad = layer.out_pad;
+    for (int r = 0; r < rows; ++r) {
+        const uint8_t* xr = x + static_cast<size_t>(r) * k;
+        int32_t* ar = acc + static_cast<size_t>(r) * out_pad;
+        int j0 = 0;
+        for (; j0 + kMaxVectors * kLanes <= out_pad; j0 += kMaxVectors * kLanes) {
+            vnni_block<kMaxVectors>(xr, k, out_pad, layer.w4.data(), j0, ar);
+        }
+        switch ((out_pad - j0) / kLanes) {
+        case 3: vnni_block<3>(xr, k, out_pad, layer.w4.data(), j0, ar); break;
+        case 2: vnni_block<2>(xr, k, out_pad, layer.w4.data(), j0, ar); break;
+        case 1: vnni_block<1>(xr, k, out_pad, layer.w4.data(), j0, ar); break;
+        default: break;
+        }
+    }
+}
+
+#endif // MNIST_X86
+
+} // anonymous namespace
+
+bool int8_kernel_supported(Int8Kernel kernel) {
+    switch (kernel) {
+    case Int8Kernel::Auto:
+    case Int8Kernel::Scalar:
+        return true;
+#ifdef MNIST_X86
+    case Int8Kernel::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case Int8Kernel::Avx512Vnni:
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512vl") &&
+               __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni");
+#endif
+    default:
+        return false;
+    }
+}
+
+const char* int8_kernel_name(Int8Kernel kernel) {
+    switch (kernel) {
+    case Int8Kernel::Auto: return "auto";
+    case Int8Kernel::Scalar: return "scalar";
+    case Int8Kernel::Avx2: return "avx2";
+    case Int8Kernel::Avx512Vnni: return "avx512-vnni";
+    }
+    return "unknown";
+}
+
+QuantizedMlp::QuantizedMlp(const Mlp& model, const MnistData& calibration, MnistSplit split, Int8Kernel kernel) {
+    const MlpLayout& layout = model.layout();
+    const int num_layers = layout.num_layers();
+    const int count = split == MnistSplit::Train ? calibration.train_count : calibration.test_count;
+    if (count == 0) {
+        throw std::runtime_error("Quantization needs a non-empty calibration split");
+    }
+    if (calibration.rows * calibration.cols != model.input_size()) {
+        throw std::runtime_error("Calibration images do not match the model input size");
+    }
+
+    // Calibration: the largest post-ReLU value of every hidden layer under the float model
+    std::vector<float> max_activation(num_layers - 1, 0.0f);
+    const int batch = 256;
+    MlpWorkspace workspace(layout, batch);
+    RowMatrixXf images(batch, model.input_size());
+    for (int start = 0; start < count; start += batch) {
+        int n = std::min(batch, count - start);
+        copy_images(calibration, split, start, n, images.data());
+        model.forward(images.data(), n, workspace);
+        for (int l = 0; l + 1 < num_layers; ++l) {
+            const float* out = workspace.activations.data() + workspace.output_offsets[l];
+            Eigen::Map<const Eigen::ArrayXf> values(out, static_cast<Eigen::Index>(n) * layout.sizes[l + 1]);
+            max_activation[l] = std::max(max_activation[l], values.maxCoeff());
+        }
+    }
+
+    // Raw pixels reach the first layer; the float model saw them divided by 255 when normalized
+    float input_scale = calibration.normalize ? 1.0f / 255.0f : 1.0f;
+    const float* params = model.parameter_data();
+    for (int l = 0; l < num_layers; ++l) {
+        Layer layer;
+        layer.in = layout.sizes[l];
+        layer.out = layout.sizes[l + 1];
+        layer.out_pad = (layer.out + kLanes - 1) / kLanes * kLanes;
+        layer.hidden = l + 1 < num_layers;
+        const int groups4 = (layer.in + 3) / 4;
+        const int groups2 = (layer.in + 1) / 2;
+        layer.w4.assign(static_cast<size_t>(groups4) * layer.out_pad * 4, 0);
+        layer.w2.assign(static_cast<size_t>(groups2) * layer.out_pad * 2, 0);
+        layer.multiplier.assign(layer.out_pad, 0.0f);
+        layer.offset.assign(layer.out_pad, 0.0f);
+
+        float output_scale = 1.0f;
+        if (layer.hidden) {
+            output_scale = max_activation[l] > 0.0f ? max_activation[l] / 255.0f : 1.0f;
+            scales.push_back(output_scale);
+        }
+        auto w = layout.weight(params, l);
+        auto b = layout.bias(params, l);
+        for (int j = 0; j < layer.out; ++j) {
+            // Symmetric per-channel scale: the largest |w| of the channel maps to 127
+            float amax = w.col(j).cwiseAbs().maxCoeff();
+            float weight_scale = amax > 0.0f ? amax / 127.0f : 1.0f;
+            for (int k = 0; k < layer.in; ++k) {
+                int q = static_cast<int>(std::lround(w(k, j) / weight_scale));
+                q = std::max(-127, std::min(127, q));
+                layer.w4[(static_cast<size_t>(k / 4) * layer.out_pad + j) * 4 + k % 4] = static_cast<int8_t>(q);
+                layer.w2[(static_cast<size_t>(k / 2) * layer.out_pad + j) * 2 + k % 2] = static_cast<int16_t>(q);
+            }
+            layer.multiplier[j] = input_scale * weight_scale / output_scale;
+            layer.offset[j] = b[j] / output_scale;
+        }
+        layers.push_back(std::move(layer));
+        input_scale = output_scale;
+    }
+    set_kernel(kernel);
+}
+
+void QuantizedMlp::set_kernel(Int8Kernel kernel) {
+    if (kernel == Int8Kernel::Auto) {
+        kernel = int8_kernel_supported(Int8Kernel::Avx512Vnni) ? Int8Kernel::Avx512Vnni
+                 : int8_kernel_supported(Int8Kernel::Avx2)     ? Int8Kernel::Avx2
+                                                               : Int8Kernel::Scalar;
+    }
+    if (!int8_kernel_supported(kernel)) {
+        throw std::runtime_error(std::string("int8 kernel not supported on this CPU: ") + int8_kernel_name(kernel));
+    }
+    active = kernel;
+}
+
+QuantizedMlp::Workspace::Workspace(const QuantizedMlp& model, int max_batch) : max_batch(max_batch) {
+    size_t widest = 0;
+    for (const auto& layer : model.layers) {
+        widest = std::max(widest, static_cast<size_t>(layer.out_pad));
+    }
+    accumulators.assign(static_cast<size_t>(max_batch) * widest, 0);
+    activations[0].assign(static_cast<size_t>(max_batch) * widest, 0);
+    activations[1].assign(static_cast<size_t>(max_batch) * widest, 0);
+}
+
+void QuantizedMlp::predict(const uint8_t* pixels, int count, int* out_labels, Workspace& workspace) const {
+    if (count > workspace.max_batch) {
+        throw std::runtime_error("Batch of " + std::to_string(count) + " exceeds the workspace capacity of " +
+                                 std::to_string(workspace.max_batch));
+    }
+    const uint8_t* input = pixels;
+    int32_t* acc = workspace.accumulators.data();
+    for (size_t l = 0; l < layers.size(); ++l) {
+        const Layer& layer = layers[l];
+        switch (active) {
+#ifdef MNIST_X86
+        case Int8Kernel::Avx2: gemm_avx2(input, count, layer.in, layer, acc); break;
+        case Int8Kernel::Avx512Vnni: gemm_vnni(input, count, layer.in, layer, acc); break;
+#endif
+        default: gemm_scalar(input, count, layer.in, layer, acc); break;
+        }
+
+        if (layer.hidden) {
+            // Requantize: ReLU, then round onto the next layer's uint8 grid
+            uint8_t* out = workspace.activations[l % 2].data();
+            for (int r = 0; r < count; ++r) {
+                const int32_t* ar = acc + static_cast<size_t>(r) * layer.out_pad;
+                uint8_t* orow = out + static_cast<size_t>(r) * layer.out;
+                for (int j = 0; j < layer.out; ++j) {
+                    float y = static_cast<float>(ar[j]) * layer.multiplier[j] + layer.offset[j];
+                    y = std::min(std::max(y, 0.0f), 255.0f);
+                    orow[j] = static_cast<uint8_t>(y + 0.5f);
+                }
+            }
+            input = out;
+        } else {
+            for (int r = 0; r < count; ++r) {
+                const int32_t* ar = acc + static_cast<size_t>(r) * layer.out_pad;
+                int best = 0;
+                float best_logit = static_cast<float>(ar[0]) * layer.multiplier[0] + layer.offset[0];
+                for (int j = 1; j < layer.out; ++j) {
+                    float logit = static_cast<float>(ar[j]) * layer.multiplier[j] + layer.offset[j];
+                    if (logit > best_logit) {
+                        best_logit = logit;
+                        best = j;
+                    }
+                }
+                out_labels[r] = best;
+            }
+        }
+    }
+}
@@ -0,0 +1,70 @@
+#include "thread_team.h"
+#include <algorithm>
+
+ThreadTeam::ThreadTeam(int num_threads) : team_size(std::max(num_threads, 1)), errors(team_size) {
+    workers.reserve(team_size - 1);
+    for (int i = 1; i < team_size; ++i) {
+        workers.emplace_back(&ThreadTeam::worker_loop, this, i);
+    }
+}
+
+ThreadTeam::~ThreadTeam() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    start_cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadTeam::execute(int thread_index) {
+    try {
+        current_thunk(current_context, thread_index);
+    } catch (...) {
+        errors[thread_index] = std::current_exception();
+    }
+}
+
+void ThreadTeam::dispatch(Thunk thunk, void* context) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_thunk = thunk;
+        current_context = context;
+        pending = team_size - 1;
+        ++generation;
+    }
+    start_cv.notify_all();
+
+    // The calling thread is member 0
+    execute(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [this] { return pending == 0; });
+    for (auto& error : errors) {
+        if (error) {
+            std::exception_ptr first = error;
+            std::fill(errors.begin(), errors.end(), nullptr);
+            std::rethrow_exception(first);
+        }
+    }
+}
+
+void ThreadTeam::worker_loop(int thread_index) {
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        start_cv.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) {
+            return;
+        }
+        seen = generation;
+        lock.unlock();
+        execute(thread_index);
+        lock.lock();
+        if (--pending == 0) {
+            done_cv.notify_one();
+        }
+    }
+}